@@ -36,7 +36,8 @@
 
 /* Dclarations des variables globales 	*/
 extern spi_desc_t  mySpi;
-uint16_t RxData[4];
+const uint8_t TxData[4] = {0x11, 0x22, 0x44, 0x88};
+uint8_t RxData[4];
 
 
 /* Programme Principal			*/
@@ -47,6 +48,17 @@ int main(void)
 
 
 Initialiser();		// Appel fonction d'initialisation
+#ifdef TEST_LOOPBACK
+SelfTest();         // SDO reli  SDI
+#endif
+#ifdef BENCH_STORAGE
+StorageBenchmark(); // Flash + carte SD sur SPI_MODULE
+#endif
+Benchmark();        // Rapport CSV sur l'UART
+#if SPI_USE_TRACE
+spi_trace_tag(&mySpi, 1);
+spi_trace_enable(1);
+#endif
 
 while(1)
     {
@@ -54,14 +66,14 @@ while(1)
     CS_LOW();
     
     
-    spi_transfert(&mySpi, 0x0011, &RxData[0]);
-    spi_transfert(&mySpi, 0x0022, &RxData[1]);
-    spi_transfert(&mySpi, 0x0044, &RxData[2]);
-    spi_transfert(&mySpi, 0x0088, &RxData[3]);
+    spi_transfer_raw_bytes(&mySpi, TxData, RxData, 4);
     
     
     CS_HIGH();
     LATAbits.LATA0 = ~LATAbits.LATA0;
+#if SPI_USE_TRACE
+    TraceDump();
+#endif
     }
 }					
 
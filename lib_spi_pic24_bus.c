@@ -0,0 +1,131 @@
+/**
+ * @file 	lib_spi_pic24_bus.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Several slave devices sharing one SPI module (lib_spi_pic24_ll)
+ *  
+ *
+ */
+
+#include "lib_spi_pic24_bus.h"
+
+/*	Implementation du code */
+/**
+ * CS line of a device, NULL when it has none (see spi_device_init)
+ */
+static const spi_cs_t *spi_device_cs(const spi_device_t *pDev){
+    if ((pDev->cs.pfSelect == NULL) && (pDev->cs.pLAT == NULL)) return NULL;
+    return &pDev->cs;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_device_init(spi_device_t *pDev, spi_desc_t *pSpi, const spi_config_t *pSpiCFG, const spi_cs_t *pCs){
+    if ((pSpi == NULL) || (pSpiCFG == NULL)) return SPI_ERROR;
+    pDev->pSpi = pSpi;
+    pDev->con1 = spi_config_con1(pSpiCFG);
+    pDev->con2 = spi_config_con2(pSpiCFG);
+    if (pCs != NULL) pDev->cs = *pCs;
+    else {
+        pDev->cs.pfSelect = NULL;   // No CS line (hardware SSx pin, single device...)
+        pDev->cs.pCtx = NULL;
+        pDev->cs.pLAT = NULL;
+        pDev->cs.mask = 0;
+    }
+    pDev->prio = 0;
+    pDev->busTaken = 0;
+    spi_cs_release(spi_device_cs(pDev));
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+void    spi_device_set_priority(spi_device_t *pDev, uint8_t prio){
+    pDev->prio = prio;
+}
+//------------------------------------------------------------------------------
+/**
+ * Bus given back if it was taken by spi_device_take (CS line untouched)
+ */
+static void spi_device_untake(spi_device_t *pDev){
+#if SPI_USE_BUS
+    if (pDev->busTaken){
+        pDev->busTaken = 0;
+        spi_bus_release(pDev->pSpi, pDev);
+    }
+#else
+    (void)pDev;     // Module not arbitrated
+#endif
+}
+//------------------------------------------------------------------------------
+/**
+ * Bus taken for a transaction (unless the device already owns it), module 
+ * configured for the device
+ */
+static spi_err_t   spi_device_take(spi_device_t *pDev){
+    spi_err_t res;
+    
+#if SPI_USE_BUS
+    if (spi_bus_owner(pDev->pSpi) != pDev){
+        res = spi_bus_acquire(pDev->pSpi, pDev, pDev->prio, NULL, NULL);
+        if (res != SPI_OK) return res;
+        pDev->busTaken = 1;
+    }
+#endif
+    
+    // Lazy reconfiguration : nothing written if the last device had the same configuration
+    res = spi_reconfigure(pDev->pSpi, pDev->con1, pDev->con2);
+    if (res != SPI_OK) spi_device_untake(pDev);
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_device_select(spi_device_t *pDev){
+    spi_err_t res;
+    
+    res = spi_device_take(pDev);
+    if (res != SPI_OK) return res;
+    spi_cs_assert(spi_device_cs(pDev));
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+void    spi_device_release(spi_device_t *pDev){
+    spi_cs_release(spi_device_cs(pDev));
+    spi_device_untake(pDev);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_device_transfer_bytes(spi_device_t *pDev, const uint8_t *pTxData, uint8_t *pRxData, size_t len){
+    spi_err_t res;
+    
+    res = spi_device_select(pDev);
+    if (res != SPI_OK) return res;
+    res = spi_transfer_raw_bytes(pDev->pSpi, pTxData, pRxData, len);
+    spi_device_release(pDev);
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_device_transfer_words(spi_device_t *pDev, const uint16_t *pTxData, uint16_t *pRxData, size_t len){
+    spi_err_t res;
+    
+    res = spi_device_select(pDev);
+    if (res != SPI_OK) return res;
+    res = spi_transfer_raw_words(pDev->pSpi, pTxData, pRxData, len);
+    spi_device_release(pDev);
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_device_transaction(spi_device_t *pDev, const spi_transaction_t *pTrans){
+    spi_err_t res;
+    
+    res = spi_device_select(pDev);
+    if (res != SPI_OK) return res;
+    res = spi_transfer_segments(pDev->pSpi, pTrans->pSeg, pTrans->nbSeg);
+    spi_device_release(pDev);
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_device_read_batch(spi_device_t *pDev, const spi_reg_job_t *pJobs, size_t nbJobs, uint8_t *pRx, size_t stride){
+    spi_err_t res;
+    
+    res = spi_device_take(pDev);
+    if (res != SPI_OK) return res;
+    res = spi_transfer_reg_batch(pDev->pSpi, pJobs, nbJobs, pRx, stride);
+    spi_device_untake(pDev);       // CS of pDev not used : left as the caller set it
+    return res;
+}
+//------------------------------------------------------------------------------
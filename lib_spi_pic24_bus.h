@@ -0,0 +1,152 @@
+/**
+ * @file    lib_spi_pic24_bus.h 
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Several slave devices sharing one SPI module (lib_spi_pic24_ll)
+ *  
+ * Each device handle bundles the precomputed SPIxCON1 / SPIxCON2 values of 
+ * the device and its Chip Select line. The module registers are only 
+ * rewritten when the device selected needs a configuration different from 
+ * the one in use.
+ * 
+ * When SPI_USE_BUS is 1, the device calls take the bus (spi_bus_acquire, the 
+ * device handle being the identity of the user) for the transaction when 
+ * the device does not own it already, and return SPI_BUSY when another user 
+ * owns it, even at the same priority. A user that runs several transactions 
+ * in a row, or that must wait for the bus, acquires it itself with the 
+ * device handle :
+ *      spi_bus_acquire(dev.pSpi, &dev, dev.prio, pfGrant, pCtx);
+ * When SPI_USE_BUS is 0, the module is not arbitrated : a single context 
+ * (main loop or one ISR priority) must use the devices of a module.
+ *
+ */
+
+#ifndef	__LIB_SPI_PIC24_BUS_H__
+#define	__LIB_SPI_PIC24_BUS_H__
+#include "lib_spi_pic24_ll.h"
+
+/** Type spi_device_t
+ * 
+ * 
+ */
+typedef struct {
+    spi_desc_t  *pSpi;      /**< Module the device is wired to (initialized) */
+    uint16_t    con1;       /**< SPIxCON1 value for this device */
+    uint16_t    con2;       /**< SPIxCON2 value for this device */
+    spi_cs_t    cs;         /**< Chip Select line of the device */
+    uint8_t     prio;       /**< Bus priority of the user of the device (see spi_device_set_priority) */
+    uint8_t     busTaken;   /**< 1 : the bus was acquired by spi_device_select */
+    } spi_device_t;
+
+/** Type spi_transaction_t
+ * 
+ * Segments transferred under a single Chip Select window
+ * Ex : opcode + address + readback
+ *      spi_segment_t seg[] = {{&opcode, NULL, 1, 0, 0}, {addr, NULL, 3, 0, 0}, {NULL, buf, n, 0xFF, 0}};
+ */
+typedef struct {
+    const spi_segment_t *pSeg;
+    size_t              nbSeg;
+    } spi_transaction_t;
+
+/**
+ * @brief   Initialize a device handle (the CS line is released)
+ * 
+ * @param[out]  pDev        Device handle
+ * @param[in]   pSpi        Address of the Spi module descriptor (already initialized)
+ * @param[in]   pSpiCFG     Configuration required by the device
+ * @param[in]   pCs         Chip Select line of the device (copied), NULL : none 
+ *                          (SSx pin driven by the module, single device...)
+ * 
+ * @return  SPI_OK
+ * @return  SPI_ERROR   pSpi or pSpiCFG is NULL (pDev left unchanged)
+ * 
+ * @info    The bus priority of the device is 0 (see spi_device_set_priority)
+ */
+spi_err_t   spi_device_init(spi_device_t *pDev, spi_desc_t *pSpi, const spi_config_t *pSpiCFG, const spi_cs_t *pCs);
+
+/**
+ * @brief   Sets the bus priority of the user of a device (see spi_bus_acquire)
+ * 
+ * @param[in]   pDev    Device handle
+ * @param[in]   prio    0..SPI_BUS_NB_PRIO-1
+ */
+void    spi_device_set_priority(spi_device_t *pDev, uint8_t prio);
+
+/**
+ * @brief   Selects a device : the bus is acquired if the user does not own 
+ *          it, the module is reconfigured if needed, then the CS line of the 
+ *          device is asserted
+ * 
+ * @param[in]   pDev    Device handle
+ * 
+ * @return  SPI_OK
+ * @return  SPI_BUSY    bus owned by another user (another device), or 
+ *                      asynchronous transfer running
+ * @return  SPI_ERROR   bad priority (see spi_bus_acquire)
+ */
+spi_err_t   spi_device_select(spi_device_t *pDev);
+
+/**
+ * @brief   Releases the CS line of a device (and the bus if taken by 
+ *          spi_device_select)
+ * 
+ * @param[in]   pDev    Device handle
+ */
+void    spi_device_release(spi_device_t *pDev);
+
+/**
+ * @brief   Complete transfer with a device : select, transfer, release
+ * 
+ * @param[in]   pDev    Device handle
+ * @param[in]   pTxData Address of Data to Tx or NULL
+ * @param[out]  pRxData Address of the location to store the Rx data or NULL
+ * @param[in]   len     number of bytes / words to transfer 
+ * 
+ * @return  SPI_OK
+ * @return  SPI_BAD_DATA_FORMAT
+ * @return  SPI_BUSY
+ * @return  SPI_TIMEOUT, SPI_OVERRUN
+ */
+spi_err_t   spi_device_transfer_bytes(spi_device_t *pDev, const uint8_t *pTxData, uint8_t *pRxData, size_t len);
+spi_err_t   spi_device_transfer_words(spi_device_t *pDev, const uint16_t *pTxData, uint16_t *pRxData, size_t len);
+
+/**
+ * @brief   Runs a transaction with a device : select, segments (see 
+ *          spi_transfer_segments), release
+ * 
+ * @param[in]   pDev    Device handle
+ * @param[in]   pTrans  Transaction
+ * 
+ * @return  SPI_OK
+ * @return  SPI_BAD_DATA_FORMAT
+ * @return  SPI_BUSY
+ * @return  SPI_TIMEOUT, SPI_OVERRUN
+ */
+spi_err_t   spi_device_transaction(spi_device_t *pDev, const spi_transaction_t *pTrans);
+
+/**
+ * @brief   Reads a register block from several identical devices (see 
+ *          spi_transfer_reg_batch) : bus and configuration of pDev, CS 
+ *          lines of the jobs
+ * 
+ * Ex : 8 sensors, 6 bytes from register 0x28 (read + auto-increment flags)
+ *      spi_reg_job_t jobs[8] = {{&cs0, 0xE8, 6}, {&cs1, 0xE8, 6}, ...};
+ *      struct {int8_t xl[8], xh[8], yl[8], yh[8], zl[8], zh[8];} acc;
+ *      spi_device_read_batch(&sensor0, jobs, 8, (uint8_t*)&acc, 8);
+ * 
+ * @param[in]   pDev    Device handle giving the configuration (its CS is 
+ *                      neither asserted nor released)
+ * @param[in]   pJobs   Array of jobs
+ * @param[in]   nbJobs  number of jobs
+ * @param[out]  pRx     Structure of arrays : byte k of job j at pRx[j + k * stride]
+ * @param[in]   stride  >= nbJobs
+ * 
+ * @return  SPI_OK
+ * @return  SPI_BAD_DATA_FORMAT
+ * @return  SPI_BUSY
+ * @return  SPI_TIMEOUT, SPI_OVERRUN
+ */
+spi_err_t   spi_device_read_batch(spi_device_t *pDev, const spi_reg_job_t *pJobs, size_t nbJobs, uint8_t *pRx, size_t stride);
+
+#endif
@@ -0,0 +1,185 @@
+/**
+ * @file 	lib_spi_pic24_flash.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	SPI NOR flash (25 series) with read cache and page write-back 
+ *          buffer (lib_spi_pic24_ll)
+ *  
+ *
+ */
+
+#include <string.h>
+#include "lib_spi_pic24_flash.h"
+
+/*	Implementation du code */
+/**
+ * One command : opcode, 24 bits address (if any), dummy bytes, then data
+ */
+static spi_err_t   spi_flash_cmd(spi_flash_t *pFlash, uint8_t cmd, uint32_t addr, uint8_t hdrLen, 
+                                 const uint8_t *pTx, uint8_t *pRx, size_t len){
+    uint8_t hdr[5];
+    spi_segment_t   seg[2] = {  {NULL, NULL, 0, 0, 8},
+                                {NULL, NULL, 0, 0xFF, 8}};
+    spi_transaction_t   trans = {seg, 2};
+    
+    hdr[0] = cmd;
+    hdr[1] = (uint8_t)(addr >> 16);
+    hdr[2] = (uint8_t)(addr >> 8);
+    hdr[3] = (uint8_t)addr;
+    hdr[4] = 0xFF;                          // Dummy byte (FAST READ)
+    seg[0].pTx = hdr;
+    seg[0].len = hdrLen;
+    seg[1].pTx = pTx;
+    seg[1].pRx = pRx;
+    seg[1].len = len;
+    return spi_device_transaction(pFlash->pDev, &trans);
+}
+//------------------------------------------------------------------------------
+/**
+ * Polls the status register until WIP is cleared (CS released between polls)
+ */
+static spi_err_t   spi_flash_wait(spi_flash_t *pFlash){
+    spi_err_t   res;
+    uint8_t     busy;
+    uint32_t    polls = 0;
+    
+    for (;;){
+        res = spi_flash_busy(pFlash, &busy);
+        if ((res != SPI_OK) || !busy) return res;
+        if ((pFlash->maxPolls != 0) && (++polls >= pFlash->maxPolls)) return SPI_TIMEOUT;
+        if (pFlash->pfYield != NULL) pFlash->pfYield(pFlash->pYieldCtx);
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * Forgets the cached bytes of [addr, addr + len[ 
+ */
+static void spi_flash_cache_drop(spi_flash_t *pFlash, uint32_t addr, uint32_t len){
+    if ((addr < (pFlash->cacheAddr + pFlash->cacheLen)) && (pFlash->cacheAddr < (addr + len))) pFlash->cacheLen = 0;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_flash_init(spi_flash_t *pFlash, spi_device_t *pDev, void (*pfYield)(void *pCtx), void *pYieldCtx){
+    pFlash->pDev = pDev;
+    pFlash->pfYield = pfYield;
+    pFlash->pYieldCtx = pYieldCtx;
+    pFlash->maxPolls = 0;
+    pFlash->cacheLen = 0;
+    pFlash->nextAddr = 0xFFFFFFFF;
+    pFlash->pageHi = 0;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_flash_read_id(spi_flash_t *pFlash, uint8_t *pId){
+    return spi_flash_cmd(pFlash, SPI_FLASH_CMD_RDID, 0, 1, NULL, pId, 3);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_flash_busy(spi_flash_t *pFlash, uint8_t *pBusy){
+    spi_err_t   res;
+    uint8_t     status;
+    
+    res = spi_flash_cmd(pFlash, SPI_FLASH_CMD_RDSR, 0, 1, NULL, &status, 1);
+    *pBusy = (res == SPI_OK) && (status & SPI_FLASH_SR_WIP);
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_flash_read(spi_flash_t *pFlash, uint32_t addr, uint8_t *pData, size_t len){
+    spi_err_t   res;
+    size_t      chunk;
+    uint16_t    fetch;
+    
+    // Pending writes of this area first
+    if ((pFlash->pageHi != 0) && (addr < (pFlash->pageAddr + SPI_FLASH_PAGE_SIZE)) && (pFlash->pageAddr < (addr + len))){
+        res = spi_flash_flush(pFlash);
+        if (res != SPI_OK) return res;
+    }
+    
+    // Long read : straight to the user buffer
+    if (len >= SPI_FLASH_CACHE_SIZE){
+        pFlash->nextAddr = addr + len;
+        return spi_flash_cmd(pFlash, SPI_FLASH_CMD_FAST_READ, addr, 5, NULL, pData, len);
+    }
+    
+    while (len){
+        if ((addr < pFlash->cacheAddr) || (addr >= (pFlash->cacheAddr + pFlash->cacheLen))){
+            // Miss : read ahead a whole block for sequential reads only
+            fetch = (addr == pFlash->nextAddr)?SPI_FLASH_CACHE_SIZE:(uint16_t)len;
+            res = spi_flash_cmd(pFlash, SPI_FLASH_CMD_FAST_READ, addr, 5, NULL, pFlash->cache, fetch);
+            if (res != SPI_OK){
+                pFlash->cacheLen = 0;
+                return res;
+            }
+            pFlash->cacheAddr = addr;
+            pFlash->cacheLen = fetch;
+        }
+        chunk = (size_t)(pFlash->cacheAddr + pFlash->cacheLen - addr);
+        if (chunk > len) chunk = len;
+        memcpy(pData, &pFlash->cache[addr - pFlash->cacheAddr], chunk);
+        pData += chunk;
+        addr += chunk;
+        len -= chunk;
+    }
+    pFlash->nextAddr = addr;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_flash_write(spi_flash_t *pFlash, uint32_t addr, const uint8_t *pData, size_t len){
+    spi_err_t   res;
+    uint32_t    page;
+    uint16_t    offset;
+    size_t      chunk;
+    
+    spi_flash_cache_drop(pFlash, addr, len);
+    while (len){
+        page = addr & ~((uint32_t)SPI_FLASH_PAGE_SIZE - 1);
+        offset = (uint16_t)(addr - page);
+        if ((pFlash->pageHi != 0) && (pFlash->pageAddr != page)){
+            res = spi_flash_flush(pFlash);
+            if (res != SPI_OK) return res;
+        }
+        if (pFlash->pageHi == 0){
+            pFlash->pageAddr = page;
+            pFlash->pageLo = offset;
+            pFlash->pageHi = offset;
+            memset(pFlash->page, 0xFF, SPI_FLASH_PAGE_SIZE);    // 0xFF : bytes left unchanged by the program
+        }
+        chunk = SPI_FLASH_PAGE_SIZE - offset;
+        if (chunk > len) chunk = len;
+        memcpy(&pFlash->page[offset], pData, chunk);
+        if (offset < pFlash->pageLo) pFlash->pageLo = offset;
+        if ((offset + chunk) > pFlash->pageHi) pFlash->pageHi = offset + chunk;
+        pData += chunk;
+        addr += chunk;
+        len -= chunk;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_flash_flush(spi_flash_t *pFlash){
+    spi_err_t   res;
+    
+    if (pFlash->pageHi == 0) return SPI_OK;
+    res = spi_flash_cmd(pFlash, SPI_FLASH_CMD_WREN, 0, 1, NULL, NULL, 0);
+    if (res != SPI_OK) return res;
+    res = spi_flash_cmd(pFlash, SPI_FLASH_CMD_PP, pFlash->pageAddr + pFlash->pageLo, 4, 
+                        &pFlash->page[pFlash->pageLo], NULL, pFlash->pageHi - pFlash->pageLo);
+    if (res != SPI_OK) return res;
+    // A read ahead may have cached the erased (0xFF) bytes of the page
+    spi_flash_cache_drop(pFlash, pFlash->pageAddr + pFlash->pageLo, pFlash->pageHi - pFlash->pageLo);
+    pFlash->pageHi = 0;
+    return spi_flash_wait(pFlash);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_flash_erase_sector(spi_flash_t *pFlash, uint32_t addr){
+    spi_err_t   res;
+    
+    addr &= ~(SPI_FLASH_SECTOR_SIZE - 1);
+    res = spi_flash_flush(pFlash);
+    if (res != SPI_OK) return res;
+    spi_flash_cache_drop(pFlash, addr, SPI_FLASH_SECTOR_SIZE);
+    res = spi_flash_cmd(pFlash, SPI_FLASH_CMD_WREN, 0, 1, NULL, NULL, 0);
+    if (res != SPI_OK) return res;
+    res = spi_flash_cmd(pFlash, SPI_FLASH_CMD_SE, addr, 4, NULL, NULL, 0);
+    if (res != SPI_OK) return res;
+    return spi_flash_wait(pFlash);
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,131 @@
+/**
+ * @file    lib_spi_pic24_flash.h 
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	SPI NOR flash (25 series) with read cache and page write-back 
+ *          buffer (lib_spi_pic24_ll)
+ *  
+ * - Reads use FAST READ (0x0B, 8 dummy cycles). Short reads are served by a 
+ *   RAM cache block ; on a sequential miss a whole block is read ahead.
+ * - Writes are gathered in a page buffer, programmed (0x02) once the writes 
+ *   leave the page or on spi_flash_flush. Only the span actually written is 
+ *   programmed.
+ * - Busy polling issues one short status read (0x05) per poll, the CS being 
+ *   released between polls : other devices may use the bus meanwhile (see 
+ *   pfYield).
+ *
+ */
+
+#ifndef	__LIB_SPI_PIC24_FLASH_H__
+#define	__LIB_SPI_PIC24_FLASH_H__
+#include "lib_spi_pic24_bus.h"
+
+#ifndef SPI_FLASH_CACHE_SIZE
+#define SPI_FLASH_CACHE_SIZE    64      /**< Read cache block (bytes) */
+#endif
+#ifndef SPI_FLASH_PAGE_SIZE
+#define SPI_FLASH_PAGE_SIZE     256     /**< Program page of the device (bytes, power of 2) */
+#endif
+
+// Commands
+#define SPI_FLASH_CMD_WREN          0x06    /**< Write Enable */
+#define SPI_FLASH_CMD_RDSR          0x05    /**< Read Status Register */
+#define SPI_FLASH_CMD_FAST_READ     0x0B    /**< Fast Read (1 dummy byte) */
+#define SPI_FLASH_CMD_PP            0x02    /**< Page Program */
+#define SPI_FLASH_CMD_SE            0x20    /**< Sector Erase (4 KB) */
+#define SPI_FLASH_CMD_RDID          0x9F    /**< JEDEC ID */
+
+#define SPI_FLASH_SR_WIP            (0x01 << 0)     /**< Status : Write In Progress */
+#define SPI_FLASH_SECTOR_SIZE       4096UL
+
+/** Type spi_flash_t
+ * 
+ * 
+ */
+typedef struct {
+    spi_device_t    *pDev;              /**< Device (BITS8 configuration) */
+    void            (*pfYield)(void *pCtx);     /**< Called between 2 status polls, or NULL */
+    void            *pYieldCtx;
+    uint32_t        maxPolls;           /**< Status polls before SPI_TIMEOUT (0 : no limit) */
+    
+    uint32_t        cacheAddr;          /**< Flash address of cache[0] */
+    uint16_t        cacheLen;           /**< Valid bytes in cache (0 : empty) */
+    uint32_t        nextAddr;           /**< End of the last read (sequential detection) */
+    uint8_t         cache[SPI_FLASH_CACHE_SIZE];
+    
+    uint32_t        pageAddr;           /**< Flash address of page[0] */
+    uint16_t        pageLo;             /**< Span written in page : [pageLo, pageHi[ */
+    uint16_t        pageHi;             /**< 0 : page buffer empty */
+    uint8_t         page[SPI_FLASH_PAGE_SIZE];
+    } spi_flash_t;
+
+/**
+ * @brief   Initialize a flash handle (caches empty)
+ * 
+ * @param[out]  pFlash      Flash handle
+ * @param[in]   pDev        Device handle (already initialized, BITS8 configuration)
+ * @param[in]   pfYield     Called between 2 status polls (ex : serve other devices), or NULL
+ * @param[in]   pYieldCtx   Context given back to pfYield
+ * 
+ * @return  SPI_OK
+ */
+spi_err_t   spi_flash_init(spi_flash_t *pFlash, spi_device_t *pDev, void (*pfYield)(void *pCtx), void *pYieldCtx);
+
+/**
+ * @brief   Reads the JEDEC ID (manufacturer, type, capacity)
+ */
+spi_err_t   spi_flash_read_id(spi_flash_t *pFlash, uint8_t *pId);
+
+/**
+ * @brief   Reads len bytes 
+ * 
+ * Reads of at least SPI_FLASH_CACHE_SIZE bytes go straight to pData. Shorter 
+ * reads are served by the cache ; on a miss, a whole block is read ahead if 
+ * the read follows the previous one, only the requested bytes otherwise.
+ * 
+ * @return  SPI_OK
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_flash_read(spi_flash_t *pFlash, uint32_t addr, uint8_t *pData, size_t len);
+
+/**
+ * @brief   Writes len bytes (page write-back buffer)
+ * 
+ * @return  SPI_OK
+ * @return  SPI_TIMEOUT (program of the previous page)
+ * @return  errors of spi_device_transaction
+ * 
+ * @attention : NOR flash : the target area must have been erased
+ */
+spi_err_t   spi_flash_write(spi_flash_t *pFlash, uint32_t addr, const uint8_t *pData, size_t len);
+
+/**
+ * @brief   Programs the page buffer (if any) and waits for the end of the 
+ *          program
+ * 
+ * The cached bytes of the programmed span are dropped (a read ahead may 
+ * have fetched them before the program).
+ * 
+ * @return  SPI_OK
+ * @return  SPI_TIMEOUT
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_flash_flush(spi_flash_t *pFlash);
+
+/**
+ * @brief   Erases the 4 KB sector holding addr (page buffer flushed first)
+ * 
+ * @return  SPI_OK
+ * @return  SPI_TIMEOUT
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_flash_erase_sector(spi_flash_t *pFlash, uint32_t addr);
+
+/**
+ * @brief   Non blocking busy test (one status read)
+ * 
+ * @param[out]  pBusy   1 : program / erase in progress
+ */
+spi_err_t   spi_flash_busy(spi_flash_t *pFlash, uint8_t *pBusy);
+
+#endif
@@ -10,176 +10,1350 @@
 #include "lib_spi_pic24_ll.h" // Inclusion du fichier .h  renomm
 
 /* Directives de compilation - Macros		*/
+#if SPI_USE_DMA
+#define SPI_DMA_CH(ch)      SPI_DMA_CH_(ch)
+#define SPI_DMA_CH_(ch)     ((volatile spi_dma_ch_t*)&DMACH##ch)
+#define SPI_DMA_IF(ch)      SPI_DMA_IF_(ch)
+#define SPI_DMA_IF_(ch)     _DMA##ch##IF
+#define SPI_DMA_IE(ch)      SPI_DMA_IE_(ch)
+#define SPI_DMA_IE_(ch)     _DMA##ch##IE
+#define SPI_DMA_IP(ch)      SPI_DMA_IP_(ch)
+#define SPI_DMA_IP_(ch)     _DMA##ch##IP
+#define SPI_DMA_ISR(ch)     SPI_DMA_ISR_(ch)
+#define SPI_DMA_ISR_(ch)    _DMA##ch##Interrupt
+
+#define DMAINT_FLAGS_MASK   0x00F8      /**< DMAINTn[7:3] : HIGHIF, LOWIF, DONEIF, HALFIF, OVRUNIF */
+#endif
+
+/** Statistics hooks (empty when SPI_USE_STATS is 0) */
+#if SPI_USE_STATS
+#define SPI_STAT_BEGIN(pSpi)            uint32_t statStart = spi_stats_time(pSpi)
+#define SPI_STAT_END(pSpi, res, nbB, nbW)   spi_stats_end((pSpi), statStart, (res), (nbB), (nbW))
+#define SPI_STAT_TX_SPIN()              spiStatTxSpins++
+#define SPI_STAT_RX_SPIN()              spiStatRxSpins++
+#define SPI_STAT_ERROR(pSpi)            (pSpi)->stats.nbErrors++
+#define SPI_STAT_ASYNC_START(pSpi)      (pSpi)->statsAsyncStart = spi_stats_time(pSpi)
+#define SPI_STAT_ASYNC_END(pSpi, res)   spi_stats_account((pSpi), (pSpi)->statsAsyncStart, (res),                   \
+                                            ((pSpi)->spiDataFormat == BITS8)?(pSpi)->asyncLen:0,                    \
+                                            ((pSpi)->spiDataFormat == BITS16)?(pSpi)->asyncLen:0)
+#else
+#define SPI_STAT_BEGIN(pSpi)
+#define SPI_STAT_END(pSpi, res, nbB, nbW)
+#define SPI_STAT_TX_SPIN()
+#define SPI_STAT_RX_SPIN()
+#define SPI_STAT_ERROR(pSpi)
+#define SPI_STAT_ASYNC_START(pSpi)
+#define SPI_STAT_ASYNC_END(pSpi, res)
+#endif
+
+/** Trace hooks (empty when SPI_USE_TRACE is 0) */
+#if SPI_USE_TRACE
+#define SPI_TRACE_BEGIN(op, pData, nbData)  uint32_t traceStart = spi_trace_time(); const void *pTraceData = (pData); size_t traceNbData = (nbData); const uint8_t traceOp = (op)
+#define SPI_TRACE_END(pSpi, res, len)       spi_trace_record((pSpi), traceOp, traceStart, (res), (len), pTraceData, traceNbData)
+#define SPI_TRACE_ASYNC_START(pSpi, op)     do {(pSpi)->traceAsyncStart = spi_trace_time(); (pSpi)->traceAsyncOp = (op);} while (0)
+#define SPI_TRACE_ASYNC_END(pSpi, res)      spi_trace_record((pSpi), (pSpi)->traceAsyncOp, (pSpi)->traceAsyncStart, (res), (pSpi)->asyncLen, (pSpi)->pAsyncTx,     \
+                                                ((pSpi)->spiDataFormat == BITS16)?((pSpi)->asyncLen << 1):(pSpi)->asyncLen)
+#if (SPI_TRACE_DEPTH & (SPI_TRACE_DEPTH - 1)) || (SPI_TRACE_DEPTH > 256)
+#error "SPI_TRACE_DEPTH must be a power of 2 (256 max)"
+#endif
+#else
+#define SPI_TRACE_BEGIN(op, pData, nbData)
+#define SPI_TRACE_END(pSpi, res, len)
+#define SPI_TRACE_ASYNC_START(pSpi, op)
+#define SPI_TRACE_ASYNC_END(pSpi, res)
+#endif
+
+/** Return of the blocking calls : statistics and trace updated */
+#define SPI_RETURN(pSpi, res, nbB, nbW) do {spi_err_t retRes = (res); SPI_STAT_END(pSpi, retRes, nbB, nbW); SPI_TRACE_END(pSpi, retRes, (nbB) + (nbW)); return retRes;} while (0)
+
+#if SPI_USE_BUS && ((SPI_BUS_NB_PRIO < 1) || (SPI_BUS_NB_PRIO > 16))
+#error "SPI_BUS_NB_PRIO must be 1..16"
+#endif
+
+/** Polls while cond is true, giving up (SPI_TIMEOUT) after budget polls */
+#define SPI_WAIT_TX(cond, budget)   do {uint16_t spin = (budget); while (cond){SPI_STAT_TX_SPIN(); if (--spin == 0) return SPI_TIMEOUT;}} while (0)
+#define SPI_WAIT_RX(cond, budget)   do {uint16_t spin = (budget); while (cond){SPI_STAT_RX_SPIN(); if (--spin == 0) return SPI_TIMEOUT;}} while (0)
+
+/** MODE16 value required by a segment (width 0 : MODE16 of con1) */
+#define SPI_SEG_MODE16(pSeg, con1)  (((pSeg)->width == 16)?MODE16_MASK:(((pSeg)->width == 8)?0:((con1) & MODE16_MASK)))
 
 
 /* Dclarations des variables globales 	*/
+/** Legal prescalers pairs, sorted by increasing division ratio (one pair per ratio) */
+static const struct {
+    tPriPrescaler   pri;
+    tSecPrescaler   sec;
+    } spiDividers[] = {
+    {PRI_PRE_1, SEC_PRE_2},  {PRI_PRE_1, SEC_PRE_3},  {PRI_PRE_1, SEC_PRE_4},  {PRI_PRE_1, SEC_PRE_5},
+    {PRI_PRE_1, SEC_PRE_6},  {PRI_PRE_1, SEC_PRE_7},  {PRI_PRE_1, SEC_PRE_8},  {PRI_PRE_4, SEC_PRE_3},
+    {PRI_PRE_4, SEC_PRE_4},  {PRI_PRE_4, SEC_PRE_5},  {PRI_PRE_4, SEC_PRE_6},  {PRI_PRE_4, SEC_PRE_7},
+    {PRI_PRE_4, SEC_PRE_8},  {PRI_PRE_16, SEC_PRE_3}, {PRI_PRE_16, SEC_PRE_4}, {PRI_PRE_16, SEC_PRE_5},
+    {PRI_PRE_16, SEC_PRE_6}, {PRI_PRE_16, SEC_PRE_7}, {PRI_PRE_16, SEC_PRE_8}, {PRI_PRE_64, SEC_PRE_3},
+    {PRI_PRE_64, SEC_PRE_4}, {PRI_PRE_64, SEC_PRE_5}, {PRI_PRE_64, SEC_PRE_6}, {PRI_PRE_64, SEC_PRE_7},
+    {PRI_PRE_64, SEC_PRE_8}
+    };
+/** Interrupt control of each module (SPIx and DMA Rx channel) */
+#define SPI_MODULE_IT(n)                                                                        \
+    static void spi##n##_it_enable(void){_SPI##n##IP = SPI_IT_PRIORITY; _SPI##n##IE = 1;}      \
+    static void spi##n##_it_disable(void){_SPI##n##IE = 0;}                                     \
+    static void spi##n##_it_clear_flag(void){_SPI##n##IF = 0;}
+#define SPI_MODULE_DMA_IT(n, ch)                                                                \
+    static void spi##n##_dma_it_enable(void){                                                   \
+        SPI_DMA_IF(ch) = 0; SPI_DMA_IP(ch) = SPI_DMA_IT_PRIORITY; SPI_DMA_IE(ch) = 1;}          \
+    static void spi##n##_dma_it_disable(void){SPI_DMA_IE(ch) = 0;}
 
+SPI_MODULE_IT(1)
+SPI_MODULE_IT(2)
+#ifdef _SPI3IF
+SPI_MODULE_IT(3)
+#endif
+#if SPI_USE_DMA
+SPI_MODULE_DMA_IT(1, SPI1_DMA_RX_CH)
+SPI_MODULE_DMA_IT(2, SPI2_DMA_RX_CH)
+#ifdef _SPI3IF
+SPI_MODULE_DMA_IT(3, SPI3_DMA_RX_CH)
+#endif
+#define SPI_MODULE_DMA(n)   , SPI_DMA_CH(SPI##n##_DMA_TX_CH), SPI_DMA_CH(SPI##n##_DMA_RX_CH),          \
+                            SPI##n##_DMA_TX_TRIG, SPI##n##_DMA_RX_TRIG,                                 \
+                            spi##n##_dma_it_enable, spi##n##_dma_it_disable
+#else
+#define SPI_MODULE_DMA(n)
+#endif
+#define SPI_MODULE(n)       {(volatile uint16_t*)&SPI##n##STAT, (volatile uint16_t*)&SPI##n##CON1,      \
+                             (volatile uint16_t*)&SPI##n##CON2, (volatile uint16_t*)&SPI##n##BUF,       \
+                             spi##n##_it_enable, spi##n##_it_disable, spi##n##_it_clear_flag            \
+                             SPI_MODULE_DMA(n)}
+
+/** Registers and interrupts of each module, indexed by spi_id_t */
+static const struct {
+    volatile uint16_t   *pSTAT;
+    volatile uint16_t   *pCON1;
+    volatile uint16_t   *pCON2;
+    volatile uint16_t   *pBUF;
+    void    (*pfItEnable)(void);
+    void    (*pfItDisable)(void);
+    void    (*pfItClearFlag)(void);
+#if SPI_USE_DMA
+    volatile spi_dma_ch_t   *pDmaTx;
+    volatile spi_dma_ch_t   *pDmaRx;
+    uint16_t    dmaTxTrig;
+    uint16_t    dmaRxTrig;
+    void    (*pfDmaItEnable)(void);
+    void    (*pfDmaItDisable)(void);
+#endif
+    } spiModules[SPI_NB_MODULES] = {
+    SPI_MODULE(1),
+    SPI_MODULE(2),
+#ifdef _SPI3IF
+    SPI_MODULE(3),
+#endif
+    };
+static spi_desc_t   *pSpiIsrDesc[SPI_NB_MODULES];   /**< Descriptor served by each SPIx ISR */
+#if SPI_USE_DMA
+static uint16_t     spiDmaDummy = 0xFFFF;   /**< Tx source of Rx only DMA transfers (RAM) */
+static uint16_t     spiDmaSink;             /**< Rx destination of Tx only DMA transfers */
+#endif
+/** CRC tables (MSB first) : CRC7 x^7+x^3+1 (left aligned), CRC8 x^8+x^2+x+1, CRC16 x^16+x^12+x^5+1 */
+static const uint8_t   spiCrc7Table[256] = {
+    0x00, 0x12, 0x24, 0x36, 0x48, 0x5A, 0x6C, 0x7E, 0x90, 0x82, 0xB4, 0xA6, 0xD8, 0xCA, 0xFC, 0xEE,
+    0x32, 0x20, 0x16, 0x04, 0x7A, 0x68, 0x5E, 0x4C, 0xA2, 0xB0, 0x86, 0x94, 0xEA, 0xF8, 0xCE, 0xDC,
+    0x64, 0x76, 0x40, 0x52, 0x2C, 0x3E, 0x08, 0x1A, 0xF4, 0xE6, 0xD0, 0xC2, 0xBC, 0xAE, 0x98, 0x8A,
+    0x56, 0x44, 0x72, 0x60, 0x1E, 0x0C, 0x3A, 0x28, 0xC6, 0xD4, 0xE2, 0xF0, 0x8E, 0x9C, 0xAA, 0xB8,
+    0xC8, 0xDA, 0xEC, 0xFE, 0x80, 0x92, 0xA4, 0xB6, 0x58, 0x4A, 0x7C, 0x6E, 0x10, 0x02, 0x34, 0x26,
+    0xFA, 0xE8, 0xDE, 0xCC, 0xB2, 0xA0, 0x96, 0x84, 0x6A, 0x78, 0x4E, 0x5C, 0x22, 0x30, 0x06, 0x14,
+    0xAC, 0xBE, 0x88, 0x9A, 0xE4, 0xF6, 0xC0, 0xD2, 0x3C, 0x2E, 0x18, 0x0A, 0x74, 0x66, 0x50, 0x42,
+    0x9E, 0x8C, 0xBA, 0xA8, 0xD6, 0xC4, 0xF2, 0xE0, 0x0E, 0x1C, 0x2A, 0x38, 0x46, 0x54, 0x62, 0x70,
+    0x82, 0x90, 0xA6, 0xB4, 0xCA, 0xD8, 0xEE, 0xFC, 0x12, 0x00, 0x36, 0x24, 0x5A, 0x48, 0x7E, 0x6C,
+    0xB0, 0xA2, 0x94, 0x86, 0xF8, 0xEA, 0xDC, 0xCE, 0x20, 0x32, 0x04, 0x16, 0x68, 0x7A, 0x4C, 0x5E,
+    0xE6, 0xF4, 0xC2, 0xD0, 0xAE, 0xBC, 0x8A, 0x98, 0x76, 0x64, 0x52, 0x40, 0x3E, 0x2C, 0x1A, 0x08,
+    0xD4, 0xC6, 0xF0, 0xE2, 0x9C, 0x8E, 0xB8, 0xAA, 0x44, 0x56, 0x60, 0x72, 0x0C, 0x1E, 0x28, 0x3A,
+    0x4A, 0x58, 0x6E, 0x7C, 0x02, 0x10, 0x26, 0x34, 0xDA, 0xC8, 0xFE, 0xEC, 0x92, 0x80, 0xB6, 0xA4,
+    0x78, 0x6A, 0x5C, 0x4E, 0x30, 0x22, 0x14, 0x06, 0xE8, 0xFA, 0xCC, 0xDE, 0xA0, 0xB2, 0x84, 0x96,
+    0x2E, 0x3C, 0x0A, 0x18, 0x66, 0x74, 0x42, 0x50, 0xBE, 0xAC, 0x9A, 0x88, 0xF6, 0xE4, 0xD2, 0xC0,
+    0x1C, 0x0E, 0x38, 0x2A, 0x54, 0x46, 0x70, 0x62, 0x8C, 0x9E, 0xA8, 0xBA, 0xC4, 0xD6, 0xE0, 0xF2
+    };
+static const uint8_t   spiCrc8Table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+    };
+static const uint16_t  spiCrc16Table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+    };
+#if SPI_USE_STATS
+static uint32_t     spiStatTxSpins;         /**< Spins of the blocking call in progress */
+static uint32_t     spiStatRxSpins;
+#endif
+#if SPI_USE_TRACE
+static spi_trace_rec_t  spiTrace[SPI_TRACE_DEPTH];  /**< Trace ring, shared by all the modules */
+static volatile uint16_t spiTraceHead;              /**< Next record written (free running, ISRs included) */
+static volatile uint16_t spiTraceTail;              /**< Next record drained (free running) */
+static volatile uint16_t spiTraceLost;
+static uint8_t          spiTraceOn;
+static spi_timer_t      pfSpiTraceTimer;
+#endif
 
 /*	Implmentation du code */
-spi_err_t   spi_init(spi_id_t spi_id, spi_config_t* pSpiCFG, spi_desc_t *pSpi)
-{
-    uint16_t    tmpReg;
-    pSpi->spiID = spi_id;
-    switch(spi_id){
-        case _SPI1:
-            pSpi->pSPIxSTAT = (uint16_t*)&SPI1STAT;
-            pSpi->pSPIxCON1 = (uint16_t*)&SPI1CON1;
-            pSpi->pSPIxCON2 = (uint16_t*)&SPI1CON2;
-            pSpi->pSPIBUF = (uint16_t*)&SPI1BUF;
-            IFS0bits.SPI1IF = 0;
-            break;
-        case _SPI2:
-            pSpi->pSPIxSTAT = (uint16_t*)&SPI2STAT;
-            pSpi->pSPIxCON1 = (uint16_t*)&SPI2CON1;
-            pSpi->pSPIxCON2 = (uint16_t*)&SPI2CON2;
-            pSpi->pSPIBUF = (uint16_t*)&SPI2BUF;
-            IFS2bits.SPI2IF = 0;
-            break;
-        default:
-            return SPI_UNKNOWN_MODULE;
-            break;
-    }
-    
-    // Configuration effective
-    // SPIxCON1
+#if SPI_USE_STATS
+static uint32_t spi_stats_time(spi_desc_t *pSpi){
+    return (pSpi->pfStatsTimer == NULL)?0:pSpi->pfStatsTimer();
+}
+//------------------------------------------------------------------------------
+static void spi_stats_reset(spi_stats_t *pStats){
+    static const spi_stats_t zero;
     
-    // Secondary Presecaler
-    switch(pSpiCFG->spiSecondaryPrescaler){
-        case SEC_PRE_1: tmpReg = 0b111;break;
-        case SEC_PRE_2: tmpReg = 0b110;break;
-        case SEC_PRE_3: tmpReg = 0b101;break;
-        case SEC_PRE_4: tmpReg = 0b100;break;
-        case SEC_PRE_5: tmpReg = 0b011;break;
-        case SEC_PRE_6: tmpReg = 0b010;break;
-        case SEC_PRE_7: tmpReg = 0b001;break;
-        case SEC_PRE_8: tmpReg = 0b000;break;    
-    }
-    tmpReg <<= 2;
-    
-    // Primary Presecaler
-    switch(pSpiCFG->spiPrimaryPrescaler){
-        case PRI_PRE_1  : tmpReg += 0b11;break;
-        case PRI_PRE_4  : tmpReg += 0b10;break;
-        case PRI_PRE_16 : tmpReg += 0b01;break;
-        case PRI_PRE_64 : tmpReg += 0b00;break;
-    } 
-    
-    // Data format
-    pSpi->spiDataFormat = pSpiCFG->spiDataFormat;
-    if (pSpiCFG->spiDataFormat == BITS8) tmpReg &= ~(MODE16_MASK);
-    else tmpReg |= MODE16_MASK;
-    
-    // Sample point
-    if (pSpiCFG->spiSamplePoint == MID_SMP) tmpReg &= ~(SMP_MASK);
-    else tmpReg |= SMP_MASK;
-    
-    // Clock Phase
-    if (pSpiCFG->spiClockPhase == IDLE_TO_ACTIVE_CPHASE) tmpReg &= ~(CKE_MASK);
-    else tmpReg |= CKE_MASK;
-    
-    // Clock Polarity
-    if (pSpiCFG->spiClockPolarity == CLK_IDLE_IS_LOW) tmpReg &= ~(CKP_MASK);
-    else tmpReg |= CKP_MASK;
+    *pStats = zero;
+    pStats->durMin = 0xFFFFFFFF;
+}
+//------------------------------------------------------------------------------
+/**
+ * Accounts one completed transfer (also run by the ISRs)
+ */
+static void spi_stats_account(spi_desc_t *pSpi, uint32_t start, spi_err_t res, size_t nbBytes, size_t nbWords){
+    spi_stats_t *pStats = &pSpi->stats;
+    uint32_t    dur;
     
-    // SSEN : SSx pin is not used by module; pin is controlled by port function (0))
-    tmpReg &= ~(SSEN_MASK);
+    if (res == SPI_OVERRUN) pStats->nbOverruns++;
+    if (res != SPI_OK){
+        pStats->nbErrors++;
+        return;
+    }
+    pStats->nbBytes += nbBytes;
+    pStats->nbWords += nbWords;
+    pStats->nbTransactions++;
+    if (pSpi->pfStatsTimer != NULL){
+        dur = pSpi->pfStatsTimer() - start;
+        if (dur < pStats->durMin) pStats->durMin = dur;
+        if (dur > pStats->durMax) pStats->durMax = dur;
+        pStats->durSum += dur;
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * End of a blocking call : spins collected by the engines + accounting
+ */
+static void spi_stats_end(spi_desc_t *pSpi, uint32_t start, spi_err_t res, size_t nbBytes, size_t nbWords){
+    pSpi->stats.txSpins += spiStatTxSpins;
+    pSpi->stats.rxSpins += spiStatRxSpins;
+    spiStatTxSpins = 0;
+    spiStatRxSpins = 0;
+    spi_stats_account(pSpi, start, res, nbBytes, nbWords);
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_TRACE
+static uint32_t spi_trace_time(void){
+    return (pfSpiTraceTimer == NULL)?0:pfSpiTraceTimer();
+}
+//------------------------------------------------------------------------------
+/**
+ * Adds one record to the trace ring (also run by the ISRs)
+ * 
+ * The record is written with the interrupts disabled : a record is never
+ * seen half written by spi_trace_drain, nor shared by an ISR.
+ */
+static void spi_trace_record(spi_desc_t *pSpi, uint8_t op, uint32_t start, spi_err_t res, size_t len, const void *pData, size_t nbData){
+    spi_trace_rec_t *pRec;
+    uint8_t     i;
     
-    // MSTEN : Master Mode (1)
-    tmpReg |= MSTEN_MASK;
+    if (!spiTraceOn) return;
+    __builtin_disi(0x3FFF);
+    if ((uint16_t)(spiTraceHead - spiTraceTail) >= SPI_TRACE_DEPTH){
+        spiTraceLost++;
+        __builtin_disi(0x0000);
+        return;
+    }
+    pRec = &spiTrace[spiTraceHead & (SPI_TRACE_DEPTH - 1)];
+    pRec->start = start;
+    pRec->end = spi_trace_time();
+    pRec->len = (uint16_t)len;
+    pRec->module = (uint8_t)pSpi->spiID;
+    pRec->tag = pSpi->traceTag;
+    pRec->op = op;
+    pRec->result = (uint8_t)res;
+    for (i = 0; i < SPI_TRACE_DATA; i++) pRec->data[i] = ((pData == NULL) || (i >= nbData))?0xFF:((const uint8_t*)pData)[i];
+    spiTraceHead++;
+    __builtin_disi(0x0000);
+}
+//------------------------------------------------------------------------------
+#endif
+/**
+ * SPI_XFER_IDLE cutover : the core is idled only when a frame (duration given 
+ * by the prescalers) lasts at least SPI_IDLE_MIN_CYCLES
+ */
+static void spi_idle_cutover(spi_desc_t *pSpi){
+    uint16_t    con1 = pSpi->con1;
+    
+    pSpi->idleWait = (pSpi->spiTransferMode == SPI_XFER_IDLE) && (con1 & MSTEN_MASK)
+                    && ((SPI_PRI_DIV(con1 & 0x03) * SPI_SEC_DIV((con1 >> 2) & 0x07) * ((con1 & MODE16_MASK)?16U:8U)) >= SPI_IDLE_MIN_CYCLES);
+}
+//------------------------------------------------------------------------------
+/**
+ * Writes the configuration registers (module disabled meanwhile) 
+ */
+static void spi_apply_regs(spi_desc_t *pSpi, uint16_t con1, uint16_t con2){
+    uint16_t    tmpReg;
     
-    *(pSpi->pSPIxCON1) = tmpReg;
+    // Module disabled while being configured
+    *(pSpi->pSPIxSTAT) = 0x0000;
+    
+    //------------------------------------------
+    // SPIxCON1
+    *(pSpi->pSPIxCON1) = con1;
+    pSpi->con1 = con1;
+    pSpi->spiDataFormat = (con1 & MODE16_MASK)?BITS16:BITS8;
     
     //------------------------------------------
     // SPIxCON2
-    tmpReg = 0x0000;
-    *(pSpi->pSPIxCON2) = tmpReg;
+    *(pSpi->pSPIxCON2) = con2;
+    pSpi->con2 = con2;
+    spi_idle_cutover(pSpi);
+    
+    // SPIBEN is not implemented on every device : read it back
+    if (*(pSpi->pSPIxCON2) & SPIBEN_MASK) pSpi->spiBufferMode = ENHANCED_BUFFER;
+    else pSpi->spiBufferMode = STANDARD_BUFFER;
      
     //------------------------------------------
     // SPIxSTAT
     tmpReg = 0x0000;
     // SPIEN : Enable SPI module
     tmpReg |= SPIEN_MASK;
+    // SISEL : SPIxIF is set when the Rx FIFO is not empty (Enhanced Buffer mode)
+    if (pSpi->spiBufferMode == ENHANCED_BUFFER) tmpReg |= SISEL_RX_NOT_EMPTY;
     
     *(pSpi->pSPIxSTAT) = tmpReg;
+}
+//------------------------------------------------------------------------------
+/**
+ * Switches MODE16 between two runs of a transfer, when it changes. Every 
+ * frame sent has been received (module idle, FIFOs empty). SPIxCON1 may only 
+ * be written with the module disabled : SPIEN is cleared for the write and 
+ * set back, SISEL and SPIxCON2 are kept. The CS line stays asserted, SCK / 
+ * SDO being driven by their port latches while SPIEN = 0 (the SCK latch must 
+ * hold the idle level given by CKP, so that no clock edge reaches the slave).
+ */
+static void spi_set_mode16(spi_desc_t *pSpi, uint16_t mode16){
+    uint16_t    con1 = (pSpi->con1 & ~MODE16_MASK) | mode16;
+    uint16_t    stat;
     
-    //------------------------------------------
+    if (con1 == pSpi->con1) return;
+    stat = *(pSpi->pSPIxSTAT);
+    *(pSpi->pSPIxSTAT) = stat & ~SPIEN_MASK;
+    *(pSpi->pSPIxCON1) = con1;
+    *(pSpi->pSPIxSTAT) = stat;
+    pSpi->con1 = con1;
+    pSpi->spiDataFormat = mode16?BITS16:BITS8;
+    spi_idle_cutover(pSpi);
+}
+//------------------------------------------------------------------------------
+/**
+ * Checks the end of a blocking transfer : after a timeout or an overrun the 
+ * module is reset (FIFOs flushed, SPIROV cleared)
+ */
+static spi_err_t   spi_check(spi_desc_t *pSpi, spi_err_t res){
+    if ((res == SPI_OK) && (*(pSpi->pSPIxSTAT) & SPIROV_MASK)) res = SPI_OVERRUN;
+    if ((res == SPI_TIMEOUT) || (res == SPI_OVERRUN)) spi_apply_regs(pSpi, pSpi->con1, pSpi->con2);
+    return res;
+}
+//------------------------------------------------------------------------------
+/**
+ * Burst engines (Enhanced Buffer mode only)
+ * The Tx FIFO is kept full while the Rx FIFO is drained. No more than 
+ * SPI_FIFO_DEPTH frames are in flight so that the Rx FIFO can never overflow.
+ * The engines give up (SPI_TIMEOUT) after spinBudget polling rounds without 
+ * any received frame.
+ */
+static spi_err_t   spi_burst_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    size_t  txIdx = 0;
+    size_t  rxIdx = 0;
+    uint16_t    dummy;
+    uint16_t    spin = pSpi->spinBudget;
+    
+    while (rxIdx < len){
+        SPI_STAT_RX_SPIN();
+        if (--spin == 0) return SPI_TIMEOUT;
+        // Fill Tx FIFO
+        while ((txIdx < len) && ((txIdx - rxIdx) < SPI_FIFO_DEPTH) && !(*pStat & SPITBF_MASK)){
+            *pBuf = (pTxData == NULL)?0xFF:pTxData[txIdx];
+            txIdx++;
+        }
+        // Drain Rx FIFO
+        while ((rxIdx < txIdx) && !(*pStat & SRXMPT_MASK)){
+            dummy = *pBuf;
+            if (pRxData != NULL) pRxData[rxIdx] = (uint8_t)dummy;
+            rxIdx++;
+            spin = pSpi->spinBudget;
+        }
+    }
     return SPI_OK;
 }
 //------------------------------------------------------------------------------
-spi_err_t   spi_transfer_raw_byte(spi_desc_t *pSpi, uint8_t TxData, uint8_t *pRxData){
-    uint16_t    dummy;   
-    if (pSpi->spiDataFormat != BITS8) return SPI_BAD_DATA_FORMAT;
-    switch(pSpi->spiID)
-    {
-        case _SPI1:
-            while(SPI1STATbits.SPITBF);     // Attente buffer Tx vide
-            SPI1BUF = TxData;
-            while(!IFS0bits.SPI1IF);        // Attente fin Tx
-            dummy = SPI1BUF;           // SPIxBUFF MUST be read...
-            IFS0bits.SPI1IF = 0;
-            break;
-            
-        case _SPI2:
-            while(SPI2STATbits.SPITBF);     // Attente buffer Tx vide
-            SPI2BUF = TxData;
-            while(!IFS2bits.SPI2IF);        // Attente fin Tx
-            dummy = SPI2BUF;           // SPIxBUFF MUST be read...
-            IFS2bits.SPI2IF = 0;
-            break;
-        default: return SPI_UNKNOWN_MODULE;
-    }
-    if (pRxData != NULL) *pRxData = (uint8_t)dummy;
+static spi_err_t   spi_burst_words(spi_desc_t *pSpi, const uint16_t *pTxData, uint16_t *pRxData, size_t len){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    size_t  txIdx = 0;
+    size_t  rxIdx = 0;
+    uint16_t    dummy;
+    uint16_t    spin = pSpi->spinBudget;
+    
+    while (rxIdx < len){
+        SPI_STAT_RX_SPIN();
+        if (--spin == 0) return SPI_TIMEOUT;
+        // Fill Tx FIFO
+        while ((txIdx < len) && ((txIdx - rxIdx) < SPI_FIFO_DEPTH) && !(*pStat & SPITBF_MASK)){
+            *pBuf = (pTxData == NULL)?0xFFFF:pTxData[txIdx];
+            txIdx++;
+        }
+        // Drain Rx FIFO
+        while ((rxIdx < txIdx) && !(*pStat & SRXMPT_MASK)){
+            dummy = *pBuf;
+            if (pRxData != NULL) pRxData[rxIdx] = dummy;
+            rxIdx++;
+            spin = pSpi->spinBudget;
+        }
+    }
     return SPI_OK;
 }
 //------------------------------------------------------------------------------
-spi_err_t   spi_transfer_raw_word(spi_desc_t *pSpi, uint16_t TxData, uint16_t *pRxData){
-    uint16_t    dummy;   
-    if (pSpi->spiDataFormat != BITS16) return SPI_BAD_DATA_FORMAT;
-    switch(pSpi->spiID)
-    {
-        case _SPI1:
-            while(SPI1STATbits.SPITBF);     // Attente buffer Tx vide
-            SPI1BUF = TxData;
-            while(!IFS0bits.SPI1IF);        // Attente fin Tx
-            dummy = SPI1BUF;           // SPIxBUFF MUST be read...
-            IFS0bits.SPI1IF = 0;
-            break;
-            
-        case _SPI2:
-            while(SPI2STATbits.SPITBF);     // Attente buffer Tx vide
-            SPI2BUF = TxData;
-            while(!IFS2bits.SPI2IF);        // Attente fin Tx
-            dummy = SPI2BUF;           // SPIxBUFF MUST be read...
-            IFS2bits.SPI2IF = 0;
-            break;
-        default: return SPI_UNKNOWN_MODULE;
-    }
-    if (pRxData != NULL) *pRxData = dummy;
+/**
+ * Hot loops (Standard Buffer mode)
+ * The module, data format and buffer tests are resolved once per call by the 
+ * caller : each loop only moves data. The end of each frame is detected with 
+ * SPIRBF (SPIxSTAT) so the loops do not depend on the module specific IFSx 
+ * register ; SPIxIF is left set, it is cleared by the interrupt engines 
+ * before use.
+ * SPITBF is not tested within the loops : once the previous frame is received
+ * the Tx buffer is always empty.
+ * Each frame is given up to budget polls of SPIRBF (SPI_TIMEOUT).
+ */
+static spi_err_t   spi_wait_tx(volatile uint16_t *pStat, uint16_t budget){
+    SPI_WAIT_TX(*pStat & SPITBF_MASK, budget);
     return SPI_OK;
 }
 //------------------------------------------------------------------------------
-spi_err_t   spi_transfer_raw_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len){
-    spi_err_t res;
-    size_t  i;
-    if (pSpi->spiDataFormat != BITS8) return SPI_BAD_DATA_FORMAT;
-    for (i=0;i<len;i++){
-        res = spi_transfer_raw_byte(pSpi,(pTxData==NULL)?0xFF:pTxData[i],(pRxData==NULL)?NULL:&pRxData[i]);
-        if (res != SPI_OK) return res;
+static spi_err_t   spi_loop_fill(volatile uint16_t *pStat, volatile uint16_t *pBuf, uint16_t fill, size_t len, uint16_t budget){
+    while (len--){
+        *pBuf = fill;
+        SPI_WAIT_RX(!(*pStat & SPIRBF_MASK), budget);
+        (void)*pBuf;                    // SPIxBUFF MUST be read...
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+static spi_err_t   spi_loop_tx_bytes(volatile uint16_t *pStat, volatile uint16_t *pBuf, const uint8_t *pTxData, size_t len, uint16_t budget){
+    while (len--){
+        *pBuf = *pTxData++;
+        SPI_WAIT_RX(!(*pStat & SPIRBF_MASK), budget);
+        (void)*pBuf;                    // SPIxBUFF MUST be read...
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+static spi_err_t   spi_loop_rx_bytes(volatile uint16_t *pStat, volatile uint16_t *pBuf, uint8_t *pRxData, size_t len, uint16_t budget){
+    while (len--){
+        *pBuf = 0xFF;
+        SPI_WAIT_RX(!(*pStat & SPIRBF_MASK), budget);
+        *pRxData++ = (uint8_t)*pBuf;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+static spi_err_t   spi_loop_txrx_bytes(volatile uint16_t *pStat, volatile uint16_t *pBuf, const uint8_t *pTxData, uint8_t *pRxData, size_t len, uint16_t budget){
+    while (len--){
+        *pBuf = *pTxData++;
+        SPI_WAIT_RX(!(*pStat & SPIRBF_MASK), budget);
+        *pRxData++ = (uint8_t)*pBuf;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+static spi_err_t   spi_loop_tx_words(volatile uint16_t *pStat, volatile uint16_t *pBuf, const uint16_t *pTxData, size_t len, uint16_t budget){
+    while (len--){
+        *pBuf = *pTxData++;
+        SPI_WAIT_RX(!(*pStat & SPIRBF_MASK), budget);
+        (void)*pBuf;                    // SPIxBUFF MUST be read...
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+static spi_err_t   spi_loop_rx_words(volatile uint16_t *pStat, volatile uint16_t *pBuf, uint16_t *pRxData, size_t len, uint16_t budget){
+    while (len--){
+        *pBuf = 0xFFFF;
+        SPI_WAIT_RX(!(*pStat & SPIRBF_MASK), budget);
+        *pRxData++ = *pBuf;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+static spi_err_t   spi_loop_txrx_words(volatile uint16_t *pStat, volatile uint16_t *pBuf, const uint16_t *pTxData, uint16_t *pRxData, size_t len, uint16_t budget){
+    while (len--){
+        *pBuf = *pTxData++;
+        SPI_WAIT_RX(!(*pStat & SPIRBF_MASK), budget);
+        *pRxData++ = *pBuf;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+/**
+ * Received frame available ?
+ * Standard Buffer mode : SPIRBF is set once a frame is received 
+ * Enhanced Buffer mode : SRXMPT is cleared while the Rx FIFO is not empty
+ */
+static uint16_t spi_rx_ready(spi_desc_t *pSpi){
+    if (pSpi->spiBufferMode == ENHANCED_BUFFER) return !(*(pSpi->pSPIxSTAT) & SRXMPT_MASK);
+    return (*(pSpi->pSPIxSTAT) & SPIRBF_MASK);
+}
+//------------------------------------------------------------------------------
+/**
+ * Idle engine (SPI_XFER_IDLE, both buffer modes) : one frame at a time, the 
+ * core idles until SPIxIF is set (frame received). With the CPU priority 
+ * raised to SPI_IT_PRIORITY the flag only wakes the core up, the ISR is not 
+ * vectored. A flag set before Idle() is reached makes Idle() return at once.
+ * The priority is raised for one frame only : the flag is cleared and the 
+ * priority restored between frames, so that the interrupts held meanwhile 
+ * are served (latency of one frame at most).
+ * Each frame is given up to spinBudget wake-ups (SPI_TIMEOUT).
+ */
+static spi_err_t   spi_idle_run(spi_desc_t *pSpi, const void *pTxData, void *pRxData, size_t len){
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    uint16_t    fill = (pSpi->spiDataFormat == BITS16)?0xFFFF:0xFF;
+    uint16_t    ipl = SRbits.IPL;
+    uint16_t    data, spin;
+    size_t      idx;
+    spi_err_t   res = SPI_OK;
+    
+    // Flag of a previous frame cleared first : the ISR must not be vectored
+    spiModules[pSpi->spiID].pfItClearFlag();
+    spiModules[pSpi->spiID].pfItEnable();
+    for (idx = 0; idx < len; idx++){
+        if (pTxData == NULL) data = fill;
+        else if (pSpi->spiDataFormat == BITS8) data = ((const uint8_t*)pTxData)[idx];
+        else data = ((const uint16_t*)pTxData)[idx];
+        if (ipl < SPI_IT_PRIORITY) SRbits.IPL = SPI_IT_PRIORITY;
+        spiModules[pSpi->spiID].pfItClearFlag();
+        *pBuf = data;
+        spin = pSpi->spinBudget;
+        while (!spi_rx_ready(pSpi) && (res == SPI_OK)){
+            Idle();
+            spiModules[pSpi->spiID].pfItClearFlag();
+            SPI_STAT_RX_SPIN();
+            if (--spin == 0) res = SPI_TIMEOUT;
+        }
+        if (res == SPI_OK) data = *pBuf;
+        // No frame in flight : SPIxIF cleared, then the interrupts held are served
+        spiModules[pSpi->spiID].pfItClearFlag();
+        SRbits.IPL = ipl;
+        if (res != SPI_OK) break;
+        if (pRxData == NULL) continue;
+        if (pSpi->spiDataFormat == BITS8) ((uint8_t*)pRxData)[idx] = (uint8_t)data;
+        else ((uint16_t*)pRxData)[idx] = data;
+    }
+    spiModules[pSpi->spiID].pfItDisable();
+    spiModules[pSpi->spiID].pfItClearFlag();
+    return res;
+}
+//------------------------------------------------------------------------------
+#if SPI_USE_ASYNC
+/**
+ * Asynchronous engine : loads the Tx buffer / FIFO 
+ */
+static void spi_async_fill(spi_desc_t *pSpi){
+    size_t  depth = (pSpi->spiBufferMode == ENHANCED_BUFFER)?SPI_FIFO_DEPTH:1;
+    size_t  txIdx = pSpi->asyncTxIdx;
+    uint16_t    data;
+    
+    while ((txIdx < pSpi->asyncLen) && ((txIdx - pSpi->asyncRxIdx) < depth) && !(*(pSpi->pSPIxSTAT) & SPITBF_MASK)){
+        if (pSpi->pAsyncTx == NULL) data = (pSpi->spiDataFormat == BITS8)?0xFF:0xFFFF;
+        else if (pSpi->spiDataFormat == BITS8) data = ((const uint8_t*)pSpi->pAsyncTx)[txIdx];
+        else data = ((const uint16_t*)pSpi->pAsyncTx)[txIdx];
+        *(pSpi->pSPIBUF) = data;
+        txIdx++;
+    }
+    pSpi->asyncTxIdx = txIdx;
+}
+//------------------------------------------------------------------------------
+/**
+ * Asynchronous engine : run by the SPIx ISR
+ */
+static void spi_async_isr(spi_desc_t *pSpi){
+    size_t  rxIdx = pSpi->asyncRxIdx;
+    uint16_t    data;
+    spi_err_t   res;
+    
+    // Drain received frames
+    while ((rxIdx < pSpi->asyncTxIdx) && spi_rx_ready(pSpi)){
+        data = *(pSpi->pSPIBUF);
+        if (pSpi->pAsyncRx != NULL){
+            if (pSpi->spiDataFormat == BITS8) ((uint8_t*)pSpi->pAsyncRx)[rxIdx] = (uint8_t)data;
+            else ((uint16_t*)pSpi->pAsyncRx)[rxIdx] = data;
+        }
+        rxIdx++;
+    }
+    pSpi->asyncRxIdx = rxIdx;
+    
+    if (rxIdx < pSpi->asyncLen){
+        spi_async_fill(pSpi);
+        return;
+    }
+    
+    // Transfer completed
+    spiModules[pSpi->spiID].pfItDisable();
+    pSpiIsrDesc[pSpi->spiID] = NULL;
+    pSpi->pfIsrHandler = NULL;
+    res = spi_check(pSpi, SPI_OK);
+    SPI_STAT_ASYNC_END(pSpi, res);
+    SPI_TRACE_ASYNC_END(pSpi, res);
+    pSpi->asyncStatus = SPI_ASYNC_DONE;
+    if (pSpi->pfCallback != NULL) pSpi->pfCallback(pSpi, res, pSpi->pCallbackCtx);
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_STREAM
+/**
+ * Streaming engine : run by the SPIx ISR
+ * asyncTxIdx counts the frames in flight. With a per frame CS, the CS line is 
+ * asserted before each frame is loaded and released once it is received.
+ */
+static void spi_stream_isr(spi_desc_t *pSpi){
+    size_t  depth = ((pSpi->pStreamCs == NULL) && (pSpi->spiBufferMode == ENHANCED_BUFFER))?SPI_FIFO_DEPTH:1;
+    size_t  slotLen = pSpi->asyncLen;
+    uint16_t    data;
+    void    *pSlot;
+    
+    // Drain received frames
+    while (pSpi->asyncTxIdx && spi_rx_ready(pSpi)){
+        data = *(pSpi->pSPIBUF);
+        pSpi->asyncTxIdx--;
+        if (pSpi->pStreamCs != NULL) spi_cs_release(pSpi->pStreamCs);
+        if (!pSpi->streamDrop){
+            if (pSpi->spiDataFormat == BITS8) ((uint8_t*)pSpi->pAsyncRx)[(pSpi->streamSlot * slotLen) + pSpi->streamIdx] = (uint8_t)data;
+            else ((uint16_t*)pSpi->pAsyncRx)[(pSpi->streamSlot * slotLen) + pSpi->streamIdx] = data;
+        }
+        if (++pSpi->streamIdx < slotLen) continue;
+        
+        // Block completed
+        pSpi->streamIdx = 0;
+        if (!pSpi->streamDrop){
+            if (pSpi->spiDataFormat == BITS8) pSlot = &((uint8_t*)pSpi->pAsyncRx)[pSpi->streamSlot * slotLen];
+            else pSlot = &((uint16_t*)pSpi->pAsyncRx)[pSpi->streamSlot * slotLen];
+            pSpi->streamHeld[pSpi->streamSlot] = 1;
+            if (++pSpi->streamSlot >= pSpi->streamNbSlots) pSpi->streamSlot = 0;
+            pSpi->pfStreamCallback(pSpi, pSlot, pSpi->pCallbackCtx);
+        }
+        // Next block : discarded if the slot is still owned by the application
+        pSpi->streamDrop = pSpi->streamHeld[pSpi->streamSlot];
+        if (pSpi->streamDrop) pSpi->streamOverflows++;
+    }
+    
+    // Load the next frame(s)
+    while ((pSpi->asyncTxIdx < depth) && !(*(pSpi->pSPIxSTAT) & SPITBF_MASK)){
+        if (pSpi->pStreamCs != NULL) spi_cs_assert(pSpi->pStreamCs);
+        *(pSpi->pSPIBUF) = pSpi->streamCmd;
+        pSpi->asyncTxIdx++;
+    }
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_SLAVE
+/**
+ * Ring accessors for a single frame (producer : spi_ring_put, consumer : 
+ * spi_ring_get). The frame is stored / read before the index is published.
+ */
+static uint16_t spi_ring_put(spi_ring_t *pRing, uint16_t data){
+    uint16_t    head = pRing->head;
+    
+    if ((uint16_t)(head - pRing->tail) > pRing->mask) return 0;     // Full
+    if (pRing->format == BITS8) ((uint8_t*)pRing->pBuf)[head & pRing->mask] = (uint8_t)data;
+    else ((uint16_t*)pRing->pBuf)[head & pRing->mask] = data;
+    pRing->head = head + 1;
+    return 1;
+}
+//------------------------------------------------------------------------------
+static uint16_t spi_ring_get(spi_ring_t *pRing, uint16_t *pData){
+    uint16_t    tail = pRing->tail;
+    
+    if (tail == pRing->head) return 0;      // Empty
+    if (pRing->format == BITS8) *pData = ((const uint8_t*)pRing->pBuf)[tail & pRing->mask];
+    else *pData = ((const uint16_t*)pRing->pBuf)[tail & pRing->mask];
+    pRing->tail = tail + 1;
+    return 1;
+}
+//------------------------------------------------------------------------------
+/**
+ * Slave engine : loads the Tx buffer / FIFO until it is full 
+ */
+static void spi_slave_fill(spi_desc_t *pSpi, uint8_t countUnderruns){
+    uint16_t    data;
+    
+    while (!(*(pSpi->pSPIxSTAT) & SPITBF_MASK)){
+        if ((pSpi->pSlaveTx == NULL) || !spi_ring_get(pSpi->pSlaveTx, &data)){
+            data = pSpi->slaveFill;
+            if (countUnderruns && (pSpi->pSlaveTx != NULL)) pSpi->slaveUnderruns++;
+        }
+        *(pSpi->pSPIBUF) = data;
     }
+}
+//------------------------------------------------------------------------------
+/**
+ * Slave engine : run by the SPIx ISR
+ */
+static void spi_slave_isr(spi_desc_t *pSpi){
+    uint16_t    data;
+    
+    // Drain received frames
+    while (spi_rx_ready(pSpi)){
+        data = *(pSpi->pSPIBUF);
+        if ((pSpi->pSlaveRx != NULL) && !spi_ring_put(pSpi->pSlaveRx, data)) pSpi->slaveOverruns++;
+    }
+    // Frame lost by the module (the ISR came too late)
+    if (*(pSpi->pSPIxSTAT) & SPIROV_MASK){
+        *(pSpi->pSPIxSTAT) &= ~SPIROV_MASK;
+        pSpi->slaveOverruns++;
+    }
+    // Next frame(s) loaded before the master clocks them
+    spi_slave_fill(pSpi, 1);
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_SCRIPT
+/**
+ * Script engine : number of frames of a step (0 : not a frame step)
+ */
+static uint16_t spi_script_frames(const spi_script_op_t *pOp){
+    switch(pOp->op){
+        case SPI_OP_TX_LIT: return 1;
+        case SPI_OP_TX_BUF:
+        case SPI_OP_RX_BUF:
+        case SPI_OP_DELAY:  return pOp->arg;
+        default:            return 0;
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * Script engine : run by the SPIx ISR
+ * asyncTxIdx counts the frames in flight. The Tx side (scriptTxOp) runs 
+ * ahead of the Rx side (scriptRxOp) across the frame steps only : the other 
+ * steps are run once every frame loaded before them is received.
+ */
+static void spi_script_isr(spi_desc_t *pSpi){
+    size_t  depth = (pSpi->spiBufferMode == ENHANCED_BUFFER)?SPI_FIFO_DEPTH:1;
+    uint16_t    fill = (pSpi->spiDataFormat == BITS8)?0xFF:0xFFFF;
+    const spi_script_op_t   *pOp;
+    uint16_t    data;
+    spi_err_t   res;
+    
+    // Drain received frames
+    while (pSpi->asyncTxIdx && spi_rx_ready(pSpi)){
+        data = *(pSpi->pSPIBUF);
+        pSpi->asyncTxIdx--;
+        pOp = &pSpi->pScript[pSpi->scriptRxOp];
+        while (pSpi->scriptRxIdx >= spi_script_frames(pOp)){
+            pOp = &pSpi->pScript[++pSpi->scriptRxOp];
+            pSpi->scriptRxIdx = 0;
+        }
+        if (pOp->op == SPI_OP_RX_BUF){
+            if (pSpi->spiDataFormat == BITS8) ((uint8_t*)pOp->p)[pSpi->scriptRxIdx] = (uint8_t)data;
+            else ((uint16_t*)pOp->p)[pSpi->scriptRxIdx] = data;
+        }
+        pSpi->scriptRxIdx++;
+    }
+    
+    // Load the next frame(s), run the steps reached
+    for (;;){
+        pOp = &pSpi->pScript[pSpi->scriptTxOp];
+        if ((pOp->op >= SPI_OP_TX_LIT) && (pOp->op <= SPI_OP_DELAY)){
+            if (pSpi->scriptTxIdx >= spi_script_frames(pOp)){
+                pSpi->asyncLen += spi_script_frames(pOp);   // Frames of the script (stats / trace)
+                pSpi->scriptTxOp++;
+                pSpi->scriptTxIdx = 0;
+                continue;
+            }
+            if ((pSpi->asyncTxIdx >= depth) || (*(pSpi->pSPIxSTAT) & SPITBF_MASK)) return;
+            if (pOp->op == SPI_OP_TX_LIT) data = pOp->arg;
+            else if (pOp->op != SPI_OP_TX_BUF) data = fill;
+            else if (pSpi->spiDataFormat == BITS8) data = ((const uint8_t*)pOp->p)[pSpi->scriptTxIdx];
+            else data = ((const uint16_t*)pOp->p)[pSpi->scriptTxIdx];
+            *(pSpi->pSPIBUF) = data;
+            pSpi->scriptTxIdx++;
+            pSpi->asyncTxIdx++;
+            continue;
+        }
+        if (pSpi->asyncTxIdx) return;       // Frames in flight : wait
+        if (pOp->op == SPI_OP_END) break;
+        if (pOp->op == SPI_OP_CS_ASSERT) spi_cs_assert((const spi_cs_t*)pOp->p);
+        else if (pOp->op == SPI_OP_CS_RELEASE) spi_cs_release((const spi_cs_t*)pOp->p);
+        else if ((pOp->op == SPI_OP_CALLBACK) && (pSpi->pfScriptCallback != NULL)) pSpi->pfScriptCallback(pSpi, pOp->arg, pSpi->pCallbackCtx);
+        pSpi->scriptRxOp = ++pSpi->scriptTxOp;
+        pSpi->scriptRxIdx = 0;
+    }
+    
+    // Script completed
+    spiModules[pSpi->spiID].pfItDisable();
+    pSpiIsrDesc[pSpi->spiID] = NULL;
+    pSpi->pfIsrHandler = NULL;
+    res = spi_check(pSpi, SPI_OK);
+    SPI_STAT_ASYNC_END(pSpi, res);
+    SPI_TRACE_ASYNC_END(pSpi, res);
+    pSpi->asyncStatus = SPI_ASYNC_DONE;
+    if (pSpi->pfCallback != NULL) pSpi->pfCallback(pSpi, res, pSpi->pCallbackCtx);
+}
+//------------------------------------------------------------------------------
+#endif
+/**
+ * CRC of one more byte (CRC7 left aligned)
+ */
+static uint16_t spi_crc_byte(spiCrcType_t type, uint16_t crc, uint8_t data){
+    switch(type){
+        case SPI_CRC7:  return spiCrc7Table[(uint8_t)crc ^ data];
+        case SPI_CRC8:  return spiCrc8Table[(uint8_t)crc ^ data];
+        default:        return (crc << 8) ^ spiCrc16Table[(uint8_t)(crc >> 8) ^ data];
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * CRC engine (both buffer modes) : up to depth frames in flight, the CRC 
+ * updates being done while a frame is shifted.
+ */
+static spi_err_t   spi_crc_run(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len, spi_crc_t *pCrc){
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    size_t  depth = (pSpi->spiBufferMode == ENHANCED_BUFFER)?2:1;
+    size_t  txIdx = 0;
+    size_t  rxIdx = 0;
+    uint8_t data;
+    uint8_t last = 0;
+    
+    while (rxIdx < len){
+        // Load the next frame(s) : Tx CRC updated while they are shifted
+        while ((txIdx < len) && ((txIdx - rxIdx) < depth)){
+            data = (pTxData == NULL)?0xFF:pTxData[txIdx];
+            *pBuf = data;
+            if (pTxData != NULL) pCrc->txCrc = spi_crc_byte(pCrc->type, pCrc->txCrc, data);
+            txIdx++;
+        }
+        // Rx CRC of the previous frame, while the current one is shifted
+        if (rxIdx) pCrc->rxCrc = spi_crc_byte(pCrc->type, pCrc->rxCrc, last);
+        SPI_WAIT_RX(!spi_rx_ready(pSpi), pSpi->spinBudget);
+        last = (uint8_t)*pBuf;
+        if (pRxData != NULL) pRxData[rxIdx] = last;
+        rxIdx++;
+    }
+    if (rxIdx) pCrc->rxCrc = spi_crc_byte(pCrc->type, pCrc->rxCrc, last);
     return SPI_OK;
 }
 //------------------------------------------------------------------------------
+#if SPI_USE_DMA
+/**
+ * Programs and starts the Rx channel (SPIxBUF -> pRxData or sink) then the 
+ * Tx channel (pTxData or dummy -> SPIxBUF). The first Tx frame is forced by 
+ * software, the next ones are triggered by the SPI module.
+ */
+static void spi_dma_start(spi_desc_t *pSpi, const void *pTxData, void *pRxData, size_t len){
+    volatile spi_dma_ch_t *pTx = pSpi->pDmaTx;
+    volatile spi_dma_ch_t *pRx = pSpi->pDmaRx;
+    uint16_t    size = (pSpi->spiDataFormat == BITS8)?SIZE_BYTE_MASK:0;
+    
+    // Rx channel : SAMODE = unchanged, TRMODE = one-shot
+    pRx->DMACH = 0;
+    pRx->DMAINT &= ~DMAINT_FLAGS_MASK;
+    pRx->DMASRC = (uint16_t)pSpi->pSPIBUF;
+    pRx->DMADST = (pRxData == NULL)?(uint16_t)&spiDmaSink:(uint16_t)pRxData;
+    pRx->DMACNT = len;
+    pRx->DMACH = size | ((pRxData == NULL)?0:DAMODE_INC) | CHEN_MASK;
+    
+    // Tx channel : DAMODE = unchanged, TRMODE = one-shot
+    pTx->DMACH = 0;
+    pTx->DMAINT &= ~DMAINT_FLAGS_MASK;
+    pTx->DMASRC = (pTxData == NULL)?(uint16_t)&spiDmaDummy:(uint16_t)pTxData;
+    pTx->DMADST = (uint16_t)pSpi->pSPIBUF;
+    pTx->DMACNT = len;
+    pTx->DMACH = size | ((pTxData == NULL)?0:SAMODE_INC) | CHEN_MASK;
+    pTx->DMACH |= CHREQ_MASK;
+}
+//------------------------------------------------------------------------------
+static spi_err_t   spi_dma_transfer(spi_desc_t *pSpi, const void *pTxData, void *pRxData, size_t len){
+    volatile spi_dma_ch_t *pRx = pSpi->pDmaRx;
+    uint16_t    spin = pSpi->spinBudget;
+    uint16_t    count;
+    
+    spi_dma_start(pSpi, pTxData, pRxData, len);
+    count = pRx->DMACNT;
+    while (!(pRx->DMAINT & DONEIF_MASK)){
+        SPI_STAT_RX_SPIN();
+        if (pRx->DMACNT != count){         // Progress
+            count = pRx->DMACNT;
+            spin = pSpi->spinBudget;
+        }
+        else if (--spin == 0){
+            pSpi->pDmaTx->DMACH &= ~CHEN_MASK;
+            pRx->DMACH &= ~CHEN_MASK;
+            return SPI_TIMEOUT;
+        }
+    }
+    pRx->DMAINT &= ~DONEIF_MASK;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+#if SPI_USE_ASYNC
+/**
+ * DMA engine : run by the DMA Rx channel ISR
+ */
+static void spi_dma_isr(spi_desc_t *pSpi){
+    spi_err_t   res;
+    
+    pSpi->pDmaRx->DMAINT &= ~DONEIF_MASK;
+    pSpiIsrDesc[pSpi->spiID] = NULL;
+    pSpi->pfIsrHandler = NULL;
+    pSpi->asyncRxIdx = pSpi->asyncTxIdx = pSpi->asyncLen;
+    res = spi_check(pSpi, SPI_OK);
+    SPI_STAT_ASYNC_END(pSpi, res);
+    SPI_TRACE_ASYNC_END(pSpi, res);
+    pSpi->asyncStatus = SPI_ASYNC_DONE;
+    if (pSpi->pfCallback != NULL) pSpi->pfCallback(pSpi, res, pSpi->pCallbackCtx);
+}
+#endif
+#endif
+//------------------------------------------------------------------------------
+spi_err_t   spi_init(spi_id_t spi_id, spi_config_t* pSpiCFG, spi_desc_t *pSpi)
+{
+    if (pSpiCFG == NULL) return SPI_ERROR;
+    return spi_init_regs(spi_id, spi_config_con1(pSpiCFG), spi_config_con2(pSpiCFG), pSpi);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_init_regs(spi_id_t spi_id, uint16_t con1, uint16_t con2, spi_desc_t *pSpi)
+{
+    pSpi->spiID = spi_id;
+    pSpi->pfIsrHandler = NULL;
+    pSpi->asyncStatus = SPI_ASYNC_IDLE;
+    pSpi->spiTransferMode = SPI_XFER_CPU;
+    pSpi->spinBudget = SPI_SPIN_BUDGET;
+#if SPI_USE_STATS
+    pSpi->pfStatsTimer = NULL;
+    spi_stats_reset(&pSpi->stats);
+#endif
+#if SPI_USE_TRACE
+    pSpi->traceTag = 0;
+#endif
+#if SPI_USE_BUS
+    pSpi->pBusOwner = NULL;
+    pSpi->busPending = 0;
+#endif
+    if ((unsigned int)spi_id >= SPI_NB_MODULES) return SPI_UNKNOWN_MODULE;
+    pSpi->pSPIxSTAT = spiModules[spi_id].pSTAT;
+    pSpi->pSPIxCON1 = spiModules[spi_id].pCON1;
+    pSpi->pSPIxCON2 = spiModules[spi_id].pCON2;
+    pSpi->pSPIBUF = spiModules[spi_id].pBUF;
+    spiModules[spi_id].pfItClearFlag();
+    
+    spi_apply_regs(pSpi, con1, con2);
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_reconfigure(spi_desc_t *pSpi, uint16_t con1, uint16_t con2){
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) return SPI_BUSY;
+    if ((con1 != pSpi->con1) || (con2 != pSpi->con2)) spi_apply_regs(pSpi, con1, con2);
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+void    spi_set_spin_budget(spi_desc_t *pSpi, uint16_t budget){
+    pSpi->spinBudget = (budget < SPI_SPIN_BUDGET_MIN)?SPI_SPIN_BUDGET_MIN:budget;
+}
+//------------------------------------------------------------------------------
+void    spi_cs_assert(const spi_cs_t *pCs){
+    if (pCs == NULL) return;
+    if (pCs->pfSelect != NULL) pCs->pfSelect(1, pCs->pCtx);
+    else *(pCs->pLAT) &= ~(pCs->mask);
+}
+//------------------------------------------------------------------------------
+void    spi_cs_release(const spi_cs_t *pCs){
+    if (pCs == NULL) return;
+    if (pCs->pfSelect != NULL) pCs->pfSelect(0, pCs->pCtx);
+    else *(pCs->pLAT) |= pCs->mask;
+}
+//------------------------------------------------------------------------------
+#if SPI_USE_BUS
+spi_err_t   spi_bus_acquire(spi_desc_t *pSpi, const void *pUser, uint8_t prio, spi_grant_callback_t pfGrant, void *pCtx){
+    spi_err_t   res = SPI_OK;
+    
+    if ((pUser == NULL) || (prio >= SPI_BUS_NB_PRIO)) return SPI_ERROR;
+    __builtin_disi(0x3FFF);     // Test and set : a few instructions only
+    if (pSpi->pBusOwner == NULL) pSpi->pBusOwner = pUser;
+    else if ((pSpi->pBusOwner == pUser) || (pSpi->busPending & (1U << prio))) res = SPI_ERROR;
+    else{
+        res = SPI_BUSY;
+        if (pfGrant != NULL){
+            pSpi->pGrantUser[prio] = pUser;
+            pSpi->pfGrant[prio] = pfGrant;
+            pSpi->pGrantCtx[prio] = pCtx;
+            pSpi->busPending |= (1U << prio);
+        }
+    }
+    __builtin_disi(0x0000);
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_bus_release(spi_desc_t *pSpi, const void *pUser){
+    spi_grant_callback_t    pfGrant = NULL;
+    void        *pCtx = NULL;
+    uint8_t     prio = SPI_BUS_NB_PRIO;
+    
+    __builtin_disi(0x3FFF);     // Handoff : no other user may take the bus meanwhile
+    if ((pUser == NULL) || (pSpi->pBusOwner != pUser)){
+        __builtin_disi(0x0000);
+        return SPI_ERROR;
+    }
+    if (pSpi->busPending){
+        while (!(pSpi->busPending & (1U << --prio)));
+        pSpi->busPending &= ~(1U << prio);
+        pSpi->pBusOwner = pSpi->pGrantUser[prio];
+        pfGrant = pSpi->pfGrant[prio];
+        pCtx = pSpi->pGrantCtx[prio];
+    }
+    else pSpi->pBusOwner = NULL;
+    __builtin_disi(0x0000);
+    
+    if (pfGrant != NULL) pfGrant(pSpi, pCtx);
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_bus_cancel(spi_desc_t *pSpi, const void *pUser){
+    spi_err_t   res = SPI_OK;
+    uint8_t     prio;
+    
+    if (pUser == NULL) return SPI_OK;
+    __builtin_disi(0x3FFF);
+    for (prio = 0; prio < SPI_BUS_NB_PRIO; prio++){
+        if ((pSpi->busPending & (1U << prio)) && (pSpi->pGrantUser[prio] == pUser)) break;
+    }
+    if (prio < SPI_BUS_NB_PRIO) pSpi->busPending &= ~(1U << prio);
+    else if (pSpi->pBusOwner == pUser) res = SPI_BUSY;
+    __builtin_disi(0x0000);
+    return res;
+}
+//------------------------------------------------------------------------------
+const void  *spi_bus_owner(const spi_desc_t *pSpi){
+    return pSpi->pBusOwner;
+}
+//------------------------------------------------------------------------------
+#endif
+uint16_t    spi_config_con1(const spi_config_t *pSpiCFG){
+    // Slave Mode : SSEN set when the SSx pin is used
+    if (pSpiCFG->spiRole != SPI_MASTER) 
+        return SPI_CON1_SLAVE(pSpiCFG->spiClockPolarity, pSpiCFG->spiClockPhase, pSpiCFG->spiDataFormat, 
+                              pSpiCFG->spiRole == SPI_SLAVE_SS);
+    // SSEN : SSx pin is not used by module; pin is controlled by port function (0))
+    // MSTEN : Master Mode (1)
+    return SPI_CON1(pSpiCFG->spiClockPolarity, pSpiCFG->spiClockPhase, pSpiCFG->spiSamplePoint,
+                    pSpiCFG->spiDataFormat, pSpiCFG->spiPrimaryPrescaler, pSpiCFG->spiSecondaryPrescaler);
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_config_con2(const spi_config_t *pSpiCFG){
+    // SPIBEN : Enhanced Buffer mode (1) / Standard Buffer mode (0)
+    if (pSpiCFG->spiFrameMode == SPI_UNFRAMED) return SPI_CON2(pSpiCFG->spiBufferMode);
+    // FRMEN, SPIFSD, SPIFPOL : Framed mode
+    return SPI_CON2_FRAMED(pSpiCFG->spiBufferMode, pSpiCFG->spiFrameMode == SPI_FRAMED_SYNC_IN, pSpiCFG->spiFrameSyncPolarity);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_config_check(const spi_config_t *pSpiCFG){
+    if (pSpiCFG == NULL) return SPI_ERROR;
+    if (((unsigned int)pSpiCFG->spiClockPolarity > CLK_IDLE_IS_HIGH) || ((unsigned int)pSpiCFG->spiClockPhase > ACTIVE_TO_IDLE_CPHASE)
+        || ((unsigned int)pSpiCFG->spiDataFormat > BITS16) || ((unsigned int)pSpiCFG->spiBufferMode > ENHANCED_BUFFER)
+        || ((unsigned int)pSpiCFG->spiRole > SPI_SLAVE_SS) || ((unsigned int)pSpiCFG->spiFrameMode > SPI_FRAMED_SYNC_IN)) return SPI_ERROR;
+    if ((pSpiCFG->spiFrameMode != SPI_UNFRAMED) && ((unsigned int)pSpiCFG->spiFrameSyncPolarity > FSYNC_ACTIVE_HIGH)) return SPI_ERROR;
+    if (pSpiCFG->spiRole == SPI_MASTER){
+        if (((unsigned int)pSpiCFG->spiSamplePoint > END_SMP) || ((unsigned int)pSpiCFG->spiPrimaryPrescaler > PRI_PRE_1)
+            || ((unsigned int)pSpiCFG->spiSecondaryPrescaler > SEC_PRE_1)) return SPI_ERROR;
+        // 1:1 x 1:1 : not allowed (data sheet)
+        if ((pSpiCFG->spiPrimaryPrescaler == PRI_PRE_1) && (pSpiCFG->spiSecondaryPrescaler == SEC_PRE_1)) return SPI_ERROR;
+    }
+    // Slave without SSx : CKE must be cleared (data sheet)
+    else if ((pSpiCFG->spiRole == SPI_SLAVE) && (pSpiCFG->spiClockPhase == ACTIVE_TO_IDLE_CPHASE)) return SPI_ERROR;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_clock_solve(uint32_t fcy, uint32_t sckHz, spi_config_t *pSpiCFG, uint32_t *pActualHz){
+    uint8_t i;
+    uint16_t div;
+    
+    for (i = 0; i < (sizeof(spiDividers) / sizeof(spiDividers[0])); i++){
+        div = SPI_PRI_DIV(spiDividers[i].pri) * SPI_SEC_DIV(spiDividers[i].sec);
+        if (((fcy + div - 1) / div) <= sckHz){
+            pSpiCFG->spiPrimaryPrescaler = spiDividers[i].pri;
+            pSpiCFG->spiSecondaryPrescaler = spiDividers[i].sec;
+            if (pActualHz != NULL) *pActualHz = fcy / div;
+            return SPI_OK;
+        }
+    }
+    return SPI_ERROR;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_transfer_raw_byte(spi_desc_t *pSpi, uint8_t TxData, uint8_t *pRxData){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    spi_err_t   res;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_RAW_BYTE, &TxData, 1);
+    if (pSpi->spiDataFormat != BITS8) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+    if (pSpi->idleWait) res = spi_idle_run(pSpi, &TxData, pRxData, 1);
+    else if (pSpi->spiBufferMode == ENHANCED_BUFFER) res = spi_burst_bytes(pSpi, &TxData, pRxData, 1);
+    else{
+        res = spi_wait_tx(pStat, pSpi->spinBudget);     // Attente buffer Tx vide
+        if (res == SPI_OK){
+            if (pRxData == NULL) res = spi_loop_tx_bytes(pStat, pBuf, &TxData, 1, pSpi->spinBudget);
+            else res = spi_loop_txrx_bytes(pStat, pBuf, &TxData, pRxData, 1, pSpi->spinBudget);
+        }
+    }
+    SPI_RETURN(pSpi, spi_check(pSpi, res), 1, 0);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_transfer_raw_word(spi_desc_t *pSpi, uint16_t TxData, uint16_t *pRxData){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    spi_err_t   res;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_RAW_WORD, &TxData, 2);
+    if (pSpi->spiDataFormat != BITS16) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+    if (pSpi->idleWait) res = spi_idle_run(pSpi, &TxData, pRxData, 1);
+    else if (pSpi->spiBufferMode == ENHANCED_BUFFER) res = spi_burst_words(pSpi, &TxData, pRxData, 1);
+    else{
+        res = spi_wait_tx(pStat, pSpi->spinBudget);     // Attente buffer Tx vide
+        if (res == SPI_OK){
+            if (pRxData == NULL) res = spi_loop_tx_words(pStat, pBuf, &TxData, 1, pSpi->spinBudget);
+            else res = spi_loop_txrx_words(pStat, pBuf, &TxData, pRxData, 1, pSpi->spinBudget);
+        }
+    }
+    SPI_RETURN(pSpi, spi_check(pSpi, res), 0, 1);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_transfer_raw_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    uint16_t    budget = pSpi->spinBudget;
+    spi_err_t   res;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_RAW_BYTES, pTxData, len);
+    if (pSpi->spiDataFormat != BITS8) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+#if SPI_USE_DMA
+    if ((pSpi->spiTransferMode == SPI_XFER_DMA) && (len >= SPI_DMA_MIN_LEN)) SPI_RETURN(pSpi, spi_check(pSpi, spi_dma_transfer(pSpi, pTxData, pRxData, len)), len, 0);
+#endif
+    if (pSpi->idleWait) SPI_RETURN(pSpi, spi_check(pSpi, spi_idle_run(pSpi, pTxData, pRxData, len)), len, 0);
+    if (pSpi->spiBufferMode == ENHANCED_BUFFER) SPI_RETURN(pSpi, spi_check(pSpi, spi_burst_bytes(pSpi, pTxData, pRxData, len)), len, 0);
+    
+    res = spi_wait_tx(pStat, budget);   // Attente buffer Tx vide
+    if (res == SPI_OK){
+        if (pTxData == NULL){
+            if (pRxData == NULL) res = spi_loop_fill(pStat, pBuf, 0xFF, len, budget);
+            else res = spi_loop_rx_bytes(pStat, pBuf, pRxData, len, budget);
+        }
+        else{
+            if (pRxData == NULL) res = spi_loop_tx_bytes(pStat, pBuf, pTxData, len, budget);
+            else res = spi_loop_txrx_bytes(pStat, pBuf, pTxData, pRxData, len, budget);
+        }
+    }
+    SPI_RETURN(pSpi, spi_check(pSpi, res), len, 0);
+}
+//------------------------------------------------------------------------------
 spi_err_t   spi_transfer_raw_words(spi_desc_t *pSpi, const uint16_t *pTxData, uint16_t *pRxData, size_t len){
-    spi_err_t res;
-    size_t  i;
-    if (pSpi->spiDataFormat != BITS16) return SPI_BAD_DATA_FORMAT;
-    for (i=0;i<len;i++){
-        res = spi_transfer_raw_word(pSpi,(pTxData==NULL)?0xFF:pTxData[i],(pRxData==NULL)?NULL:&pRxData[i]);
-        if (res != SPI_OK) return res;
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    uint16_t    budget = pSpi->spinBudget;
+    spi_err_t   res;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_RAW_WORDS, pTxData, len << 1);
+    if (pSpi->spiDataFormat != BITS16) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+#if SPI_USE_DMA
+    if ((pSpi->spiTransferMode == SPI_XFER_DMA) && (len >= SPI_DMA_MIN_LEN)) SPI_RETURN(pSpi, spi_check(pSpi, spi_dma_transfer(pSpi, pTxData, pRxData, len)), 0, len);
+#endif
+    if (pSpi->idleWait) SPI_RETURN(pSpi, spi_check(pSpi, spi_idle_run(pSpi, pTxData, pRxData, len)), 0, len);
+    if (pSpi->spiBufferMode == ENHANCED_BUFFER) SPI_RETURN(pSpi, spi_check(pSpi, spi_burst_words(pSpi, pTxData, pRxData, len)), 0, len);
+    
+    res = spi_wait_tx(pStat, budget);   // Attente buffer Tx vide
+    if (res == SPI_OK){
+        if (pTxData == NULL){
+            if (pRxData == NULL) res = spi_loop_fill(pStat, pBuf, 0xFFFF, len, budget);
+            else res = spi_loop_rx_words(pStat, pBuf, pRxData, len, budget);
+        }
+        else{
+            if (pRxData == NULL) res = spi_loop_tx_words(pStat, pBuf, pTxData, len, budget);
+            else res = spi_loop_txrx_words(pStat, pBuf, pTxData, pRxData, len, budget);
+        }
+    }
+    SPI_RETURN(pSpi, spi_check(pSpi, res), 0, len);
+}
+//------------------------------------------------------------------------------
+/**
+ * Segments engine : runs pSeg[first..last[ (same width, zero length segments 
+ * allowed). The Tx cursor and the Rx cursor walk the segments independently, 
+ * no more than depth frames being in flight.
+ */
+static spi_err_t   spi_segments_run(spi_desc_t *pSpi, const spi_segment_t *pSeg, size_t first, size_t last){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    size_t  depth = (pSpi->spiBufferMode == ENHANCED_BUFFER)?SPI_FIFO_DEPTH:1;
+    uint8_t bits16 = (pSpi->spiDataFormat == BITS16);
+    size_t  txSeg = first, txIdx = 0;
+    size_t  rxSeg = first, rxIdx = 0;
+    size_t  inFlight = 0;
+    uint16_t    data;
+    uint16_t    spin = pSpi->spinBudget;
+    
+    while ((txSeg < last) && (pSeg[txSeg].len == 0)) txSeg++;
+    rxSeg = txSeg;
+    
+    while (rxSeg < last){
+        SPI_STAT_RX_SPIN();
+        if (--spin == 0) return SPI_TIMEOUT;
+        // Tx side
+        while ((txSeg < last) && (inFlight < depth) && !(*pStat & SPITBF_MASK)){
+            if (pSeg[txSeg].pTx == NULL) data = pSeg[txSeg].fill;
+            else if (bits16) data = ((const uint16_t*)pSeg[txSeg].pTx)[txIdx];
+            else data = ((const uint8_t*)pSeg[txSeg].pTx)[txIdx];
+            *pBuf = data;
+            inFlight++;
+            if (++txIdx >= pSeg[txSeg].len){
+                txIdx = 0;
+                do txSeg++; while ((txSeg < last) && (pSeg[txSeg].len == 0));
+            }
+        }
+        // Rx side
+        while (inFlight && spi_rx_ready(pSpi)){
+            data = *pBuf;
+            inFlight--;
+            spin = pSpi->spinBudget;
+            if (pSeg[rxSeg].pRx != NULL){
+                if (bits16) ((uint16_t*)pSeg[rxSeg].pRx)[rxIdx] = data;
+                else ((uint8_t*)pSeg[rxSeg].pRx)[rxIdx] = (uint8_t)data;
+            }
+            if (++rxIdx >= pSeg[rxSeg].len){
+                rxIdx = 0;
+                do rxSeg++; while ((rxSeg < last) && (pSeg[rxSeg].len == 0));
+            }
+        }
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+/**
+ * Packed engine : len / 2 frames of 16 bits, bytes joined / split MSB first
+ * (module in MODE16)
+ */
+static spi_err_t   spi_packed_run(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t nbFrames){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    size_t  depth = (pSpi->spiBufferMode == ENHANCED_BUFFER)?SPI_FIFO_DEPTH:1;
+    size_t  txIdx = 0;
+    size_t  rxIdx = 0;
+    uint16_t    data;
+    uint16_t    spin = pSpi->spinBudget;
+    
+    while (rxIdx < nbFrames){
+        SPI_STAT_RX_SPIN();
+        if (--spin == 0) return SPI_TIMEOUT;
+        // Tx side
+        while ((txIdx < nbFrames) && ((txIdx - rxIdx) < depth) && !(*pStat & SPITBF_MASK)){
+            if (pTxData == NULL) *pBuf = 0xFFFF;
+            else{
+                *pBuf = ((uint16_t)pTxData[0] << 8) | pTxData[1];
+                pTxData += 2;
+            }
+            txIdx++;
+        }
+        // Rx side
+        while ((rxIdx < txIdx) && spi_rx_ready(pSpi)){
+            data = *pBuf;
+            if (pRxData != NULL){
+                pRxData[0] = (uint8_t)(data >> 8);
+                pRxData[1] = (uint8_t)data;
+                pRxData += 2;
+            }
+            rxIdx++;
+            spin = pSpi->spinBudget;
+        }
     }
     return SPI_OK;
 }
 //------------------------------------------------------------------------------
+spi_err_t   spi_transfer_packed_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len){
+    size_t  nbFrames = len >> 1;
+    spi_segment_t   tail;
+    spi_err_t   res = SPI_OK;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_PACKED_BYTES, pTxData, len);
+    
+    if (pSpi->spiDataFormat != BITS8) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+#if SPI_USE_DMA
+    if ((pSpi->spiTransferMode == SPI_XFER_DMA) && (len >= SPI_DMA_MIN_LEN)) SPI_RETURN(pSpi, spi_check(pSpi, spi_dma_transfer(pSpi, pTxData, pRxData, len)), len, 0);
+#endif
+    if (len < SPI_PACKED_MIN_LEN) nbFrames = 0;     // Short transfer : 8 bits frames only
+    
+    if (nbFrames){
+        spi_set_mode16(pSpi, MODE16_MASK);
+        res = spi_check(pSpi, spi_packed_run(pSpi, pTxData, pRxData, nbFrames));
+        spi_set_mode16(pSpi, 0);
+    }
+    
+    // Bytes left (odd tail or short transfer), 8 bits frames
+    if ((len > (nbFrames << 1)) && (res == SPI_OK)){
+        tail.pTx = (pTxData == NULL)?NULL:&pTxData[nbFrames << 1];
+        tail.pRx = (pRxData == NULL)?NULL:&pRxData[nbFrames << 1];
+        tail.len = len - (nbFrames << 1);
+        tail.fill = 0xFF;
+        tail.width = 0;
+        res = spi_check(pSpi, spi_segments_run(pSpi, &tail, 0, 1));
+    }
+    SPI_RETURN(pSpi, res, len, 0);
+}
+//------------------------------------------------------------------------------
 spi_err_t   spi_transfer_byte_reg(spi_desc_t *pSpi, uint8_t reg, uint8_t dataOut, uint8_t *pdataIn){
     spi_err_t res;
     if (pSpi->spiDataFormat != BITS8) return SPI_BAD_DATA_FORMAT;
@@ -206,35 +1380,550 @@ spi_err_t   spi_transfer_word_reg(spi_desc_t *pSpi, uint16_t reg, uint16_t dataO
 //------------------------------------------------------------------------------
 spi_err_t   spi_transfer_byte_regs(spi_desc_t *pSpi, uint8_t reg, const uint8_t *out, uint8_t *in, size_t len){
     spi_err_t res;
-    size_t i = 0;
     if (pSpi->spiDataFormat != BITS8) return SPI_BAD_DATA_FORMAT;
     
     res = spi_transfer_raw_byte(pSpi, reg, NULL);
     if (res != SPI_OK) return res;
     
-    for (i=0; i < len; i++){
-        res = spi_transfer_raw_byte(pSpi,(out==NULL)?0xFF:out[i],(in==NULL)?NULL:&in[i]);
-        if (res != SPI_OK) return res;
-    }
-    return SPI_OK;
+    return spi_transfer_raw_bytes(pSpi, out, in, len);
 }
 //------------------------------------------------------------------------------
 spi_err_t   spi_transfer_word_regs(spi_desc_t *pSpi, uint16_t reg, const uint16_t *out, uint16_t *in, size_t len){
     spi_err_t res;
-    size_t i = 0;
     if (pSpi->spiDataFormat != BITS16) return SPI_BAD_DATA_FORMAT;
     
     res = spi_transfer_raw_word(pSpi, reg, NULL);
     if (res != SPI_OK) return res;
     
-    for (i=0; i < len; i++){
-        res = spi_transfer_raw_word(pSpi,(out==NULL)?0xFF:out[i],(in==NULL)?NULL:&in[i]);
-        if (res != SPI_OK) return res;
+    return spi_transfer_raw_words(pSpi, out, in, len);
+}
+//------------------------------------------------------------------------------
+/**
+ * Register batch engine : up to depth frames of a job in flight, the data 
+ * bytes stored with the stride. The next job is started (CS, address byte) 
+ * right after the last frame of the previous one is received.
+ */
+static spi_err_t   spi_reg_batch_run(spi_desc_t *pSpi, const spi_reg_job_t *pJob, size_t nbJobs, uint8_t *pRx, size_t stride){
+    volatile uint16_t *pStat = pSpi->pSPIxSTAT;
+    volatile uint16_t *pBuf = pSpi->pSPIBUF;
+    size_t  depth = (pSpi->spiBufferMode == ENHANCED_BUFFER)?SPI_FIFO_DEPTH:1;
+    size_t  frames, txIdx, rxIdx;
+    uint8_t *pDst;
+    uint16_t    data;
+    uint16_t    spin;
+    
+    for (; nbJobs; nbJobs--, pJob++, pRx++){
+        frames = (size_t)pJob->len + 1;
+        txIdx = 0;
+        rxIdx = 0;
+        pDst = pRx;
+        spin = pSpi->spinBudget;
+        spi_cs_assert(pJob->pCs);
+        while (rxIdx < frames){
+            SPI_STAT_RX_SPIN();
+            if (--spin == 0){
+                spi_cs_release(pJob->pCs);
+                return SPI_TIMEOUT;
+            }
+            while ((txIdx < frames) && ((txIdx - rxIdx) < depth) && !(*pStat & SPITBF_MASK)){
+                *pBuf = (txIdx == 0)?pJob->reg:0xFF;
+                txIdx++;
+            }
+            while ((rxIdx < txIdx) && spi_rx_ready(pSpi)){
+                data = *pBuf;
+                if (rxIdx++){       // Byte 0 : received during the address byte
+                    *pDst = (uint8_t)data;
+                    pDst += stride;
+                }
+                spin = pSpi->spinBudget;
+            }
+        }
+        spi_cs_release(pJob->pCs);
     }
     return SPI_OK;
 }
 //------------------------------------------------------------------------------
-
+spi_err_t   spi_transfer_reg_batch(spi_desc_t *pSpi, const spi_reg_job_t *pJobs, size_t nbJobs, uint8_t *pRx, size_t stride){
+    size_t  nbBytes = nbJobs;
+    size_t  job;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_REG_BATCH, (nbJobs == 0)?NULL:&pJobs[0].reg, (nbJobs == 0)?0:1);
+    
+    if (pSpi->spiDataFormat != BITS8) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+    for (job = 0; job < nbJobs; job++) nbBytes += pJobs[job].len;
+    SPI_RETURN(pSpi, spi_check(pSpi, spi_reg_batch_run(pSpi, pJobs, nbJobs, pRx, stride)), nbBytes, 0);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_transfer_segments(spi_desc_t *pSpi, const spi_segment_t *pSeg, size_t nbSeg){
+    uint16_t    con1 = pSpi->con1;
+    uint16_t    mode16;
+    size_t  first, last;
+    size_t  nbBytes = 0, nbWords = 0;
+    spi_err_t   res = SPI_OK;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_SEGMENTS, (nbSeg == 0)?NULL:pSeg[0].pTx, (nbSeg == 0)?0:pSeg[0].len);
+    
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+    for (first = 0; first < nbSeg; first++){
+        if ((pSeg[first].width != 0) && (pSeg[first].width != 8) && (pSeg[first].width != 16)) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+        if (SPI_SEG_MODE16(&pSeg[first], con1)) nbWords += pSeg[first].len;
+        else nbBytes += pSeg[first].len;
+    }
+    
+    // Runs of consecutive segments sharing the same MODE16 value (empty segments never switch it)
+    first = 0;
+    while ((first < nbSeg) && (res == SPI_OK)){
+        if (pSeg[first].len == 0){
+            first++;
+            continue;
+        }
+        mode16 = SPI_SEG_MODE16(&pSeg[first], con1);
+        last = first + 1;
+        while ((last < nbSeg) && ((pSeg[last].len == 0) || (SPI_SEG_MODE16(&pSeg[last], con1) == mode16))) last++;
+        
+        spi_set_mode16(pSpi, mode16);
+        res = spi_check(pSpi, spi_segments_run(pSpi, pSeg, first, last));
+        first = last;
+    }
+    
+    spi_set_mode16(pSpi, con1 & MODE16_MASK);
+    SPI_RETURN(pSpi, res, nbBytes, nbWords);
+}
+//------------------------------------------------------------------------------
+void    spi_crc_init(spi_crc_t *pCrc, spiCrcType_t type, uint16_t seed){
+    pCrc->type = type;
+    pCrc->txCrc = seed;
+    pCrc->rxCrc = seed;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_crc_compute(spiCrcType_t type, uint16_t crc, const uint8_t *pData, size_t len){
+    while (len--) crc = spi_crc_byte(type, crc, *pData++);
+    return crc;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_transfer_crc_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len, spi_crc_t *pCrc, uint8_t options){
+    spi_crc_t   trailerCrc;
+    uint8_t     trailerTx[2];
+    uint8_t     trailerRx[2];
+    size_t      trailerLen = 0;
+    uint16_t    received;
+    spi_err_t   res;
+    SPI_STAT_BEGIN(pSpi);
+    SPI_TRACE_BEGIN(SPI_TRACE_CRC_BYTES, pTxData, len);
+    if (pSpi->spiDataFormat != BITS8) SPI_RETURN(pSpi, SPI_BAD_DATA_FORMAT, 0, 0);
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) SPI_RETURN(pSpi, SPI_BUSY, 0, 0);
+    
+    res = spi_wait_tx(pSpi->pSPIxSTAT, pSpi->spinBudget);
+    if (res == SPI_OK) res = spi_crc_run(pSpi, pTxData, pRxData, len, pCrc);
+    
+    // CRC frames
+    if ((res == SPI_OK) && (options & (SPI_CRC_SEND | SPI_CRC_CHECK))){
+        trailerLen = (pCrc->type == SPI_CRC16)?2:1;
+        if (pCrc->type == SPI_CRC16){
+            trailerTx[0] = (uint8_t)(pCrc->txCrc >> 8);
+            trailerTx[1] = (uint8_t)pCrc->txCrc;
+        }
+        else trailerTx[0] = (uint8_t)pCrc->txCrc | ((pCrc->type == SPI_CRC7)?0x01:0x00);
+        trailerCrc = *pCrc;
+        res = spi_crc_run(pSpi, (options & SPI_CRC_SEND)?trailerTx:NULL, trailerRx, trailerLen, &trailerCrc);
+        if ((res == SPI_OK) && (options & SPI_CRC_CHECK)){
+            if (pCrc->type == SPI_CRC16) received = ((uint16_t)trailerRx[0] << 8) | trailerRx[1];
+            else if (pCrc->type == SPI_CRC7) received = trailerRx[0] & 0xFE;
+            else received = trailerRx[0];
+            if (received != pCrc->rxCrc) res = SPI_CRC_ERROR;
+        }
+    }
+    SPI_RETURN(pSpi, spi_check(pSpi, res), len + trailerLen, 0);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_set_transfer_mode(spi_desc_t *pSpi, spiTransferMode_t mode){
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) return SPI_BUSY;
+    if ((mode == SPI_XFER_CPU) || (mode == SPI_XFER_IDLE)){
+        pSpi->spiTransferMode = mode;
+        spi_idle_cutover(pSpi);
+        return SPI_OK;
+    }
+#if SPI_USE_DMA
+    pSpi->pDmaTx = spiModules[pSpi->spiID].pDmaTx;
+    pSpi->pDmaRx = spiModules[pSpi->spiID].pDmaRx;
+    pSpi->pDmaTx->DMAINT = (spiModules[pSpi->spiID].dmaTxTrig << CHSEL_POS);
+    pSpi->pDmaRx->DMAINT = (spiModules[pSpi->spiID].dmaRxTrig << CHSEL_POS);
+    // DMA controller : enabled once for all the channels
+    if (!(DMACON & DMAEN_MASK)){
+        DMAL = SPI_DMA_RAM_LOW;
+        DMAH = SPI_DMA_RAM_HIGH;
+        DMACON = DMAEN_MASK;
+    }
+    pSpi->spiTransferMode = SPI_XFER_DMA;
+    spi_idle_cutover(pSpi);
+    return SPI_OK;
+#else
+    return SPI_ERROR;
+#endif
+}
+//------------------------------------------------------------------------------
+#if SPI_USE_ASYNC
+spi_err_t   spi_transfer_async(spi_desc_t *pSpi, const void *pTxData, void *pRxData, size_t len, spi_callback_t pfCallback, void *pCtx){
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY){
+        SPI_STAT_ERROR(pSpi);
+        return SPI_BUSY;
+    }
+    
+    pSpi->pAsyncTx = pTxData;
+    pSpi->pAsyncRx = pRxData;
+    pSpi->asyncLen = len;
+    pSpi->asyncTxIdx = 0;
+    pSpi->asyncRxIdx = 0;
+    pSpi->pfCallback = pfCallback;
+    pSpi->pCallbackCtx = pCtx;
+    
+    if (len == 0){
+        pSpi->asyncStatus = SPI_ASYNC_DONE;
+        if (pfCallback != NULL) pfCallback(pSpi, SPI_OK, pCtx);
+        return SPI_OK;
+    }
+    
+    pSpi->asyncStatus = SPI_ASYNC_BUSY;
+    pSpiIsrDesc[pSpi->spiID] = pSpi;
+    SPI_STAT_ASYNC_START(pSpi);
+    SPI_TRACE_ASYNC_START(pSpi, SPI_TRACE_ASYNC);
+#if SPI_USE_DMA
+    if ((pSpi->spiTransferMode == SPI_XFER_DMA) && (len >= SPI_DMA_MIN_LEN)){
+        pSpi->pfIsrHandler = spi_dma_isr;
+        spiModules[pSpi->spiID].pfDmaItEnable();
+        spi_dma_start(pSpi, pTxData, pRxData, len);
+        return SPI_OK;
+    }
+#endif
+    pSpi->pfIsrHandler = spi_async_isr;
+    
+    // Load the first frame(s) then let the ISR carry on
+    spiModules[pSpi->spiID].pfItClearFlag();
+    spi_async_fill(pSpi);
+    spiModules[pSpi->spiID].pfItEnable();
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_async_status_t  spi_async_status(spi_desc_t *pSpi){
+    return pSpi->asyncStatus;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_async_cancel(spi_desc_t *pSpi){
+    spi_err_t   res = SPI_OK;
+    uint16_t    spin;
+    
+    spiModules[pSpi->spiID].pfItDisable();
+#if SPI_USE_DMA
+    if (pSpi->pfIsrHandler == spi_dma_isr){
+        spiModules[pSpi->spiID].pfDmaItDisable();
+        if (pSpi->asyncStatus != SPI_ASYNC_BUSY) return SPI_OK;     // Already completed
+        // Stop feeding SPIxBUF, then let the Rx channel catch up with the frames in flight
+        pSpi->pDmaTx->DMACH &= ~CHEN_MASK;
+        spin = pSpi->spinBudget;
+        while ((pSpi->pDmaRx->DMACNT != pSpi->pDmaTx->DMACNT) && --spin);
+        if (spin == 0) res = SPI_TIMEOUT;
+        pSpi->pDmaRx->DMACH &= ~CHEN_MASK;
+        pSpi->pDmaRx->DMAINT &= ~DMAINT_FLAGS_MASK;
+        pSpi->asyncRxIdx = pSpi->asyncTxIdx;
+    }
+#endif
+    if (pSpi->asyncStatus != SPI_ASYNC_BUSY) return SPI_OK;     // Already completed
+    
+    // Flush the frames already loaded
+    while ((pSpi->asyncRxIdx < pSpi->asyncTxIdx) && (res == SPI_OK)){
+        spin = pSpi->spinBudget;
+        while (!spi_rx_ready(pSpi) && --spin);
+        if (spin == 0) res = SPI_TIMEOUT;
+        else{
+            (void)*(pSpi->pSPIBUF);
+            pSpi->asyncRxIdx++;
+        }
+    }
+    (void)spi_check(pSpi, res);     // Module reset after a timeout or an overrun
+    spiModules[pSpi->spiID].pfItClearFlag();
+    pSpiIsrDesc[pSpi->spiID] = NULL;
+    pSpi->pfIsrHandler = NULL;
+    pSpi->asyncStatus = SPI_ASYNC_CANCELLED;
+    return res;
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_STREAM
+spi_err_t   spi_stream_start(spi_desc_t *pSpi, void *pBuffers, uint8_t nbSlots, size_t slotLen, uint16_t command, 
+                             const spi_cs_t *pCs, spi_stream_callback_t pfCallback, void *pCtx){
+    uint8_t i;
+    
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) return SPI_BUSY;
+    if ((nbSlots < 2) || (nbSlots > SPI_STREAM_MAX_SLOTS) || (slotLen == 0) || (pfCallback == NULL)) return SPI_ERROR;
+    
+    pSpi->pAsyncTx = NULL;
+    pSpi->pAsyncRx = pBuffers;
+    pSpi->asyncLen = slotLen;
+    pSpi->asyncTxIdx = 0;
+    pSpi->asyncRxIdx = 0;
+    pSpi->pfCallback = NULL;
+    pSpi->pCallbackCtx = pCtx;
+    pSpi->pfStreamCallback = pfCallback;
+    pSpi->pStreamCs = pCs;
+    pSpi->streamCmd = command;
+    pSpi->streamIdx = 0;
+    pSpi->streamNbSlots = nbSlots;
+    pSpi->streamSlot = 0;
+    pSpi->streamDrop = 0;
+    pSpi->streamOverflows = 0;
+    for (i = 0; i < nbSlots; i++) pSpi->streamHeld[i] = 0;
+    
+    pSpi->asyncStatus = SPI_ASYNC_BUSY;
+    pSpiIsrDesc[pSpi->spiID] = pSpi;
+    pSpi->pfIsrHandler = spi_stream_isr;
+    
+    // Load the first frame(s) then let the ISR carry on
+    spiModules[pSpi->spiID].pfItClearFlag();
+    spi_stream_isr(pSpi);
+    spiModules[pSpi->spiID].pfItEnable();
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_stream_release(spi_desc_t *pSpi, void *pBuffer){
+    size_t  offset;
+    size_t  size = (pSpi->spiDataFormat == BITS8)?1:2;
+    
+    if ((uint8_t*)pBuffer < (uint8_t*)pSpi->pAsyncRx) return SPI_ERROR;
+    offset = (size_t)((uint8_t*)pBuffer - (uint8_t*)pSpi->pAsyncRx) / size;
+    if ((offset % pSpi->asyncLen) || ((offset / pSpi->asyncLen) >= pSpi->streamNbSlots)) return SPI_ERROR;
+    pSpi->streamHeld[offset / pSpi->asyncLen] = 0;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_stream_stop(spi_desc_t *pSpi){
+    spi_err_t   res;
+    
+    res = spi_async_cancel(pSpi);
+    if (pSpi->pStreamCs != NULL) spi_cs_release(pSpi->pStreamCs);
+    return res;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_stream_overflows(spi_desc_t *pSpi){
+    return pSpi->streamOverflows;
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_SLAVE
+spi_err_t   spi_ring_init(spi_ring_t *pRing, void *pBuf, uint16_t size, spiDataFormat_t format){
+    if ((size < 2) || (size > 0x8000) || (size & (size - 1))) return SPI_ERROR;
+    pRing->pBuf = pBuf;
+    pRing->mask = size - 1;
+    pRing->format = format;
+    pRing->head = 0;
+    pRing->tail = 0;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_ring_count(const spi_ring_t *pRing){
+    return (uint16_t)(pRing->head - pRing->tail);
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_ring_write(spi_ring_t *pRing, const void *pData, uint16_t len){
+    uint16_t    i;
+    
+    for (i = 0; i < len; i++){
+        if (pRing->format == BITS8){
+            if (!spi_ring_put(pRing, ((const uint8_t*)pData)[i])) break;
+        }
+        else if (!spi_ring_put(pRing, ((const uint16_t*)pData)[i])) break;
+    }
+    return i;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_ring_read(spi_ring_t *pRing, void *pData, uint16_t len){
+    uint16_t    i;
+    uint16_t    data;
+    
+    for (i = 0; i < len; i++){
+        if (!spi_ring_get(pRing, &data)) break;
+        if (pRing->format == BITS8) ((uint8_t*)pData)[i] = (uint8_t)data;
+        else ((uint16_t*)pData)[i] = data;
+    }
+    return i;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_slave_start(spi_desc_t *pSpi, spi_ring_t *pRxRing, spi_ring_t *pTxRing, uint16_t fill){
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY) return SPI_BUSY;
+    if (pSpi->con1 & MSTEN_MASK) return SPI_ERROR;
+    if ((pRxRing != NULL) && (pRxRing->format != pSpi->spiDataFormat)) return SPI_BAD_DATA_FORMAT;
+    if ((pTxRing != NULL) && (pTxRing->format != pSpi->spiDataFormat)) return SPI_BAD_DATA_FORMAT;
+    
+    pSpi->pSlaveRx = pRxRing;
+    pSpi->pSlaveTx = pTxRing;
+    pSpi->slaveFill = fill;
+    pSpi->slaveUnderruns = 0;
+    pSpi->slaveOverruns = 0;
+    
+    // Module reset (FIFOs flushed), then the first frame(s) are loaded
+    spi_apply_regs(pSpi, pSpi->con1, pSpi->con2);
+    spi_slave_fill(pSpi, 0);
+    
+    pSpi->asyncStatus = SPI_ASYNC_BUSY;
+    pSpiIsrDesc[pSpi->spiID] = pSpi;
+    pSpi->pfIsrHandler = spi_slave_isr;
+    spiModules[pSpi->spiID].pfItClearFlag();
+    spiModules[pSpi->spiID].pfItEnable();
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_slave_stop(spi_desc_t *pSpi){
+    if (pSpi->pfIsrHandler != spi_slave_isr) return SPI_OK;     // Not running
+    spiModules[pSpi->spiID].pfItDisable();
+    
+    // Module reset : the frames loaded in advance are discarded
+    spi_apply_regs(pSpi, pSpi->con1, pSpi->con2);
+    spiModules[pSpi->spiID].pfItClearFlag();
+    pSpiIsrDesc[pSpi->spiID] = NULL;
+    pSpi->pfIsrHandler = NULL;
+    pSpi->asyncStatus = SPI_ASYNC_CANCELLED;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_slave_underruns(spi_desc_t *pSpi){
+    return pSpi->slaveUnderruns;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_slave_overruns(spi_desc_t *pSpi){
+    return pSpi->slaveOverruns;
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_SCRIPT
+spi_err_t   spi_script_start(spi_desc_t *pSpi, const spi_script_op_t *pScript, spi_script_callback_t pfScriptCallback,
+                             spi_callback_t pfCallback, void *pCtx){
+    if (pSpi->asyncStatus == SPI_ASYNC_BUSY){
+        SPI_STAT_ERROR(pSpi);
+        return SPI_BUSY;
+    }
+    
+    pSpi->pScript = pScript;
+    pSpi->pfScriptCallback = pfScriptCallback;
+    pSpi->scriptTxOp = 0;
+    pSpi->scriptTxIdx = 0;
+    pSpi->scriptRxOp = 0;
+    pSpi->scriptRxIdx = 0;
+    pSpi->pAsyncTx = NULL;
+    pSpi->asyncLen = 0;
+    pSpi->asyncTxIdx = 0;
+    pSpi->asyncRxIdx = 0;
+    pSpi->pfCallback = pfCallback;
+    pSpi->pCallbackCtx = pCtx;
+    
+    pSpi->asyncStatus = SPI_ASYNC_BUSY;
+    pSpiIsrDesc[pSpi->spiID] = pSpi;
+    pSpi->pfIsrHandler = spi_script_isr;
+    SPI_STAT_ASYNC_START(pSpi);
+    SPI_TRACE_ASYNC_START(pSpi, SPI_TRACE_SCRIPT);
+    
+    // Run the first step(s) then let the ISR carry on
+    spiModules[pSpi->spiID].pfItClearFlag();
+    spi_script_isr(pSpi);
+    if (pSpi->pfIsrHandler == spi_script_isr) spiModules[pSpi->spiID].pfItEnable();
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_STATS
+void    spi_stats_set_timer(spi_desc_t *pSpi, spi_timer_t pfTimer){
+    pSpi->pfStatsTimer = pfTimer;
+}
+//------------------------------------------------------------------------------
+void    spi_stats_snapshot(spi_desc_t *pSpi, spi_stats_t *pStats, uint8_t reset){
+    __builtin_disi(0x3FFF);     // No ISR update while copying
+    *pStats = pSpi->stats;
+    if (reset) spi_stats_reset(&pSpi->stats);
+    __builtin_disi(0x0000);
+    
+    if (pStats->nbTransactions == 0) pStats->durMin = 0;
+    pStats->durAvg = (pStats->nbTransactions == 0)?0:(pStats->durSum / pStats->nbTransactions);
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_TRACE
+void    spi_trace_set_timer(spi_timer_t pfTimer){
+    pfSpiTraceTimer = pfTimer;
+}
+//------------------------------------------------------------------------------
+void    spi_trace_enable(uint8_t on){
+    spiTraceOn = on;
+}
+//------------------------------------------------------------------------------
+void    spi_trace_tag(spi_desc_t *pSpi, uint8_t tag){
+    pSpi->traceTag = tag;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_trace_drain(spi_trace_rec_t *pRecs, uint16_t maxRecs){
+    uint16_t    nb = 0;
+    
+    // Records between tail and head are not rewritten until the tail moves
+    // (tail only written here, with a single 16 bits increment)
+    while ((nb < maxRecs) && (spiTraceTail != spiTraceHead)){
+        pRecs[nb++] = spiTrace[spiTraceTail & (SPI_TRACE_DEPTH - 1)];
+        spiTraceTail++;
+    }
+    return nb;
+}
+//------------------------------------------------------------------------------
+uint16_t    spi_trace_lost(void){
+    uint16_t    lost;
+    
+    __builtin_disi(0x3FFF);
+    lost = spiTraceLost;
+    spiTraceLost = 0;
+    __builtin_disi(0x0000);
+    return lost;
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_ISR
+void SPI_ISR _SPI1Interrupt(void){
+    _SPI1IF = 0;
+    if (pSpiIsrDesc[_SPI1] != NULL) pSpiIsrDesc[_SPI1]->pfIsrHandler(pSpiIsrDesc[_SPI1]);
+    else _SPI1IE = 0;
+}
+//------------------------------------------------------------------------------
+void SPI_ISR _SPI2Interrupt(void){
+    _SPI2IF = 0;
+    if (pSpiIsrDesc[_SPI2] != NULL) pSpiIsrDesc[_SPI2]->pfIsrHandler(pSpiIsrDesc[_SPI2]);
+    else _SPI2IE = 0;
+}
+//------------------------------------------------------------------------------
+#ifdef _SPI3IF
+void SPI_ISR _SPI3Interrupt(void){
+    _SPI3IF = 0;
+    if (pSpiIsrDesc[_SPI3] != NULL) pSpiIsrDesc[_SPI3]->pfIsrHandler(pSpiIsrDesc[_SPI3]);
+    else _SPI3IE = 0;
+}
+//------------------------------------------------------------------------------
+#endif
+#if SPI_USE_DMA
+void SPI_ISR SPI_DMA_ISR(SPI1_DMA_RX_CH)(void){
+    SPI_DMA_IF(SPI1_DMA_RX_CH) = 0;
+    SPI_DMA_IE(SPI1_DMA_RX_CH) = 0;
+    if (pSpiIsrDesc[_SPI1] != NULL) pSpiIsrDesc[_SPI1]->pfIsrHandler(pSpiIsrDesc[_SPI1]);
+}
+//------------------------------------------------------------------------------
+void SPI_ISR SPI_DMA_ISR(SPI2_DMA_RX_CH)(void){
+    SPI_DMA_IF(SPI2_DMA_RX_CH) = 0;
+    SPI_DMA_IE(SPI2_DMA_RX_CH) = 0;
+    if (pSpiIsrDesc[_SPI2] != NULL) pSpiIsrDesc[_SPI2]->pfIsrHandler(pSpiIsrDesc[_SPI2]);
+}
+#ifdef _SPI3IF
+//------------------------------------------------------------------------------
+void SPI_ISR SPI_DMA_ISR(SPI3_DMA_RX_CH)(void){
+    SPI_DMA_IF(SPI3_DMA_RX_CH) = 0;
+    SPI_DMA_IE(SPI3_DMA_RX_CH) = 0;
+    if (pSpiIsrDesc[_SPI3] != NULL) pSpiIsrDesc[_SPI3]->pfIsrHandler(pSpiIsrDesc[_SPI3]);
+}
+#endif
+#endif
+#endif
 //------------------------------------------------------------------------------
 
 
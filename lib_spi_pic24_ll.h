@@ -12,9 +12,128 @@
 #include <xc.h>
 #include <stddef.h>     // for size_t
 
+//-----------------------------------------------------------------------------
+// Library configuration (may be overridden from the project settings)
+#ifndef SPI_USE_ISR
+#define SPI_USE_ISR         1   /**< 1 : the library implements the SPIx ISRs (asynchronous transfers) */
+#endif
+#ifndef SPI_USE_ASYNC
+#define SPI_USE_ASYNC       1   /**< 1 : interrupt driven transfers (see spi_transfer_async) */
+#endif
+#ifndef SPI_USE_STREAM
+#define SPI_USE_STREAM      0   /**< 1 : streaming into a ring of buffers (see spi_stream_start, needs SPI_USE_ASYNC) */
+#endif
+#ifndef SPI_USE_SLAVE
+#define SPI_USE_SLAVE       0   /**< 1 : slave engine and frame rings (see spi_slave_start) */
+#endif
+#ifndef SPI_USE_SCRIPT
+#define SPI_USE_SCRIPT      0   /**< 1 : scripts run from the SPIx ISR (see spi_script_start, needs SPI_USE_ASYNC) */
+#endif
+#ifndef SPI_USE_BUS
+#define SPI_USE_BUS         0   /**< 1 : arbitration between the users of a module (see spi_bus_acquire) */
+#endif
+#ifndef SPI_IT_PRIORITY
+#define SPI_IT_PRIORITY     4   /**< Priority of the SPIx interrupts (1..7) */
+#endif
+#ifndef SPI_PACKED_MIN_LEN
+#define SPI_PACKED_MIN_LEN  8   /**< spi_transfer_packed_bytes : shorter transfers are sent in 8 bits mode */
+#endif
+#ifndef SPI_SPIN_BUDGET
+#define SPI_SPIN_BUDGET     0xFFFF  /**< Default spin budget of the descriptors (see spi_set_spin_budget) */
+#endif
+#ifndef SPI_IDLE_MIN_CYCLES
+#define SPI_IDLE_MIN_CYCLES 256 /**< SPI_XFER_IDLE : shortest frame (cycles) for which the core is idled, polling below */
+#endif
+#ifndef SPI_BUS_NB_PRIO
+#define SPI_BUS_NB_PRIO     8   /**< Priority levels of the users sharing a module (see spi_bus_acquire, 16 max) */
+#endif
+#ifndef SPI_STREAM_MAX_SLOTS
+#define SPI_STREAM_MAX_SLOTS    4   /**< Maximum number of buffers of a stream (see spi_stream_start) */
+#endif
+#ifndef SPI_USE_STATS
+#define SPI_USE_STATS       0   /**< 1 : per descriptor performance counters (see spi_stats_snapshot) */
+#endif
+#ifndef SPI_USE_TRACE
+#define SPI_USE_TRACE       0   /**< 1 : bus transaction trace recorder (see spi_trace_drain) */
+#endif
+#ifndef SPI_TRACE_DEPTH
+#define SPI_TRACE_DEPTH     32  /**< Records of the trace ring (power of 2, 256 max) */
+#endif
+#ifndef SPI_TRACE_DATA
+#define SPI_TRACE_DATA      4   /**< First bytes sent kept in each trace record */
+#endif
+#ifndef SPI_USE_DMA
+#define SPI_USE_DMA         0   /**< 1 : DMA transfers (devices with DMA controller, ex : PIC24FJ256GA705) */
+#endif
+
+#if (SPI_USE_STREAM || SPI_USE_SCRIPT) && !SPI_USE_ASYNC
+#error "SPI_USE_STREAM and SPI_USE_SCRIPT run on the asynchronous engine : SPI_USE_ASYNC must be 1"
+#endif
+
+#if SPI_USE_DMA
+#ifndef _DMA0IF
+#error "SPI_USE_DMA : this device has no DMA controller"
+#endif
+// DMA channels used by each module (2 channels per module : Tx and Rx)
+#ifndef SPI1_DMA_TX_CH
+#define SPI1_DMA_TX_CH      0
+#define SPI1_DMA_RX_CH      1
+#endif
+#ifndef SPI2_DMA_TX_CH
+#define SPI2_DMA_TX_CH      2
+#define SPI2_DMA_RX_CH      3
+#endif
+#if defined(_SPI3IF) && !defined(SPI3_DMA_TX_CH)
+#define SPI3_DMA_TX_CH      4
+#define SPI3_DMA_RX_CH      5
+#endif
+// DMA trigger sources (CHSEL) : see the "DMA channel trigger sources" table of the device datasheet
+#if !defined(SPI1_DMA_TX_TRIG) || !defined(SPI1_DMA_RX_TRIG) || !defined(SPI2_DMA_TX_TRIG) || !defined(SPI2_DMA_RX_TRIG)
+#error "SPI_USE_DMA : SPIx_DMA_TX_TRIG and SPIx_DMA_RX_TRIG must be defined in the project settings"
+#endif
+#if defined(_SPI3IF) && (!defined(SPI3_DMA_TX_TRIG) || !defined(SPI3_DMA_RX_TRIG))
+#error "SPI_USE_DMA : SPI3_DMA_TX_TRIG and SPI3_DMA_RX_TRIG must be defined in the project settings"
+#endif
+#ifndef SPI_DMA_IT_PRIORITY
+#define SPI_DMA_IT_PRIORITY SPI_IT_PRIORITY     /**< Priority of the DMA Rx channel interrupts */
+#endif
+#ifndef SPI_DMA_MIN_LEN
+#define SPI_DMA_MIN_LEN     16  /**< Shorter transfers are handled by the CPU (DMA setup is not free) */
+#endif
+#ifndef SPI_DMA_RAM_LOW
+#define SPI_DMA_RAM_LOW     0x0800  /**< DMAL : lowest RAM address reachable by the DMA */
+#endif
+#ifndef SPI_DMA_RAM_HIGH
+#define SPI_DMA_RAM_HIGH    0xFFFF  /**< DMAH : highest RAM address reachable by the DMA */
+#endif
+#endif
+
+//-----------------------------------------------------------------------------
+// Target dependencies
+// Besides SPI_ISR, the library only relies on the following <xc.h> symbols, so 
+// that it is built unmodified on a host against the register model of sim/ 
+// (SPI_ISR defined as empty, the ISRs called by the simulated interrupt 
+// controller, see sim/spi_sim.h and sim/Makefile) :
+//  - SPIxSTAT, SPIxCON1, SPIxCON2, SPIxBUF                     (x = 1, 2 [, 3])
+//  - _SPIxIF, _SPIxIE, _SPIxIP                                 (SPI3 is supported when _SPI3IF is defined)
+//  - DMACON, DMAL, DMAH, DMACHn, _DMAnIF, _DMAnIE, _DMAnIP     (SPI_USE_DMA only)
+//  - __builtin_disi()                                          (SPI_USE_BUS, SPI_USE_STATS, SPI_USE_TRACE)
+//  - SRbits.IPL, Idle()                                        (SPI_XFER_IDLE only)
+// The registers are accessed through the pointers of spi_desc_t, except for 
+// the interrupt flags/enables which are module specific (see the 
+// spiModules table of lib_spi_pic24_ll.c).
+#ifndef SPI_ISR
+#define SPI_ISR     __attribute__((interrupt, no_auto_psv))
+#endif
+
 //-----------------------------------------------------------------------------
 // Masks for SPIxSTAT register
 #define SPIEN_MASK  (0x0001 << 15)  /**< SPIxSTAT[15] */
+#define SRMPT_MASK  (0x0001 << 7)   /**< SPIxSTAT[7] (Enhanced Buffer mode) */
+#define SPIROV_MASK (0x0001 << 6)   /**< SPIxSTAT[6] */
+#define SRXMPT_MASK (0x0001 << 5)   /**< SPIxSTAT[5] (Enhanced Buffer mode) */
+#define SISEL_MASK  (0x0007 << 2)   /**< SPIxSTAT[4:2] (Enhanced Buffer mode) */
+#define SISEL_RX_NOT_EMPTY  (0x0001 << 2)   /**< SPIxIF is set when data is available in Rx FIFO */
 #define SPITBF_MASK (0x0001 << 1)   /**< SPIxSTAT[1] */
 #define SPIRBF_MASK (0x0001 << 0)   /**< SPIxSTAT[0] */
 
@@ -25,11 +144,39 @@
 #define SSEN_MASK   (0x0001 << 7)   /**< SPIxCON1[7] */
 #define CKP_MASK    (0x0001 << 6)   /**< SPIxCON1[6] */
 #define MSTEN_MASK  (0x0001 << 5)   /**< SPIxCON1[5] */
+
+// Masks for SPIxCON2 register
+#define FRMEN_MASK  (0x0001 << 15)  /**< SPIxCON2[15] */
+#define SPIFSD_MASK (0x0001 << 14)  /**< SPIxCON2[14] : frame sync pulse is an input (1) / an output (0) */
+#define SPIFPOL_MASK    (0x0001 << 13)  /**< SPIxCON2[13] : frame sync pulse active high (1) / low (0) */
+#define SPIFE_MASK  (0x0001 << 1)   /**< SPIxCON2[1] : frame sync pulse coincides with the first bit clock */
+#define SPIBEN_MASK (0x0001 << 0)   /**< SPIxCON2[0] */
+
+#define SPI_FIFO_DEPTH  8           /**< Depth of Tx/Rx FIFOs in Enhanced Buffer mode */
+
+#if SPI_USE_DMA
+// Masks for DMACON register
+#define DMAEN_MASK      (0x0001 << 15)  /**< DMACON[15] */
+// Masks for DMACHn register
+#define NULLW_MASK      (0x0001 << 10)  /**< DMACHn[10] */
+#define CHREQ_MASK      (0x0001 << 8)   /**< DMACHn[8] */
+#define SAMODE_INC      (0x0001 << 6)   /**< DMACHn[7:6] : source address incremented */
+#define DAMODE_INC      (0x0001 << 4)   /**< DMACHn[5:4] : destination address incremented */
+#define SIZE_BYTE_MASK  (0x0001 << 1)   /**< DMACHn[1] */
+#define CHEN_MASK       (0x0001 << 0)   /**< DMACHn[0] */
+// Masks for DMAINTn register
+#define CHSEL_POS       8               /**< DMAINTn[14:8] */
+#define DONEIF_MASK     (0x0001 << 5)   /**< DMAINTn[5] */
+#endif
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
 typedef enum    {   _SPI1,      /**< Value for SPI1 module */
-                    _SPI2       /**< Value for SPI2 module */
+                    _SPI2,      /**< Value for SPI2 module */
+#ifdef _SPI3IF
+                    _SPI3,      /**< Value for SPI3 module (when available) */
+#endif
+                    SPI_NB_MODULES  /**< Number of SPI modules of the device */
                     } spi_id_t;
 //-----------------------------------------------------------------------------
 /** Modes SPI :
@@ -53,6 +200,58 @@ typedef enum    {   MID_SMP,    /**< MID_SMP => Sample point = milieu donn
 typedef enum    {   BITS8,      /**< 8 bits data format  */
                     BITS16      /**< 16 bits data format  */
                     } spiDataFormat_t;
+
+/** Buffer modes :
+ *  The Enhanced Buffer mode (8-deep Tx and Rx FIFOs) is only available on 
+ *  devices whose SPIxCON2 register implements the SPIBEN bit.
+ *  On other devices, spi_init() falls back to the standard buffer mode.
+ */
+typedef enum    {   STANDARD_BUFFER,    /**< Single Tx / Rx buffer (legacy mode) */
+                    ENHANCED_BUFFER     /**< 8-deep Tx and Rx FIFOs (burst transfers) */
+                    } spiBufferMode_t;
+
+/** Roles :
+ *  In slave mode, SCK is an input : the prescalers and the sample point are 
+ *  not used (SMP cleared). When the clock phase is ACTIVE_TO_IDLE_CPHASE (CKE 
+ *  set), the SSx pin must be used (SPI_SLAVE_SS).
+ */
+typedef enum    {   SPI_MASTER,         /**< Master mode (SCK output) */
+                    SPI_SLAVE,          /**< Slave mode, SSx pin not used */
+                    SPI_SLAVE_SS        /**< Slave mode, frames only received while SSx is low */
+                    } spiRole_t;
+
+/** Framed modes :
+ *  One frame sync pulse per frame on the SSx pin, generated by the module 
+ *  (SPI_FRAMED_SYNC_OUT) or by the other device (SPI_FRAMED_SYNC_IN).
+ */
+typedef enum    {   SPI_UNFRAMED,           /**< Standard SPI (no frame sync pulse) */
+                    SPI_FRAMED_SYNC_OUT,    /**< Framed mode, the frame sync pulse is an output */
+                    SPI_FRAMED_SYNC_IN      /**< Framed mode, the frame sync pulse is an input */
+                    } spiFrameMode_t;
+
+typedef enum    {   FSYNC_ACTIVE_LOW,   /**< Frame sync pulse is active low */
+                    FSYNC_ACTIVE_HIGH   /**< Frame sync pulse is active high */
+                    } spiFrameSyncPolarity_t;
+
+/** Transfer modes :
+ *  SPI_XFER_DMA requires SPI_USE_DMA (see spi_set_transfer_mode)
+ */
+typedef enum    {   SPI_XFER_CPU,       /**< Data moved by the CPU (polling or interrupt) */
+                    SPI_XFER_DMA,       /**< Data moved by 2 DMA channels (Tx and Rx)     */
+                    SPI_XFER_IDLE       /**< Data moved by the CPU, the core idles while each frame is shifted */
+                    } spiTransferMode_t;
+
+#if SPI_USE_DMA
+/** Type spi_dma_ch_t : registers of one DMA channel 
+ */
+typedef struct {
+    uint16_t    DMACH;
+    uint16_t    DMAINT;
+    uint16_t    DMASRC;
+    uint16_t    DMADST;
+    uint16_t    DMACNT;
+    } spi_dma_ch_t;
+#endif
                     
 /*-----------------------------------------------------------------------------*/
 /* Dbit Bus :                                                                  */
@@ -73,12 +272,128 @@ typedef  enum   {   PRI_PRE_64,     /**< Primary Prescaler is 1:64  */
                     PRI_PRE_4,      /**< Primary Prescaler is 1:4   */
                     PRI_PRE_1       /**< Primary Prescaler is 1:1   */
                     } tPriPrescaler;
+
+/*-----------------------------------------------------------------------------*/
+/* Compile time SPIxCON1 / SPIxCON2 values                                     */
+/* The values of tPriPrescaler and tSecPrescaler are the PPRE<1:0> and         */
+/* SPRE<2:0> encodings of SPIxCON1.                                            */
+/*-----------------------------------------------------------------------------*/
+#define SPI_PRI_DIV(pri)    (1U << (2 * (3 - (pri))))   /**< tPriPrescaler -> 1, 4, 16, 64 */
+#define SPI_SEC_DIV(sec)    (8U - (sec))                /**< tSecPrescaler -> 1..8         */
+
+/** PPRE / SPRE fields of SPIxCON1 */
+#define SPI_CON1_PRESCALERS(pri, sec)   ((((uint16_t)(sec) & 0x07) << 2) | ((uint16_t)(pri) & 0x03))
+
+/** Full SPIxCON1 value (master mode, SSx pin not used) */
+#define SPI_CON1(polarity, phase, smp, format, pri, sec)                \
+            (MSTEN_MASK                                                 \
+            | (((format) == BITS16)?MODE16_MASK:0)                      \
+            | (((smp) == END_SMP)?SMP_MASK:0)                           \
+            | (((phase) == ACTIVE_TO_IDLE_CPHASE)?CKE_MASK:0)           \
+            | (((polarity) == CLK_IDLE_IS_HIGH)?CKP_MASK:0)             \
+            | SPI_CON1_PRESCALERS(pri, sec))
+
+/** Full SPIxCON1 value (slave mode : SCK is an input, SSx pin used if useSS) */
+#define SPI_CON1_SLAVE(polarity, phase, format, useSS)                  \
+            (((useSS)?SSEN_MASK:0)                                      \
+            | (((format) == BITS16)?MODE16_MASK:0)                      \
+            | (((phase) == ACTIVE_TO_IDLE_CPHASE)?CKE_MASK:0)           \
+            | (((polarity) == CLK_IDLE_IS_HIGH)?CKP_MASK:0))
+
+/** Full SPIxCON2 value */
+#define SPI_CON2(bufferMode)    (((bufferMode) == ENHANCED_BUFFER)?SPIBEN_MASK:0)
+
+/** Full SPIxCON2 value (framed mode) */
+#define SPI_CON2_FRAMED(bufferMode, syncIn, syncPolarity)                \
+            (SPI_CON2(bufferMode) | FRMEN_MASK                          \
+            | ((syncIn)?SPIFSD_MASK:0)                                  \
+            | (((syncPolarity) == FSYNC_ACTIVE_HIGH)?SPIFPOL_MASK:0))
+
+/** SCK frequency (Hz) given by the PPRE / SPRE fields of a SPIxCON1 value */
+#define SPI_CON1_SCK_HZ(fcy, con1)  ((uint32_t)(fcy) / (SPI_PRI_DIV((con1) & 0x03) * SPI_SEC_DIV(((con1) >> 2) & 0x07)))
+
+/** Fastest PPRE / SPRE fields for which Fsck <= hz (same rule as spi_clock_solve)
+ *  Ex : #define MY_CON1 (SPI_CON1(CLK_IDLE_IS_LOW, ACTIVE_TO_IDLE_CPHASE, MID_SMP, BITS8, 0, 0) | SPI_CON1_PRESCALERS_HZ(FCY, 1000000UL))
+ */
+#define SPI_DIV_FITS(fcy, hz, div)  ((((uint32_t)(fcy) + (div) - 1) / (div)) <= (uint32_t)(hz))
+#define SPI_CON1_PRESCALERS_HZ(fcy, hz)                                                         \
+            (SPI_DIV_FITS(fcy, hz, 2)   ? SPI_CON1_PRESCALERS(PRI_PRE_1, SEC_PRE_2) :           \
+             SPI_DIV_FITS(fcy, hz, 3)   ? SPI_CON1_PRESCALERS(PRI_PRE_1, SEC_PRE_3) :           \
+             SPI_DIV_FITS(fcy, hz, 4)   ? SPI_CON1_PRESCALERS(PRI_PRE_1, SEC_PRE_4) :           \
+             SPI_DIV_FITS(fcy, hz, 5)   ? SPI_CON1_PRESCALERS(PRI_PRE_1, SEC_PRE_5) :           \
+             SPI_DIV_FITS(fcy, hz, 6)   ? SPI_CON1_PRESCALERS(PRI_PRE_1, SEC_PRE_6) :           \
+             SPI_DIV_FITS(fcy, hz, 7)   ? SPI_CON1_PRESCALERS(PRI_PRE_1, SEC_PRE_7) :           \
+             SPI_DIV_FITS(fcy, hz, 8)   ? SPI_CON1_PRESCALERS(PRI_PRE_1, SEC_PRE_8) :           \
+             SPI_DIV_FITS(fcy, hz, 12)  ? SPI_CON1_PRESCALERS(PRI_PRE_4, SEC_PRE_3) :           \
+             SPI_DIV_FITS(fcy, hz, 16)  ? SPI_CON1_PRESCALERS(PRI_PRE_4, SEC_PRE_4) :           \
+             SPI_DIV_FITS(fcy, hz, 20)  ? SPI_CON1_PRESCALERS(PRI_PRE_4, SEC_PRE_5) :           \
+             SPI_DIV_FITS(fcy, hz, 24)  ? SPI_CON1_PRESCALERS(PRI_PRE_4, SEC_PRE_6) :           \
+             SPI_DIV_FITS(fcy, hz, 28)  ? SPI_CON1_PRESCALERS(PRI_PRE_4, SEC_PRE_7) :           \
+             SPI_DIV_FITS(fcy, hz, 32)  ? SPI_CON1_PRESCALERS(PRI_PRE_4, SEC_PRE_8) :           \
+             SPI_DIV_FITS(fcy, hz, 48)  ? SPI_CON1_PRESCALERS(PRI_PRE_16, SEC_PRE_3) :          \
+             SPI_DIV_FITS(fcy, hz, 64)  ? SPI_CON1_PRESCALERS(PRI_PRE_16, SEC_PRE_4) :          \
+             SPI_DIV_FITS(fcy, hz, 80)  ? SPI_CON1_PRESCALERS(PRI_PRE_16, SEC_PRE_5) :          \
+             SPI_DIV_FITS(fcy, hz, 96)  ? SPI_CON1_PRESCALERS(PRI_PRE_16, SEC_PRE_6) :          \
+             SPI_DIV_FITS(fcy, hz, 112) ? SPI_CON1_PRESCALERS(PRI_PRE_16, SEC_PRE_7) :          \
+             SPI_DIV_FITS(fcy, hz, 128) ? SPI_CON1_PRESCALERS(PRI_PRE_16, SEC_PRE_8) :          \
+             SPI_DIV_FITS(fcy, hz, 192) ? SPI_CON1_PRESCALERS(PRI_PRE_64, SEC_PRE_3) :          \
+             SPI_DIV_FITS(fcy, hz, 256) ? SPI_CON1_PRESCALERS(PRI_PRE_64, SEC_PRE_4) :          \
+             SPI_DIV_FITS(fcy, hz, 320) ? SPI_CON1_PRESCALERS(PRI_PRE_64, SEC_PRE_5) :          \
+             SPI_DIV_FITS(fcy, hz, 384) ? SPI_CON1_PRESCALERS(PRI_PRE_64, SEC_PRE_6) :          \
+             SPI_DIV_FITS(fcy, hz, 448) ? SPI_CON1_PRESCALERS(PRI_PRE_64, SEC_PRE_7) :          \
+                                          SPI_CON1_PRESCALERS(PRI_PRE_64, SEC_PRE_8))
                     
 typedef enum    {   SPI_OK,                 /**< Succes value                           */
                     SPI_ERROR,              /**< Non Specific Error                     */
                     SPI_BAD_DATA_FORMAT,      /**< error in data size : 8bits vs 16 bits  */
-                    SPI_UNKNOWN_MODULE      /**< The SPI Module ID is unknown           */
+                    SPI_UNKNOWN_MODULE,     /**< The SPI Module ID is unknown           */
+                    SPI_BUSY,               /**< An asynchronous transfer is in progress */
+                    SPI_TIMEOUT,            /**< Spin budget exhausted : module reset   */
+                    SPI_OVERRUN,            /**< SPIROV found set : module reset        */
+                    SPI_CRC_ERROR           /**< Received CRC does not match the data   */
                     } spi_err_t; 
+
+#define SPI_SPIN_BUDGET_MIN     2       /**< Smallest spin budget */
+
+typedef enum    {   SPI_ASYNC_IDLE,         /**< No asynchronous transfer started       */
+                    SPI_ASYNC_BUSY,         /**< Asynchronous transfer in progress      */
+                    SPI_ASYNC_DONE,         /**< Last asynchronous transfer completed   */
+                    SPI_ASYNC_CANCELLED     /**< Last asynchronous transfer cancelled   */
+                    } spi_async_status_t;
+
+struct spi_desc_s;
+
+/** Type spi_callback_t
+ * 
+ * Completion callback of asynchronous transfers (result : SPI_OK or SPI_OVERRUN). 
+ * @attention : Called from the SPIx interrupt context
+ */
+typedef void (*spi_callback_t)(struct spi_desc_s *pSpi, spi_err_t result, void *pCtx);
+
+/** Type spi_grant_callback_t
+ * 
+ * The bus was handed over to a pending user (see spi_bus_acquire) : the user
+ * owns it and must release it with spi_bus_release.
+ * @attention : Called from the context of the previous owner (main loop or 
+ *              ISR) : the callback should only signal the user (flag, task 
+ *              wake-up) or run a short transaction
+ */
+typedef void (*spi_grant_callback_t)(struct spi_desc_s *pSpi, void *pCtx);
+
+/** Type spi_stream_callback_t
+ * 
+ * A stream buffer is full : it belongs to the application until it is given 
+ * back with spi_stream_release (which may be called from the callback).
+ * @attention : Called from the SPIx interrupt context
+ */
+typedef void (*spi_stream_callback_t)(struct spi_desc_s *pSpi, void *pBuffer, void *pCtx);
+                    
+/** Type spi_script_callback_t
+ * 
+ * Called by a SPI_OP_CALLBACK step of a script (code : arg of the step).
+ * @attention : Called from the SPIx interrupt context
+ */
+typedef void (*spi_script_callback_t)(struct spi_desc_s *pSpi, uint16_t code, void *pCtx);
                     
 /** Type spi_config_t
  * 
@@ -91,33 +406,436 @@ typedef struct{
     spiDataFormat_t     spiDataFormat;
     tPriPrescaler       spiPrimaryPrescaler;
     tSecPrescaler       spiSecondaryPrescaler;
+    spiBufferMode_t     spiBufferMode;
+    spiRole_t           spiRole;
+    spiFrameMode_t      spiFrameMode;
+    spiFrameSyncPolarity_t  spiFrameSyncPolarity;   /**< Framed modes only */
     } spi_config_t;
+
+/** Type spi_cs_t
+ * 
+ * Chip Select line of a slave device : either a user function (pfSelect not 
+ * NULL), or an active low port pin (pLAT / mask, ex : &LATB / (1 << 2))
+ */
+typedef struct{
+    void                (*pfSelect)(uint8_t assert, void *pCtx);   /**< assert : 1 = select, 0 = release */
+    void                *pCtx;
+    volatile uint16_t   *pLAT;
+    uint16_t            mask;
+    } spi_cs_t;
+
+/** Type spi_segment_t
+ * 
+ * One piece of a transaction (opcode, address, payload, readback...)
+ */
+typedef struct{
+    const void  *pTx;       /**< uint8_t* or uint16_t* according to width, or NULL : fill is sent */
+    void        *pRx;       /**< uint8_t* or uint16_t* according to width, or NULL : Rx discarded */
+    size_t      len;        /**< number of frames */
+    uint16_t    fill;       /**< Frame sent when pTx is NULL */
+    uint8_t     width;      /**< 8, 16 or 0 (data format of the module) */
+    } spi_segment_t;
+
+/** Type spi_reg_job_t
+ * 
+ * One register block read of a batch (see spi_transfer_reg_batch)
+ */
+typedef struct{
+    const spi_cs_t  *pCs;       /**< Chip Select line of the device, or NULL */
+    uint8_t         reg;        /**< Address byte (read / auto-increment flags included) */
+    uint8_t         len;        /**< Data bytes read after the address byte */
+    } spi_reg_job_t;
+
+/** Type spi_ring_t
+ * 
+ * Lock-free single producer / single consumer ring of frames (uint8_t or 
+ * uint16_t according to format, see spi_ring_init). head is only written by 
+ * the producer and tail by the consumer : the 16 bits accesses being atomic 
+ * on the PIC24, the ISR and the application may use the ring concurrently.
+ */
+typedef struct{
+    void            *pBuf;
+    uint16_t        mask;           /**< size - 1 (size is a power of 2) */
+    spiDataFormat_t format;
+    volatile uint16_t   head;       /**< Frames written (free running) */
+    volatile uint16_t   tail;       /**< Frames read (free running) */
+    } spi_ring_t;
+
+/** Script op codes (see spi_script_start) 
+ *  Frame steps (TX_LIT, TX_BUF, RX_BUF, DELAY) are sent back-to-back, the 
+ *  other steps wait for the frames in flight to be received.
+ */
+typedef enum    {   SPI_OP_END,         /**< End of the script */
+                    SPI_OP_CS_ASSERT,   /**< p : spi_cs_t to assert */
+                    SPI_OP_CS_RELEASE,  /**< p : spi_cs_t to release */
+                    SPI_OP_TX_LIT,      /**< 1 frame : arg, Rx discarded */
+                    SPI_OP_TX_BUF,      /**< arg frames from p, Rx discarded */
+                    SPI_OP_RX_BUF,      /**< arg frames into p, 0xFF / 0xFFFF sent */
+                    SPI_OP_DELAY,       /**< arg frame times (0xFF / 0xFFFF sent, no slave must be selected) */
+                    SPI_OP_CALLBACK     /**< script callback called with code arg */
+                    } spi_op_t;
+
+/** Type spi_script_op_t : one step of a script (see SPI_SCRIPT_xxx) */
+typedef struct{
+    uint8_t     op;         /**< spi_op_t */
+    uint16_t    arg;        /**< Frame, number of frames or callback code */
+    void        *p;         /**< spi_cs_t*, uint8_t* or uint16_t* (data format of the module) */
+    } spi_script_op_t;
+
+#define SPI_SCRIPT_CS_ASSERT(pCs)       {SPI_OP_CS_ASSERT, 0, (void*)(pCs)}
+#define SPI_SCRIPT_CS_RELEASE(pCs)      {SPI_OP_CS_RELEASE, 0, (void*)(pCs)}
+#define SPI_SCRIPT_TX_LIT(frame)        {SPI_OP_TX_LIT, (frame), NULL}
+#define SPI_SCRIPT_TX_BUF(pBuf, len)    {SPI_OP_TX_BUF, (len), (void*)(pBuf)}
+#define SPI_SCRIPT_RX_BUF(pBuf, len)    {SPI_OP_RX_BUF, (len), (void*)(pBuf)}
+#define SPI_SCRIPT_DELAY(frames)        {SPI_OP_DELAY, (frames), NULL}
+#define SPI_SCRIPT_CALLBACK(code)       {SPI_OP_CALLBACK, (code), NULL}
+#define SPI_SCRIPT_END()                {SPI_OP_END, 0, NULL}
+
+/** CRC types (MSB first, no reflection, no final xor) */
+typedef enum    {   SPI_CRC7,       /**< x^7+x^3+1 (SD commands), value left aligned : crc7 << 1 */
+                    SPI_CRC8,       /**< x^8+x^2+x+1 */
+                    SPI_CRC16       /**< x^16+x^12+x^5+1 (CCITT / XMODEM, SD data blocks) */
+                    } spiCrcType_t;
+
+/** Options of spi_transfer_crc_bytes */
+#define SPI_CRC_SEND    0x01    /**< The Tx CRC is sent after the data */
+#define SPI_CRC_CHECK   0x02    /**< The CRC received after the data is checked */
+
+/** Type spi_crc_t : running CRCs of a transfer (see spi_crc_init) */
+typedef struct{
+    spiCrcType_t    type;
+    uint16_t        txCrc;      /**< CRC of the data sent */
+    uint16_t        rxCrc;      /**< CRC of the data received */
+    } spi_crc_t;
+
+#if SPI_USE_STATS || SPI_USE_TRACE
+/** Type spi_timer_t : free running timer read by the statistics / the trace (any unit) */
+typedef uint32_t (*spi_timer_t)(void);
+#endif
+
+#if SPI_USE_TRACE
+/** Type spi_trace_op_t : transfer call of a trace record */
+typedef enum    {   SPI_TRACE_RAW_BYTE,
+                    SPI_TRACE_RAW_WORD,
+                    SPI_TRACE_RAW_BYTES,
+                    SPI_TRACE_RAW_WORDS,
+                    SPI_TRACE_PACKED_BYTES,
+                    SPI_TRACE_SEGMENTS,
+                    SPI_TRACE_CRC_BYTES,
+                    SPI_TRACE_ASYNC,        /**< spi_transfer_async (ISR or DMA) */
+                    SPI_TRACE_SCRIPT,       /**< spi_script_start */
+                    SPI_TRACE_REG_BATCH
+                    } spi_trace_op_t;
+
+/** Type spi_trace_rec_t
+ * 
+ * One bus transaction (see spi_trace_drain)
+ */
+typedef struct{
+    uint32_t    start;                  /**< Timer value at the call */
+    uint32_t    end;                    /**< Timer value at the completion */
+    uint16_t    len;                    /**< Frames moved */
+    uint8_t     module;                 /**< spi_id_t */
+    uint8_t     tag;                    /**< Device tag (see spi_trace_tag) */
+    uint8_t     op;                     /**< spi_trace_op_t */
+    uint8_t     result;                 /**< spi_err_t */
+    uint8_t     data[SPI_TRACE_DATA];   /**< First bytes sent, as stored in memory (0xFF : fill / unused) */
+    } spi_trace_rec_t;
+#endif
+
+#if SPI_USE_STATS
+
+/** Type spi_stats_t
+ * 
+ * Performance counters of a descriptor (see spi_stats_snapshot)
+ */
+typedef struct{
+    uint32_t    nbBytes;        /**< Bytes moved (8 bits frames, packed bytes) */
+    uint32_t    nbWords;        /**< Words moved (16 bits frames) */
+    uint32_t    nbTransactions; /**< Successful transfer calls (a *_reg(s) call counts 2) */
+    uint32_t    txSpins;        /**< Polls of SPITBF while the Tx buffer was full */
+    uint32_t    rxSpins;        /**< Polls while waiting for a received frame */
+    uint32_t    nbOverruns;     /**< SPIROV found set at the end of a transfer */
+    uint32_t    nbErrors;       /**< Transfer calls returning an error */
+    uint32_t    durMin;         /**< Shortest transaction (timer units) */
+    uint32_t    durMax;         /**< Longest transaction (timer units) */
+    uint32_t    durSum;         /**< Sum of the transaction durations (timer units) */
+    uint32_t    durAvg;         /**< durSum / nbTransactions (computed by spi_stats_snapshot) */
+    } spi_stats_t;
+#endif
                     
 /** Type spi_desc_t
  * 
  * 
  */
-typedef struct {
+typedef struct spi_desc_s {
     spi_id_t    spiID;
-    uint16_t    *pSPIxSTAT;
-    uint16_t    *pSPIxCON1;
-    uint16_t    *pSPIxCON2;
-    uint16_t    *pSPIBUF;
+    volatile uint16_t   *pSPIxSTAT;
+    volatile uint16_t   *pSPIxCON1;
+    volatile uint16_t   *pSPIxCON2;
+    volatile uint16_t   *pSPIBUF;
     spiDataFormat_t     spiDataFormat;
+    spiBufferMode_t     spiBufferMode;      /**< Buffer mode actually in use */
+    spiTransferMode_t   spiTransferMode;    /**< See spi_set_transfer_mode() */
+    uint16_t            con1;               /**< SPIxCON1 value in use */
+    uint16_t            con2;               /**< SPIxCON2 value in use */
+    uint16_t            spinBudget;         /**< See spi_set_spin_budget() */
+    uint8_t             idleWait;           /**< SPI_XFER_IDLE and frame >= SPI_IDLE_MIN_CYCLES : the core is idled */
+#if SPI_USE_DMA
+    volatile spi_dma_ch_t   *pDmaTx;
+    volatile spi_dma_ch_t   *pDmaRx;
+#endif
+#if SPI_USE_STATS
+    spi_stats_t stats;
+    spi_timer_t pfStatsTimer;       /**< See spi_stats_set_timer() */
+    uint32_t    statsAsyncStart;    /**< Start time of the asynchronous transfer */
+#endif
+#if SPI_USE_TRACE
+    uint8_t     traceTag;           /**< See spi_trace_tag() */
+    uint8_t     traceAsyncOp;       /**< spi_trace_op_t of the asynchronous transfer */
+    uint32_t    traceAsyncStart;    /**< Start time of the asynchronous transfer */
+#endif
+    
+    // Interrupt driven transfers
+    void        (*pfIsrHandler)(struct spi_desc_s *pSpi);   /**< Engine run by the SPIx ISR */
+    volatile spi_async_status_t asyncStatus;
+#if SPI_USE_ASYNC
+    const void  *pAsyncTx;          /**< uint8_t* or uint16_t* according to spiDataFormat */
+    void        *pAsyncRx;          /**< uint8_t* or uint16_t* according to spiDataFormat */
+    size_t      asyncLen;
+    size_t      asyncTxIdx;
+    size_t      asyncRxIdx;
+    spi_callback_t  pfCallback;
+    void        *pCallbackCtx;
+#endif
+#if SPI_USE_STREAM
+    // Streaming (see spi_stream_start) : asyncTxIdx = frames in flight
+    spi_stream_callback_t   pfStreamCallback;
+    const spi_cs_t  *pStreamCs;         /**< Chip Select toggled around each frame, or NULL */
+    uint16_t    streamCmd;              /**< Frame sent to get each sample */
+    size_t      streamIdx;              /**< Frame index in the slot being filled */
+    uint8_t     streamNbSlots;
+    uint8_t     streamSlot;             /**< Slot being filled */
+    uint8_t     streamDrop;             /**< 1 : no free slot, the current block is discarded */
+    volatile uint8_t    streamHeld[SPI_STREAM_MAX_SLOTS];   /**< 1 : slot owned by the application */
+    volatile uint16_t   streamOverflows;    /**< Blocks discarded (consumer too slow) */
+#endif
+#if SPI_USE_SLAVE
+    // Slave mode (see spi_slave_start)
+    spi_ring_t  *pSlaveRx;
+    spi_ring_t  *pSlaveTx;
+    uint16_t    slaveFill;              /**< Frame loaded when the Tx ring is empty */
+    volatile uint16_t   slaveUnderruns; /**< Fill frames loaded (Tx ring empty) */
+    volatile uint16_t   slaveOverruns;  /**< Frames lost (Rx ring full or SPIROV) */
+#endif
+#if SPI_USE_SCRIPT
+    // Scripts (see spi_script_start) : asyncTxIdx = frames in flight
+    const spi_script_op_t   *pScript;
+    spi_script_callback_t   pfScriptCallback;
+    uint16_t    scriptTxOp;             /**< Step of the next frame to load */
+    uint16_t    scriptTxIdx;            /**< Frame index in this step */
+    uint16_t    scriptRxOp;             /**< Step of the next frame to receive */
+    uint16_t    scriptRxIdx;
+#endif
+#if SPI_USE_BUS
+    // Bus arbitration (see spi_bus_acquire)
+    const void  * volatile pBusOwner;   /**< Identity of the owner, NULL : bus free */
+    volatile uint16_t   busPending;     /**< Bit n : a user of priority n waits for the bus */
+    const void  *pGrantUser[SPI_BUS_NB_PRIO];   /**< Identity of the user pending at priority n */
+    spi_grant_callback_t    pfGrant[SPI_BUS_NB_PRIO];
+    void        *pGrantCtx[SPI_BUS_NB_PRIO];
+#endif
     } spi_desc_t;            
 
                             
 /**
  * @brief   Initialize the SPI module
  * 
- * @param[in]   ID of the target SPI module (_SPI1 or _SPI2)
+ * @param[in]   ID of the target SPI module (_SPI1, _SPI2 or _SPI3)
  * @param[in]   Address of the fully completed spi_config_t structure
  * @param[out]  Spi module descriptor  	
  * 
  * @return  SPI_OK
  * @return  SPI_UNKNOWN_MODULE 
+ * @return  SPI_ERROR   pSpiCFG is NULL (nothing written)
+ * 
+ * @info    If ENHANCED_BUFFER is requested on a device without SPIBEN bit, the
+ *          module is configured in STANDARD_BUFFER mode (see pSpi->spiBufferMode)
+ * @info    The fields are not checked : see spi_config_check
  */
 spi_err_t   spi_init(spi_id_t spi_id, spi_config_t* pSpiCFG, spi_desc_t *pSpi);
+
+/**
+ * @brief   Initialize the SPI module with precomputed register values
+ * 
+ * Same as spi_init(), without any computation (see SPI_CON1 / SPI_CON2)
+ * 
+ * @param[in]   spi_id  ID of the target SPI module (_SPI1, _SPI2 or _SPI3)
+ * @param[in]   con1    SPIxCON1 value
+ * @param[in]   con2    SPIxCON2 value
+ * @param[out]  pSpi    Spi module descriptor  	
+ * 
+ * @return  SPI_OK
+ * @return  SPI_UNKNOWN_MODULE 
+ */
+spi_err_t   spi_init_regs(spi_id_t spi_id, uint16_t con1, uint16_t con2, spi_desc_t *pSpi);
+
+/**
+ * @brief   Returns the SPIxCON1 / SPIxCON2 values matching a configuration
+ * 
+ * @param[in]   pSpiCFG     Address of the fully completed spi_config_t structure
+ * 
+ * @return  SPIxCON1 / SPIxCON2 value
+ */
+uint16_t    spi_config_con1(const spi_config_t *pSpiCFG);
+uint16_t    spi_config_con2(const spi_config_t *pSpiCFG);
+
+/**
+ * @brief   Checks a configuration against the data sheet (optional, 
+ *          spi_init does not call it)
+ * 
+ * The fields not used by the role / frame mode are not checked.
+ * 
+ * @param[in]   pSpiCFG     Address of the fully completed spi_config_t structure
+ * 
+ * @return  SPI_OK
+ * @return  SPI_ERROR   pSpiCFG is NULL, or a field is out of its enum, or 
+ *                      PRI_PRE_1 with SEC_PRE_1 (master), or 
+ *                      ACTIVE_TO_IDLE_CPHASE with SPI_SLAVE
+ */
+spi_err_t   spi_config_check(const spi_config_t *pSpiCFG);
+
+/**
+ * @brief   Selects the fastest legal prescalers pair that does not exceed 
+ *          the target SCK frequency
+ * 
+ * Fsck = Fcy / (PriPrescaler * SecPrescaler), 1:1 x 1:1 being illegal.
+ * Only the prescaler fields of pSpiCFG are updated.
+ * 
+ * @param[in]       fcy         Instruction clock frequency (Hz)
+ * @param[in]       sckHz       Target (maximum) SCK frequency (Hz)
+ * @param[in,out]   pSpiCFG     Configuration to update
+ * @param[out]      pActualHz   Achieved SCK frequency (Hz) or NULL
+ * 
+ * @return  SPI_OK
+ * @return  SPI_ERROR   sckHz is lower than Fcy / 512 (pSpiCFG is not modified)
+ */
+spi_err_t   spi_clock_solve(uint32_t fcy, uint32_t sckHz, spi_config_t *pSpiCFG, uint32_t *pActualHz);
+
+/**
+ * @brief   Changes the configuration of an initialized SPI module 
+ * 
+ * The registers are only written (module disabled meanwhile) if the values 
+ * differ from the ones in use. The transfer mode is kept.
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[in]   con1    SPIxCON1 value
+ * @param[in]   con2    SPIxCON2 value
+ * 
+ * @return  SPI_OK
+ * @return  SPI_BUSY
+ * 
+ * @attention : While the module is disabled, SCK / SDO are driven by their 
+ *              port latches : no slave must be selected.
+ */
+spi_err_t   spi_reconfigure(spi_desc_t *pSpi, uint16_t con1, uint16_t con2);
+
+/**
+ * @brief   Sets the spin budget of a descriptor (SPI_SPIN_BUDGET after spi_init)
+ * 
+ * Every blocking wait of the library (Tx buffer empty, frame received, DMA 
+ * completion, cancel flush) gives up after budget consecutive polls without 
+ * any progress (a frame received / a DMA count change). The function then 
+ * returns SPI_TIMEOUT, the module being reset (disabled / re-enabled with the 
+ * same configuration : FIFOs flushed). An overrun (SPIROV) found at the end 
+ * of a transfer also resets the module and returns SPI_OVERRUN.
+ * 
+ * Worst case execution time of a blocking call of len frames : 
+ *      len * (Tframe + Tpoll) + budget * Tpoll (per run of frames of the 
+ *      same width for spi_transfer_packed_bytes and spi_transfer_segments)
+ * with Tframe = bits * PriPrescaler * SecPrescaler cycles and Tpoll the cost 
+ * of one poll (a few cycles, see the benchmark). For a stalled module 
+ * (not enabled, no clock) the call lasts at most budget * Tpoll.
+ * The budget must exceed Tframe / Tpoll (ex : 8 bits, 1:64 x 1:8, Tpoll = 4 
+ * cycles => budget > 1024).
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[in]   budget  Polls without progress (raised to SPI_SPIN_BUDGET_MIN)
+ */
+void    spi_set_spin_budget(spi_desc_t *pSpi, uint16_t budget);
+
+/**
+ * @brief   Asserts / releases a Chip Select line
+ * 
+ * @param[in]   pCs     Chip Select line, or NULL (nothing done)
+ */
+void    spi_cs_assert(const spi_cs_t *pCs);
+void    spi_cs_release(const spi_cs_t *pCs);
+
+#if SPI_USE_BUS
+/**
+ * @brief   Takes the ownership of a module shared by several users (main 
+ *          loop, ISRs), each user having its own priority
+ * 
+ * A user is identified by the address of an object of its own (ex : its 
+ * spi_device_t), the owner being recognized by this identity only. The 
+ * ownership is only a convention between the users : the transfer 
+ * functions do not check it. The arbitration masks the interrupts for a few 
+ * instructions only (__builtin_disi), never during a transfer.
+ * When the bus is owned by another user, the request is queued if pfGrant 
+ * is not NULL : at the end of the transaction, spi_bus_release hands the 
+ * bus over to the pending user of highest priority and calls its pfGrant. 
+ * A user thus waits for the transaction in progress at most, the lower 
+ * priority users pending being served afterwards.
+ * 
+ * @param[in]   pSpi        Address of the Spi module descriptor
+ * @param[in]   pUser       Identity of the user (not NULL)
+ * @param[in]   prio        Priority of the user (0..SPI_BUS_NB_PRIO-1, 
+ *                          higher is served first), one pending request 
+ *                          per priority
+ * @param[in]   pfGrant     Called when the bus is handed over, or NULL 
+ *                          (try only : nothing queued)
+ * @param[in]   pCtx        Passed to pfGrant
+ *
+ * @return     SPI_OK       the bus is owned by the caller
+ * @return     SPI_BUSY     owned by another user (request queued if pfGrant)
+ * @return     SPI_ERROR    pUser NULL, bad priority, pUser already owns the 
+ *                          bus, or a request is already pending at this 
+ *                          priority
+ * 
+ * @attention : The interrupts of priority 7 are not masked by 
+ *              __builtin_disi : such ISRs must not use the arbitration
+ */
+spi_err_t   spi_bus_acquire(spi_desc_t *pSpi, const void *pUser, uint8_t prio, spi_grant_callback_t pfGrant, void *pCtx);
+
+/**
+ * @brief   Ends the ownership : the bus is handed over to the pending user of 
+ *          highest priority (its pfGrant being called) or freed
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[in]   pUser   Identity of the owner
+ * 
+ * @return     SPI_OK
+ * @return     SPI_ERROR    pUser does not own the bus (nothing done)
+ */
+spi_err_t   spi_bus_release(spi_desc_t *pSpi, const void *pUser);
+
+/**
+ * @brief   Withdraws a pending request (see spi_bus_acquire)
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[in]   pUser   Identity of the user
+ * 
+ * @return     SPI_OK       withdrawn, or not pending
+ * @return     SPI_BUSY     already granted : the bus must be released
+ */
+spi_err_t   spi_bus_cancel(spi_desc_t *pSpi, const void *pUser);
+
+/**
+ * @brief   Identity of the owner of the bus, or NULL (bus free)
+ */
+const void  *spi_bus_owner(const spi_desc_t *pSpi);
+#endif
     
  /**
   * @brief   Initiates a SPI transfer based using the Spi module descriptor  
@@ -128,9 +846,10 @@ spi_err_t   spi_init(spi_id_t spi_id, spi_config_t* pSpiCFG, spi_desc_t *pSpi);
   * @param[in]  Data to Tx
   * @param[out] Address of the location to store the Rx data or NULL   	
   * 
-  * @return     SPI_OK or SPI_UNKNOWN_MODULE 
-  * @return     SPI_UNKNOWN_MODULE 
+  * @return     SPI_OK
   * @return     SPI_BAD_DATA_FORMAT
+  * @return     SPI_BUSY
+  * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget)
   * 
   * @attention : The CS line must be asserted by the user before calling this 
   *              function, and deasserted once the tranfert is fully completed
@@ -145,13 +864,17 @@ spi_err_t   spi_transfer_raw_word(spi_desc_t *pSpi, uint16_t TxData, uint16_t *p
  * @info a "word" is 16bits wide
  * 
  * @param[in]  pSpi  Address of the Spi module descriptor
- * @param[in]  pTxData Address of Data to Tx
- * @param[out] pRxData Address of the location to store the Rx data   	
+ * @param[in]  pTxData Address of Data to Tx or NULL (0xFF / 0xFFFF is sent)
+ * @param[out] pRxData Address of the location to store the Rx data or NULL
  * @param[in]  len : number of bytes to transfer 
  * 
- * @return     SPI_OK or SPI_UNKNOWN_MODULE 
- * @return     SPI_UNKNOWN_MODULE 
+ * @return     SPI_OK
  * @return     SPI_BAD_DATA_FORMAT
+ * @return     SPI_BUSY
+ * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget)
+ *
+ * @info In ENHANCED_BUFFER mode, the Tx FIFO is kept full while the Rx FIFO is 
+ *       drained, so that frames are sent back-to-back (no idle SCK between frames)
  *
  * @attention : The CS line must be asserted by the user before calling this 
  *              function, and deasserted once the tranfert is fully completed
@@ -159,6 +882,36 @@ spi_err_t   spi_transfer_raw_word(spi_desc_t *pSpi, uint16_t TxData, uint16_t *p
 spi_err_t   spi_transfer_raw_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len);
 spi_err_t   spi_transfer_raw_words(spi_desc_t *pSpi, const uint16_t *pTxData, uint16_t *pRxData, size_t len);
 
+/**
+ * @brief   Byte stream transfer with 2 bytes per SPIxBUF access
+ *
+ * Same as spi_transfer_raw_bytes (the module must be in BITS8 format), the 
+ * bytes being sent in the same order on the bus. The even part of the buffer 
+ * is transferred with MODE16 set, each frame being built / split MSB first 
+ * (pTxData[2n] << 8 | pTxData[2n+1]), which halves the per-frame overhead. 
+ * An odd tail byte is transferred in 8 bits mode. MODE16 is written once the 
+ * frames in flight are received, the module being disabled for the write 
+ * (SPIEN toggle with the CS line held asserted : the SCK port latch must hold 
+ * the CKP idle level). The data format is restored on exit.
+ * 
+ * Transfers shorter than SPI_PACKED_MIN_LEN are sent in 8 bits mode (no 
+ * MODE16 change), DMA transfers are left to the DMA engine.
+ * 
+ * @param[in]  pSpi     Address of the Spi module descriptor
+ * @param[in]  pTxData  Address of Data to Tx or NULL (0xFF is sent)
+ * @param[out] pRxData  Address of the location to store the Rx data or NULL
+ * @param[in]  len      number of bytes to transfer 
+ * 
+ * @return     SPI_OK
+ * @return     SPI_BAD_DATA_FORMAT
+ * @return     SPI_BUSY
+ * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget)
+ * 
+ * @attention : Only for slaves that do not care about the frame boundaries 
+ *              (no 8 bits framing, no per byte CS).
+ */
+spi_err_t   spi_transfer_packed_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len);
+
 /**
  * @brief   Transfer one byte to/from a given register address
  *
@@ -174,8 +927,9 @@ spi_err_t   spi_transfer_raw_words(spi_desc_t *pSpi, const uint16_t *pTxData, ui
  * @param[out]   pdataIn Address of the location of the read data or NULL 
  * 
  * @return     SPI_OK
- * @return     SPI_UNKNOWN_MODULE 
  * @return     SPI_BAD_DATA_FORMAT
+ * @return     SPI_BUSY
+ * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget)
  */
 spi_err_t   spi_transfer_byte_reg(spi_desc_t *pSpi, uint8_t reg, uint8_t dataOut, uint8_t *pdataIn);
 spi_err_t   spi_transfer_word_reg(spi_desc_t *pSpi, uint16_t reg, uint16_t dataOut, uint16_t *pdataIn);
@@ -196,12 +950,455 @@ spi_err_t   spi_transfer_word_reg(spi_desc_t *pSpi, uint16_t reg, uint16_t dataO
  * @param[in]   len     number of bytes to transfer
  *
  * @return     SPI_OK
- * @return     SPI_UNKNOWN_MODULE 
  * @return     SPI_BAD_DATA_FORMAT
+ * @return     SPI_BUSY
+ * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget)
  */
 spi_err_t   spi_transfer_byte_regs(spi_desc_t *pSpi, uint8_t reg, const uint8_t *out, uint8_t *in, size_t len);
 spi_err_t   spi_transfer_word_regs(spi_desc_t *pSpi, uint16_t reg, const uint16_t *out, uint16_t *in, size_t len);
 
+/**
+ * @brief   Transfers a list of segments as one sequence
+ *
+ * The segments are sent straight from / received straight into their own 
+ * buffers. The Tx side runs ahead of the Rx side across the segment 
+ * boundaries, so that consecutive segments of the same width are sent 
+ * without any gap on the bus (back-to-back frames in ENHANCED_BUFFER mode).
+ * When a segment needs another width, the frames in flight are completed, 
+ * then MODE16 is changed (module disabled for the write, see 
+ * spi_transfer_packed_bytes). The data format in use before the call is 
+ * restored on exit.
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[in]   pSeg    Array of segments
+ * @param[in]   nbSeg   number of segments
+ *
+ * @return     SPI_OK
+ * @return     SPI_BAD_DATA_FORMAT  width of a segment is not 0, 8 or 16 (nothing transferred)
+ * @return     SPI_BUSY
+ * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget)
+ * 
+ * @attention : The CS line must be asserted by the user before calling this 
+ *              function (see spi_device_transaction).
+ */
+spi_err_t   spi_transfer_segments(spi_desc_t *pSpi, const spi_segment_t *pSeg, size_t nbSeg);
+
+/**
+ * @brief   Reads a register block from several devices, back to back
+ *
+ * Each job is one CS window : address byte, then len bytes read (0xFF 
+ * sent). The jobs are run without any per job call or check : as soon as 
+ * the last frame of a job is received its CS is released, the CS of the 
+ * next job asserted and its address byte written. The data are stored as a 
+ * structure of arrays : byte k of job j goes to pRx[j + k * stride] (ex : 
+ * stride = nbJobs, pRx[k * nbJobs ...] holds byte k of every device).
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor (BITS8)
+ * @param[in]   pJobs   Array of jobs
+ * @param[in]   nbJobs  number of jobs
+ * @param[out]  pRx     Structure of arrays of the data read
+ * @param[in]   stride  Distance between byte k and byte k+1 of a job (>= nbJobs)
+ *
+ * @return     SPI_OK
+ * @return     SPI_BAD_DATA_FORMAT
+ * @return     SPI_BUSY
+ * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget) : the CS 
+ *             of the failing job is released, the next jobs are not run
+ */
+spi_err_t   spi_transfer_reg_batch(spi_desc_t *pSpi, const spi_reg_job_t *pJobs, size_t nbJobs, uint8_t *pRx, size_t stride);
+
+/**
+ * @brief   Initializes the running CRCs of a transfer (txCrc = rxCrc = seed)
+ *
+ * @param[out]  pCrc    CRCs to initialize
+ * @param[in]   type    SPI_CRC7, SPI_CRC8 or SPI_CRC16
+ * @param[in]   seed    Initial value (0 for SD cards, CRC7 left aligned)
+ */
+void    spi_crc_init(spi_crc_t *pCrc, spiCrcType_t type, uint16_t seed);
+
+/**
+ * @brief   Software CRC of a buffer (ex : SD command built before being sent)
+ *
+ * @param[in]   type    SPI_CRC7, SPI_CRC8 or SPI_CRC16
+ * @param[in]   crc     Initial value (or result of a previous call)
+ * @param[in]   pData   Data
+ * @param[in]   len     number of bytes
+ * 
+ * @return  CRC (CRC7 left aligned)
+ */
+uint16_t    spi_crc_compute(spiCrcType_t type, uint16_t crc, const uint8_t *pData, size_t len);
+
+/**
+ * @brief   spi_transfer_raw_bytes computing the CRCs while the frames are 
+ *          shifted
+ *
+ * The table driven CRC of each frame is updated while the next frame is on 
+ * the bus (the Tx CRC of a frame while it is shifted, its Rx CRC while the 
+ * following one is shifted) : no second pass over the buffers. pCrc->txCrc 
+ * is updated over pTxData (not over the 0xFF sent when pTxData is NULL), 
+ * pCrc->rxCrc over the received data, so that a long payload may be split 
+ * in several calls. 
+ * With SPI_CRC_SEND and/or SPI_CRC_CHECK, the CRC frames (1 byte, or 2 
+ * bytes MSB first for SPI_CRC16, bit 0 set for SPI_CRC7) are transferred 
+ * after the data : the Tx CRC is sent (SPI_CRC_SEND, 0xFF otherwise) and 
+ * the received one is compared with pCrc->rxCrc (SPI_CRC_CHECK). pCrc is 
+ * not updated over the CRC frames.
+ * 
+ * In ENHANCED_BUFFER mode 2 frames are kept in flight (back-to-back frames 
+ * as long as a CRC update is shorter than a frame). The transfer is always 
+ * done by the CPU (SPI_XFER_DMA ignored). The hardware CRC module, where 
+ * present, is not used : it can not follow the Tx and Rx streams at once.
+ * 
+ * @param[in]       pSpi        Address of the Spi module descriptor
+ * @param[in]       pTxData     Address of Data to Tx or NULL (0xFF is sent)
+ * @param[out]      pRxData     Address of the location to store the Rx data or NULL
+ * @param[in]       len         number of bytes to transfer 
+ * @param[in,out]   pCrc        Running CRCs (see spi_crc_init)
+ * @param[in]       options     0, SPI_CRC_SEND and/or SPI_CRC_CHECK
+ * 
+ * @return     SPI_OK
+ * @return     SPI_BAD_DATA_FORMAT
+ * @return     SPI_BUSY
+ * @return     SPI_TIMEOUT, SPI_OVERRUN (see spi_set_spin_budget)
+ * @return     SPI_CRC_ERROR    the received CRC does not match pCrc->rxCrc
+ */
+spi_err_t   spi_transfer_crc_bytes(spi_desc_t *pSpi, const uint8_t *pTxData, uint8_t *pRxData, size_t len, spi_crc_t *pCrc, uint8_t options);
+
+/**
+ * @brief   Selects how the data are moved between the memory and SPIxBUF
+ *
+ * In SPI_XFER_DMA mode, spi_transfer_raw_bytes/words and spi_transfer_async 
+ * hand the caller's buffers straight to the DMA channels of the module (no 
+ * intermediate copy). For Rx only transfers (pTxData == NULL) a constant 
+ * dummy source is used, and for Tx only transfers (pRxData == NULL) the 
+ * received data are discarded into a sink. Transfers shorter than 
+ * SPI_DMA_MIN_LEN are still handled by the CPU.
+ * 
+ * In SPI_XFER_IDLE mode, spi_transfer_raw_byte(s)/word(s) (and the *_reg(s) 
+ * calls built on them) send one frame at a time and put the core into Idle 
+ * while it is shifted, SPIxIF waking it up. The CPU priority is raised to 
+ * SPI_IT_PRIORITY while each frame is shifted, so the SPIx ISR is not run and 
+ * the interrupts of priority <= SPI_IT_PRIORITY are held for one frame at 
+ * most (served between frames).
+ * The cutover is made from the prescalers (master mode only) : when a frame 
+ * lasts less than SPI_IDLE_MIN_CYCLES instruction cycles (8 or 16 x PPRE x 
+ * SPRE) the wake-up latency would exceed the time saved, and the transfers 
+ * are polled as in SPI_XFER_CPU mode. The cutover is updated by 
+ * spi_reconfigure.
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[in]   mode    SPI_XFER_CPU, SPI_XFER_DMA or SPI_XFER_IDLE
+ *
+ * @return     SPI_OK
+ * @return     SPI_ERROR    SPI_XFER_DMA requested while SPI_USE_DMA is 0
+ * @return     SPI_BUSY 
+ * 
+ * @attention : In SPI_XFER_DMA mode, the buffers must be located in RAM 
+ *              between SPI_DMA_RAM_LOW and SPI_DMA_RAM_HIGH (no const data 
+ *              in program space)
+ */
+spi_err_t   spi_set_transfer_mode(spi_desc_t *pSpi, spiTransferMode_t mode);
+
+#if SPI_USE_ASYNC
+/**
+ * @brief   Starts a non blocking transfer of len frames (bytes or words 
+ *          according to the data format of the descriptor)
+ *
+ * The transfer is carried out by the SPIx interrupt. The function returns as 
+ * soon as the first frame(s) are loaded.
+ * 
+ * @param[in]   pSpi        Address of the Spi module descriptor
+ * @param[in]   pTxData     uint8_t or uint16_t buffer to send, or NULL (0xFF / 0xFFFF is sent)
+ * @param[out]  pRxData     uint8_t or uint16_t buffer to read into, or NULL
+ * @param[in]   len         number of frames to transfer
+ * @param[in]   pfCallback  completion callback (called from the ISR) or NULL
+ * @param[in]   pCtx        user context given back to the callback
+ *
+ * @return     SPI_OK
+ * @return     SPI_BUSY     an asynchronous transfer is already in progress
+ * 
+ * @attention : Buffers must remain valid until the transfer is completed. 
+ *              While the transfer is in progress, the blocking functions 
+ *              return SPI_BUSY.
+ */
+spi_err_t   spi_transfer_async(spi_desc_t *pSpi, const void *pTxData, void *pRxData, size_t len, spi_callback_t pfCallback, void *pCtx);
+
+/**
+ * @brief   Returns the status of the last asynchronous transfer 
+ *
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * 
+ * @return     SPI_ASYNC_IDLE, SPI_ASYNC_BUSY, SPI_ASYNC_DONE or SPI_ASYNC_CANCELLED
+ */
+spi_async_status_t  spi_async_status(spi_desc_t *pSpi);
+
+/**
+ * @brief   Cancels the asynchronous transfer in progress (if any)
+ * 
+ * The frames already loaded in the module are completed (and discarded), then
+ * the module is released. The completion callback is NOT called.
+ *
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * 
+ * @return     SPI_OK
+ * @return     SPI_TIMEOUT  the frames in flight did not complete (module reset)
+ */
+spi_err_t   spi_async_cancel(spi_desc_t *pSpi);
+#endif
+
+#if SPI_USE_STREAM
+/**
+ * @brief   Starts a continuous acquisition into a ring of buffers
+ *
+ * The SPIx interrupt sends the command frame again and again and stores the 
+ * received frames (bytes or words according to the data format) into the 
+ * slots of pBuffers, one after the other. When a slot is full, pfCallback is 
+ * called with its address and the next slot is filled immediately. 
+ * If the next slot is still owned by the application, the next block is 
+ * sampled but discarded (overflow counter incremented), so that the blocks 
+ * stay aligned on the sampling sequence.
+ * 
+ * Without per frame CS, in ENHANCED_BUFFER mode, up to SPI_FIFO_DEPTH frames 
+ * are kept in flight : the bus runs back-to-back as long as the interrupt 
+ * latency stays below 8 frames. With a per frame CS (or in STANDARD_BUFFER 
+ * mode), one frame is sent per interrupt.
+ * 
+ * @param[in]   pSpi        Address of the Spi module descriptor
+ * @param[out]  pBuffers    nbSlots * slotLen frames (uint8_t or uint16_t)
+ * @param[in]   nbSlots     2..SPI_STREAM_MAX_SLOTS
+ * @param[in]   slotLen     frames per slot
+ * @param[in]   command     frame sent to get each sample
+ * @param[in]   pCs         Chip Select asserted / released around each frame, or NULL
+ * @param[in]   pfCallback  buffer full callback (called from the ISR)
+ * @param[in]   pCtx        user context given back to the callback
+ *
+ * @return     SPI_OK
+ * @return     SPI_BUSY     an asynchronous transfer / stream is in progress
+ * @return     SPI_ERROR    bad nbSlots / slotLen, or pfCallback is NULL
+ * 
+ * @attention : The blocking functions return SPI_BUSY until spi_stream_stop.
+ */
+spi_err_t   spi_stream_start(spi_desc_t *pSpi, void *pBuffers, uint8_t nbSlots, size_t slotLen, uint16_t command, 
+                             const spi_cs_t *pCs, spi_stream_callback_t pfCallback, void *pCtx);
+
+/**
+ * @brief   Gives a stream buffer back to the library
+ *
+ * @param[in]   pSpi        Address of the Spi module descriptor
+ * @param[in]   pBuffer     Address received by the stream callback
+ * 
+ * @return     SPI_OK
+ * @return     SPI_ERROR    pBuffer is not a slot of the stream
+ */
+spi_err_t   spi_stream_release(spi_desc_t *pSpi, void *pBuffer);
+
+/**
+ * @brief   Stops the stream (frames in flight completed and discarded)
+ *
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * 
+ * @return     SPI_OK
+ * @return     SPI_TIMEOUT  (see spi_async_cancel)
+ */
+spi_err_t   spi_stream_stop(spi_desc_t *pSpi);
+
+/**
+ * @brief   Returns the number of blocks discarded since spi_stream_start
+ *          (modulo 65536)
+ *
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ */
+uint16_t    spi_stream_overflows(spi_desc_t *pSpi);
+#endif
+
+#if SPI_USE_SLAVE
+/**
+ * @brief   Initializes a frame ring (see spi_ring_t)
+ *
+ * @param[out]  pRing   Ring to initialize
+ * @param[in]   pBuf    size frames (uint8_t or uint16_t according to format)
+ * @param[in]   size    number of frames : power of 2, 2..32768
+ * @param[in]   format  BITS8 or BITS16 (data format of the module)
+ * 
+ * @return     SPI_OK
+ * @return     SPI_ERROR    bad size
+ */
+spi_err_t   spi_ring_init(spi_ring_t *pRing, void *pBuf, uint16_t size, spiDataFormat_t format);
+
+/**
+ * @brief   Number of frames waiting in a ring
+ *
+ * @param[in]   pRing   Ring
+ */
+uint16_t    spi_ring_count(const spi_ring_t *pRing);
+
+/**
+ * @brief   Copies frames into / out of a ring (never blocks)
+ *
+ * @param[in]   pRing   Ring
+ * @param[in]   pData   uint8_t or uint16_t buffer (format of the ring)
+ * @param[in]   len     number of frames
+ * 
+ * @return     number of frames actually copied
+ */
+uint16_t    spi_ring_write(spi_ring_t *pRing, const void *pData, uint16_t len);
+uint16_t    spi_ring_read(spi_ring_t *pRing, void *pData, uint16_t len);
+
+/**
+ * @brief   Starts the slave engine of a module initialized in slave mode
+ *
+ * The SPIx interrupt stores the received frames into pRxRing and keeps the 
+ * Tx buffer / FIFO loaded from pTxRing, so that the next frame is always 
+ * ready before the master clocks it. When pTxRing is empty, fill is loaded 
+ * instead (underrun). When pRxRing is full the received frame is discarded 
+ * (overrun, as a SPIROV found set).
+ * The application reads pRxRing / writes pTxRing with spi_ring_read / 
+ * spi_ring_write while the engine runs.
+ * 
+ * A frame written to pTxRing is sent after the frames already loaded : up to 
+ * SPI_FIFO_DEPTH + 1 frames in ENHANCED_BUFFER mode, 2 in STANDARD_BUFFER mode
+ * (shift register included).
+ * 
+ * @param[in]   pSpi        Address of the Spi module descriptor
+ * @param[in]   pRxRing     Received frames, or NULL (discarded)
+ * @param[in]   pTxRing     Frames to send, or NULL (fill is always sent)
+ * @param[in]   fill        Frame sent when pTxRing is empty
+ *
+ * @return     SPI_OK
+ * @return     SPI_BUSY             an asynchronous transfer / stream is in progress
+ * @return     SPI_ERROR            the module is in master mode
+ * @return     SPI_BAD_DATA_FORMAT  the format of a ring is not the one of the module
+ * 
+ * @attention : The blocking functions return SPI_BUSY until spi_slave_stop.
+ */
+spi_err_t   spi_slave_start(spi_desc_t *pSpi, spi_ring_t *pRxRing, spi_ring_t *pTxRing, uint16_t fill);
+
+/**
+ * @brief   Stops the slave engine (module reset : frames loaded discarded)
+ *
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * 
+ * @return     SPI_OK
+ */
+spi_err_t   spi_slave_stop(spi_desc_t *pSpi);
+
+/**
+ * @brief   Returns the underrun / overrun counters of the slave engine since 
+ *          spi_slave_start (modulo 65536)
+ *
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ */
+uint16_t    spi_slave_underruns(spi_desc_t *pSpi);
+uint16_t    spi_slave_overruns(spi_desc_t *pSpi);
+#endif
+
+#if SPI_USE_SCRIPT
+/**
+ * @brief   Runs a script (array of steps ended by SPI_OP_END) from the SPIx ISR
+ *
+ * Ex : read 6 bytes from register 0x28 of 2 sensors
+ *      static const spi_script_op_t poll[] = {
+ *          SPI_SCRIPT_CS_ASSERT(&csA), SPI_SCRIPT_TX_LIT(0xA8), SPI_SCRIPT_RX_BUF(rxA, 6), SPI_SCRIPT_CS_RELEASE(&csA),
+ *          SPI_SCRIPT_CS_ASSERT(&csB), SPI_SCRIPT_TX_LIT(0xA8), SPI_SCRIPT_RX_BUF(rxB, 6), SPI_SCRIPT_CS_RELEASE(&csB),
+ *          SPI_SCRIPT_END() };
+ * 
+ * The steps are chained by the interrupt, without any CPU work outside the 
+ * ISR : the frames of consecutive frame steps are sent back-to-back (up to 
+ * SPI_FIFO_DEPTH frames in flight in ENHANCED_BUFFER mode), the CS and 
+ * callback steps being run as soon as the frames before them are received.
+ * The function may be called from a periodic timer ISR to re-trigger the 
+ * script (SPI_BUSY : the previous run is not completed).
+ * 
+ * @param[in]   pSpi            Address of the Spi module descriptor
+ * @param[in]   pScript         Steps of the script
+ * @param[in]   pfScriptCallback  SPI_OP_CALLBACK steps callback, or NULL
+ * @param[in]   pfCallback      completion callback (SPI_OK or SPI_OVERRUN), or NULL
+ * @param[in]   pCtx            user context given back to the callbacks
+ *
+ * @return     SPI_OK
+ * @return     SPI_BUSY     an asynchronous transfer / stream / script is in progress
+ * 
+ * @attention : The script and its buffers must remain valid until the run 
+ *              is completed (see spi_async_status). spi_async_cancel leaves 
+ *              the CS lines as they are. 
+ *              A timer ISR re-triggering the script must not have a higher 
+ *              priority than SPI_IT_PRIORITY.
+ */
+spi_err_t   spi_script_start(spi_desc_t *pSpi, const spi_script_op_t *pScript, spi_script_callback_t pfScriptCallback,
+                             spi_callback_t pfCallback, void *pCtx);
+#endif
+
+#if SPI_USE_STATS
+/**
+ * @brief   Sets the timer used to measure the transaction durations
+ *
+ * @param[in]   pSpi        Address of the Spi module descriptor
+ * @param[in]   pfTimer     Timer read function, or NULL (no duration measured)
+ */
+void    spi_stats_set_timer(spi_desc_t *pSpi, spi_timer_t pfTimer);
+
+/**
+ * @brief   Copies the performance counters of a descriptor
+ *
+ * The counters are reset by spi_init / spi_init_regs.
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[out]  pStats  Copy of the counters (durAvg computed)
+ * @param[in]   reset   1 : the counters are cleared once copied
+ * 
+ * @info    The copy is done with the interrupts disabled (asynchronous 
+ *          transfers update the counters from the ISR)
+ */
+void    spi_stats_snapshot(spi_desc_t *pSpi, spi_stats_t *pStats, uint8_t reset);
+#endif
+
+#if SPI_USE_TRACE
+/**
+ * @brief   Sets the timer used to time stamp the trace records
+ *
+ * @param[in]   pfTimer     Timer read function, or NULL (time stamps are 0)
+ */
+void    spi_trace_set_timer(spi_timer_t pfTimer);
+
+/**
+ * @brief   Starts / stops the trace recorder (stopped after reset)
+ *
+ * @param[in]   on      1 : each transfer call of every module adds a record
+ */
+void    spi_trace_enable(uint8_t on);
+
+/**
+ * @brief   Sets the tag written in the next records of a descriptor
+ *
+ * The tag identifies the device (ex : its CS line) on a shared module, it 
+ * is 0 after spi_init / spi_init_regs.
+ * 
+ * @param[in]   pSpi    Address of the Spi module descriptor
+ * @param[in]   tag     User value
+ */
+void    spi_trace_tag(spi_desc_t *pSpi, uint8_t tag);
+
+/**
+ * @brief   Moves the oldest trace records out of the ring
+ *
+ * The ring holds SPI_TRACE_DEPTH records (256 max), the records of the 
+ * transactions made while it is full are lost (see spi_trace_lost). The records of the 
+ * asynchronous transfers are written by the ISRs : the drain may be done 
+ * from the main loop while transfers are running.
+ * 
+ * @param[out]  pRecs       Copy of the records, oldest first
+ * @param[in]   maxRecs     Size of pRecs
+ * 
+ * @return  Number of records copied
+ */
+uint16_t    spi_trace_drain(spi_trace_rec_t *pRecs, uint16_t maxRecs);
+
+/**
+ * @brief   Number of records lost because the ring was full (cleared by the call)
+ */
+uint16_t    spi_trace_lost(void);
+#endif
+
 
 #endif
 
@@ -0,0 +1,137 @@
+/**
+ * @file    lib_spi_pic24_ll_static.h
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Compile time bound SPI module (header only, lib_spi_pic24_ll)
+ *
+ * For the images using a single SPI module with a fixed configuration : the
+ * module and its SPIxCON1 / SPIxCON2 values are given at build time, and the
+ * transfer functions are static inline functions accessing SPIxBUF /
+ * SPIxSTAT directly. No descriptor, no format / module / error checks, no
+ * spin budget (a dead module hangs the call) ; the buffer mode test is
+ * resolved by the compiler, and the functions not called generate no code.
+ *
+ * Ex :
+ *  #define SPI_STATIC_MODULE   1
+ *  #define SPI_STATIC_CON1     SPI_CON1(CLK_IDLE_IS_LOW, ACTIVE_TO_IDLE_CPHASE, MID_SMP, BITS8, PRI_PRE_4, SEC_PRE_8)
+ *  #define SPI_STATIC_CON2     SPI_CON2(STANDARD_BUFFER)
+ *  #include "lib_spi_pic24_ll_static.h"
+ *
+ * The byte functions require a BITS8 SPI_STATIC_CON1, the word functions a
+ * BITS16 one. The generic API (lib_spi_pic24_ll.c) must not be used on the
+ * same module. The code size of both APIs is given by the map file
+ * (xc16-ld --report-mem), the cycles per byte by the benchmark (Benchmark).
+ *
+ */
+
+#ifndef	__LIB_SPI_PIC24_LL_STATIC_H__
+#define	__LIB_SPI_PIC24_LL_STATIC_H__
+#include "lib_spi_pic24_ll.h"  // Masks, SPI_CON1 / SPI_CON2 helpers
+
+#if !defined(SPI_STATIC_MODULE) || !defined(SPI_STATIC_CON1) || !defined(SPI_STATIC_CON2)
+#error "SPI_STATIC_MODULE (1, 2 or 3), SPI_STATIC_CON1 and SPI_STATIC_CON2 must be defined"
+#endif
+
+/* Directives de compilation - Macros		*/
+#define SPI_STATIC_REG_(n, reg)     SPI##n##reg
+#define SPI_STATIC_REG(n, reg)      SPI_STATIC_REG_(n, reg)
+#define SPI_STATIC_STAT             SPI_STATIC_REG(SPI_STATIC_MODULE, STAT)
+#define SPI_STATIC_CON1_REG         SPI_STATIC_REG(SPI_STATIC_MODULE, CON1)
+#define SPI_STATIC_CON2_REG         SPI_STATIC_REG(SPI_STATIC_MODULE, CON2)
+#define SPI_STATIC_BUF              SPI_STATIC_REG(SPI_STATIC_MODULE, BUF)
+
+/** 1 : Enhanced Buffer mode (constant, the tests are removed by the compiler) */
+#define SPI_STATIC_ENHANCED         (((SPI_STATIC_CON2) & SPIBEN_MASK) != 0)
+
+/**
+ * @brief   Configures and enables the module (SPI_STATIC_CON1 / SPI_STATIC_CON2)
+ */
+static inline void spi_static_init(void){
+    SPI_STATIC_STAT = 0x0000;
+    SPI_STATIC_CON1_REG = SPI_STATIC_CON1;
+    SPI_STATIC_CON2_REG = SPI_STATIC_CON2;
+    SPI_STATIC_STAT = SPIEN_MASK | (SPI_STATIC_ENHANCED?SISEL_RX_NOT_EMPTY:0);
+}
+
+/**
+ * @brief   Sends one frame and returns the frame received
+ */
+static inline uint8_t spi_static_byte(uint8_t txData){
+    SPI_STATIC_BUF = txData;
+    if (SPI_STATIC_ENHANCED) while (SPI_STATIC_STAT & SRXMPT_MASK);
+    else while (!(SPI_STATIC_STAT & SPIRBF_MASK));
+    return (uint8_t)SPI_STATIC_BUF;
+}
+
+static inline uint16_t spi_static_word(uint16_t txData){
+    SPI_STATIC_BUF = txData;
+    if (SPI_STATIC_ENHANCED) while (SPI_STATIC_STAT & SRXMPT_MASK);
+    else while (!(SPI_STATIC_STAT & SPIRBF_MASK));
+    return SPI_STATIC_BUF;
+}
+
+/**
+ * @brief   Transfers len frames
+ *
+ * @param[in]   pTxData     Address of Data to Tx or NULL (0xFF / 0xFFFF is sent)
+ * @param[out]  pRxData     Address of the location to store the Rx data or NULL
+ * @param[in]   len         Number of frames
+ *
+ * Enhanced Buffer mode : the Tx FIFO is kept full, no more than
+ * SPI_FIFO_DEPTH frames being in flight.
+ */
+static inline void spi_static_bytes(const uint8_t *pTxData, uint8_t *pRxData, size_t len){
+    size_t      txIdx = 0, rxIdx = 0;
+    uint8_t     data;
+
+    if (SPI_STATIC_ENHANCED){
+        while (rxIdx < len){
+            while ((txIdx < len) && ((txIdx - rxIdx) < SPI_FIFO_DEPTH) && !(SPI_STATIC_STAT & SPITBF_MASK)){
+                SPI_STATIC_BUF = (pTxData == NULL)?0xFF:pTxData[txIdx];
+                txIdx++;
+            }
+            while ((rxIdx < txIdx) && !(SPI_STATIC_STAT & SRXMPT_MASK)){
+                data = (uint8_t)SPI_STATIC_BUF;
+                if (pRxData != NULL) pRxData[rxIdx] = data;
+                rxIdx++;
+            }
+        }
+    }
+    else{
+        for (; rxIdx < len; rxIdx++){
+            SPI_STATIC_BUF = (pTxData == NULL)?0xFF:pTxData[rxIdx];
+            while (!(SPI_STATIC_STAT & SPIRBF_MASK));
+            data = (uint8_t)SPI_STATIC_BUF;
+            if (pRxData != NULL) pRxData[rxIdx] = data;
+        }
+    }
+}
+
+static inline void spi_static_words(const uint16_t *pTxData, uint16_t *pRxData, size_t len){
+    size_t      txIdx = 0, rxIdx = 0;
+    uint16_t    data;
+
+    if (SPI_STATIC_ENHANCED){
+        while (rxIdx < len){
+            while ((txIdx < len) && ((txIdx - rxIdx) < SPI_FIFO_DEPTH) && !(SPI_STATIC_STAT & SPITBF_MASK)){
+                SPI_STATIC_BUF = (pTxData == NULL)?0xFFFF:pTxData[txIdx];
+                txIdx++;
+            }
+            while ((rxIdx < txIdx) && !(SPI_STATIC_STAT & SRXMPT_MASK)){
+                data = SPI_STATIC_BUF;
+                if (pRxData != NULL) pRxData[rxIdx] = data;
+                rxIdx++;
+            }
+        }
+    }
+    else{
+        for (; rxIdx < len; rxIdx++){
+            SPI_STATIC_BUF = (pTxData == NULL)?0xFFFF:pTxData[rxIdx];
+            while (!(SPI_STATIC_STAT & SPIRBF_MASK));
+            data = SPI_STATIC_BUF;
+            if (pRxData != NULL) pRxData[rxIdx] = data;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file 	lib_spi_pic24_regmap.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Register map of a SPI slave with a shadow cache (lib_spi_pic24_ll)
+ *  
+ *
+ */
+
+#include "lib_spi_pic24_regmap.h"
+
+/*	Implementation du code */
+/**
+ * One bus access : address byte, then len data bytes 
+ */
+static spi_err_t   spi_regmap_access(spi_regmap_t *pMap, uint8_t addr, const uint8_t *pTx, uint8_t *pRx, uint8_t len){
+    spi_segment_t   seg[2] = {  {NULL, NULL, 1, 0, 8},
+                                {NULL, NULL, 0, 0xFF, 8}};
+    spi_transaction_t   trans = {seg, 2};
+    
+    seg[0].fill = addr;
+    seg[1].pTx = pTx;
+    seg[1].pRx = pRx;
+    seg[1].len = len;
+    return spi_device_transaction(pMap->pDev, &trans);
+}
+//------------------------------------------------------------------------------
+/**
+ * Writes pShadow[reg..reg+len-1] to the device 
+ */
+static spi_err_t   spi_regmap_write_run(spi_regmap_t *pMap, uint8_t reg, uint8_t len){
+    spi_err_t   res;
+    uint8_t i;
+    
+    if ((len > 1) && pMap->cfg.autoInc){
+        res = spi_regmap_access(pMap, reg | pMap->cfg.writeFlag | pMap->cfg.autoIncFlag, &pMap->pShadow[reg], NULL, len);
+        if (res != SPI_OK) return res;
+        for (i = 0; i < len; i++) pMap->pState[reg + i] &= ~SPI_REG_DIRTY;
+        return SPI_OK;
+    }
+    for (i = 0; i < len; i++){
+        res = spi_regmap_access(pMap, (reg + i) | pMap->cfg.writeFlag, &pMap->pShadow[reg + i], NULL, 1);
+        if (res != SPI_OK) return res;
+        pMap->pState[reg + i] &= ~SPI_REG_DIRTY;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_regmap_init(spi_regmap_t *pMap, spi_device_t *pDev, const spi_regmap_config_t *pCfg, 
+                            uint8_t nbRegs, uint8_t *pShadow, uint8_t *pState){
+    pMap->pDev = pDev;
+    pMap->cfg = *pCfg;
+    pMap->nbRegs = nbRegs;
+    pMap->pShadow = pShadow;
+    pMap->pState = pState;
+    spi_regmap_invalidate(pMap);
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_regmap_read(spi_regmap_t *pMap, uint8_t reg, uint8_t *pValue){
+    spi_err_t   res;
+    
+    if (reg >= pMap->nbRegs) return SPI_ERROR;
+    if (pMap->pState[reg] & SPI_REG_VALID){
+        *pValue = pMap->pShadow[reg];
+        return SPI_OK;
+    }
+    // Staged writes first (see spi_regmap_read_block)
+    res = spi_regmap_flush(pMap);
+    if (res != SPI_OK) return res;
+    res = spi_regmap_access(pMap, reg | pMap->cfg.readFlag, NULL, pValue, 1);
+    if (res != SPI_OK) return res;
+    if (!(pMap->pState[reg] & SPI_REG_VOLATILE)){
+        pMap->pShadow[reg] = *pValue;
+        pMap->pState[reg] |= SPI_REG_VALID;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_regmap_read_block(spi_regmap_t *pMap, uint8_t reg, uint8_t *pData, uint8_t len){
+    spi_err_t   res;
+    uint8_t i;
+    
+    if (((uint16_t)reg + len) > pMap->nbRegs) return SPI_ERROR;
+    if (len == 0) return SPI_OK;
+    // Staged writes first : the device must not be read before being written
+    res = spi_regmap_flush(pMap);
+    if (res != SPI_OK) return res;
+    
+    if (pMap->cfg.autoInc) res = spi_regmap_access(pMap, reg | pMap->cfg.readFlag | ((len > 1)?pMap->cfg.autoIncFlag:0), NULL, pData, len);
+    else{
+        for (i = 0; (i < len) && (res == SPI_OK); i++) res = spi_regmap_access(pMap, (reg + i) | pMap->cfg.readFlag, NULL, &pData[i], 1);
+    }
+    if (res != SPI_OK) return res;
+    
+    for (i = 0; i < len; i++){
+        if (pMap->pState[reg + i] & SPI_REG_VOLATILE) continue;
+        pMap->pShadow[reg + i] = pData[i];
+        pMap->pState[reg + i] |= SPI_REG_VALID;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_regmap_write(spi_regmap_t *pMap, uint8_t reg, uint8_t value){
+    spi_err_t   res;
+    
+    if (reg >= pMap->nbRegs) return SPI_ERROR;
+    if (pMap->pState[reg] & SPI_REG_VOLATILE){
+        // Sent after the staged writes, in program order
+        res = spi_regmap_flush(pMap);
+        if (res != SPI_OK) return res;
+        return spi_regmap_access(pMap, reg | pMap->cfg.writeFlag, &value, NULL, 1);
+    }
+    
+    if ((pMap->pState[reg] & SPI_REG_VALID) && (pMap->pShadow[reg] == value)) return SPI_OK;
+    pMap->pShadow[reg] = value;
+    pMap->pState[reg] |= SPI_REG_VALID | SPI_REG_DIRTY;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_regmap_update_bits(spi_regmap_t *pMap, uint8_t reg, uint8_t mask, uint8_t value){
+    spi_err_t   res;
+    uint8_t     current;
+#if SPI_USE_BUS
+    spi_device_t    *pDev = pMap->pDev;
+    uint8_t     taken = 0;
+    
+    // Volatile register : the bus is kept from the read to the write, so 
+    // that no other user of the module accesses the device in between
+    if ((reg < pMap->nbRegs) && (pMap->pState[reg] & SPI_REG_VOLATILE) && (spi_bus_owner(pDev->pSpi) != pDev)){
+        res = spi_bus_acquire(pDev->pSpi, pDev, pDev->prio, NULL, NULL);
+        if (res != SPI_OK) return res;
+        taken = 1;
+    }
+#endif
+    
+    res = spi_regmap_read(pMap, reg, &current);
+    if (res == SPI_OK) res = spi_regmap_write(pMap, reg, (current & ~mask) | (value & mask));
+#if SPI_USE_BUS
+    if (taken) spi_bus_release(pDev->pSpi, pDev);
+#endif
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_regmap_flush(spi_regmap_t *pMap){
+    spi_err_t   res;
+    uint8_t first, last;
+    
+    first = 0;
+    while (first < pMap->nbRegs){
+        if (!(pMap->pState[first] & SPI_REG_DIRTY)){
+            first++;
+            continue;
+        }
+        // Run of adjacent dirty registers
+        last = first + 1;
+        while ((last < pMap->nbRegs) && (pMap->pState[last] & SPI_REG_DIRTY)) last++;
+        res = spi_regmap_write_run(pMap, first, last - first);
+        if (res != SPI_OK) return res;
+        first = last;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+void    spi_regmap_invalidate(spi_regmap_t *pMap){
+    uint8_t i;
+    
+    for (i = 0; i < pMap->nbRegs; i++) pMap->pState[i] &= SPI_REG_VOLATILE;
+}
+//------------------------------------------------------------------------------
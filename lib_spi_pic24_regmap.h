@@ -0,0 +1,140 @@
+/**
+ * @file    lib_spi_pic24_regmap.h 
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Register map of a SPI slave with a shadow cache (lib_spi_pic24_ll)
+ *  
+ * 8 bits registers accessed as : address byte (+ read / write / auto-increment 
+ * flags), then data byte(s). Reads of non volatile registers are served by 
+ * the shadow copy, writes are staged in the shadow copy and sent by 
+ * spi_regmap_flush, adjacent dirty registers being merged into a single 
+ * auto-increment burst.
+ *
+ */
+
+#ifndef	__LIB_SPI_PIC24_REGMAP_H__
+#define	__LIB_SPI_PIC24_REGMAP_H__
+#include "lib_spi_pic24_bus.h"
+
+// Register attributes / state (one byte per register, see spi_regmap_t.pState)
+#define SPI_REG_VOLATILE    (0x01 << 0)     /**< Set by the user : never cached, written immediately */
+#define SPI_REG_VALID       (0x01 << 1)     /**< Shadow value is up to date */
+#define SPI_REG_DIRTY       (0x01 << 2)     /**< Shadow value not written yet */
+
+/** Type spi_regmap_config_t
+ * 
+ * Address conventions of the device
+ * Ex : ST IMU     : {0x80, 0x00, 0x00, 1} (auto-increment by IF_INC bit)
+ *      Bosch IMU  : {0x80, 0x00, 0x00, 1}
+ *      ADXL345    : {0x80, 0x00, 0x40, 1} (MB bit)
+ */
+typedef struct {
+    uint8_t readFlag;       /**< OR-ed to the address of reads (ex : 0x80) */
+    uint8_t writeFlag;      /**< OR-ed to the address of writes (ex : 0x00) */
+    uint8_t autoIncFlag;    /**< OR-ed to the address of multi registers accesses (0 if none) */
+    uint8_t autoInc;        /**< 1 : the device increments the address during bursts */
+    } spi_regmap_config_t;
+
+/** Type spi_regmap_t
+ * 
+ * 
+ */
+typedef struct {
+    spi_device_t    *pDev;          /**< Device (BITS8 configuration) */
+    spi_regmap_config_t cfg;
+    uint8_t         nbRegs;         /**< Registers 0..nbRegs-1 */
+    uint8_t         *pShadow;       /**< nbRegs bytes */
+    uint8_t         *pState;        /**< nbRegs bytes : SPI_REG_xxx */
+    } spi_regmap_t;
+
+/**
+ * @brief   Initialize a register map (cache empty)
+ * 
+ * @param[out]  pMap    Register map
+ * @param[in]   pDev    Device handle (already initialized, BITS8 configuration)
+ * @param[in]   pCfg    Address conventions of the device (copied)
+ * @param[in]   nbRegs  number of registers
+ * @param[in]   pShadow nbRegs bytes (shadow copy)
+ * @param[in,out] pState  nbRegs bytes : SPI_REG_VOLATILE set by the user for 
+ *                      the registers that must not be cached (status, data...)
+ * 
+ * @return  SPI_OK
+ */
+spi_err_t   spi_regmap_init(spi_regmap_t *pMap, spi_device_t *pDev, const spi_regmap_config_t *pCfg, 
+                            uint8_t nbRegs, uint8_t *pShadow, uint8_t *pState);
+
+/**
+ * @brief   Reads one register (from the shadow copy when valid)
+ * 
+ * When the device is read (volatile or not cached register), the staged 
+ * writes are sent first, as for spi_regmap_read_block.
+ * 
+ * @param[in]   pMap    Register map
+ * @param[in]   reg     Register address
+ * @param[out]  pValue  Register value
+ * 
+ * @return  SPI_OK
+ * @return  SPI_ERROR   reg out of the map
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_regmap_read(spi_regmap_t *pMap, uint8_t reg, uint8_t *pValue);
+
+/**
+ * @brief   Reads len consecutive registers from the device in one burst 
+ *          (shadow copy updated for the cacheable ones)
+ * 
+ * @return  SPI_OK
+ * @return  SPI_ERROR   registers out of the map
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_regmap_read_block(spi_regmap_t *pMap, uint8_t reg, uint8_t *pData, uint8_t len);
+
+/**
+ * @brief   Writes one register
+ * 
+ * Cacheable register : the value is staged (sent by spi_regmap_flush), 
+ * nothing is done if the cached value is already the same.
+ * Volatile register : written immediately, after the staged writes.
+ * 
+ * @return  SPI_OK
+ * @return  SPI_ERROR   reg out of the map
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_regmap_write(spi_regmap_t *pMap, uint8_t reg, uint8_t value);
+
+/**
+ * @brief   Read-modify-write : reg = (reg & ~mask) | (value & mask)
+ * 
+ * The read is served by the shadow copy when valid : the update then costs 
+ * at most one write (staged, see spi_regmap_write).
+ * A volatile register costs 2 transactions : the read, then the write, the 
+ * CS line being released in between (the address byte of a command is the 
+ * first frame of a CS window). When SPI_USE_BUS is 1, the bus is held from 
+ * the read to the write (acquired for the device if not owned already) : 
+ * no other user of the module accesses the device in between.
+ * 
+ * @return  SPI_OK
+ * @return  SPI_ERROR   reg out of the map
+ * @return  SPI_BUSY    bus owned by another user (SPI_USE_BUS)
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_regmap_update_bits(spi_regmap_t *pMap, uint8_t reg, uint8_t mask, uint8_t value);
+
+/**
+ * @brief   Sends the staged writes
+ * 
+ * Runs of adjacent dirty registers are sent as one auto-increment burst 
+ * (one transaction per register if the device has no auto-increment).
+ * 
+ * @return  SPI_OK
+ * @return  errors of spi_device_transaction (the registers not sent stay dirty)
+ */
+spi_err_t   spi_regmap_flush(spi_regmap_t *pMap);
+
+/**
+ * @brief   Forgets the cached values (ex : after a device reset). The staged 
+ *          writes are dropped.
+ */
+void    spi_regmap_invalidate(spi_regmap_t *pMap);
+
+#endif
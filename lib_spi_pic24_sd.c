@@ -0,0 +1,400 @@
+/**
+ * @file 	lib_spi_pic24_sd.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	SD card in SPI mode with a block cache (lib_spi_pic24_ll)
+ *
+ *
+ */
+
+#include <string.h>
+#include "lib_spi_pic24_sd.h"
+
+/* Directives de compilation - Macros		*/
+#define SPI_SD_CMD0         0       /**< GO_IDLE_STATE */
+#define SPI_SD_CMD8         8       /**< SEND_IF_COND */
+#define SPI_SD_CMD12        12      /**< STOP_TRANSMISSION */
+#define SPI_SD_CMD16        16      /**< SET_BLOCKLEN */
+#define SPI_SD_CMD17        17      /**< READ_SINGLE_BLOCK */
+#define SPI_SD_CMD18        18      /**< READ_MULTIPLE_BLOCK */
+#define SPI_SD_CMD24        24      /**< WRITE_BLOCK */
+#define SPI_SD_CMD25        25      /**< WRITE_MULTIPLE_BLOCK */
+#define SPI_SD_CMD55        55      /**< APP_CMD */
+#define SPI_SD_CMD58        58      /**< READ_OCR */
+#define SPI_SD_ACMD41       41      /**< SD_SEND_OP_COND */
+
+#define SPI_SD_R1_IDLE      0x01
+#define SPI_SD_R1_ILLEGAL   0x04
+#define SPI_SD_TOKEN        0xFE    /**< Start block token (CMD17 / CMD18 / CMD24) */
+#define SPI_SD_TOKEN_MULTI  0xFC    /**< Start block token (CMD25) */
+#define SPI_SD_TOKEN_STOP   0xFD    /**< Stop transmission token (CMD25) */
+#define SPI_SD_DATA_ACCEPTED    0x05
+#define SPI_SD_NO_BLOCK     0xFFFFFFFFUL
+
+/*	Implementation du code */
+/**
+ * CS callback of the power-up clocks : the CS line of the card stays high
+ */
+static void spi_sd_no_cs(uint8_t assert, void *pCtx){
+    (void)assert;
+    (void)pCtx;
+}
+//------------------------------------------------------------------------------
+/**
+ * One byte (0xFF sent) into *pData, CS asserted by the caller
+ */
+static spi_err_t   spi_sd_byte(spi_sd_t *pSd, uint8_t *pData){
+    *pData = 0xFF;
+    return spi_transfer_raw_bytes(pSd->pDev->pSpi, NULL, pData, 1);
+}
+//------------------------------------------------------------------------------
+/**
+ * Command frame, then R1 (up to 8 bytes of NCR) and len more bytes of the
+ * response. CS asserted by the caller.
+ */
+static spi_err_t   spi_sd_cmd(spi_sd_t *pSd, uint8_t cmd, uint32_t arg, uint8_t *pR1, uint8_t *pResp, uint8_t len){
+    uint8_t     frame[6];
+    uint8_t     i;
+    spi_err_t   res;
+
+    frame[0] = 0x40 | cmd;
+    frame[1] = (uint8_t)(arg >> 24);
+    frame[2] = (uint8_t)(arg >> 16);
+    frame[3] = (uint8_t)(arg >> 8);
+    frame[4] = (uint8_t)arg;
+    // CRC only checked in SPI mode for CMD0 and CMD8 (fixed arguments)
+    frame[5] = (cmd == SPI_SD_CMD0)?0x95:((cmd == SPI_SD_CMD8)?0x87:0x01);
+    res = spi_transfer_raw_bytes(pSd->pDev->pSpi, frame, NULL, 6);
+    if (res != SPI_OK) return res;
+    if (cmd == SPI_SD_CMD12){
+        res = spi_sd_byte(pSd, pR1);    // Stuff byte
+        if (res != SPI_OK) return res;
+    }
+
+    for (i = 0; i < 8; i++){
+        res = spi_sd_byte(pSd, pR1);
+        if (res != SPI_OK) return res;
+        if (!(*pR1 & 0x80)) break;
+    }
+    if (i == 8) return SPI_ERROR;   // No card
+    if (len == 0) return SPI_OK;
+    return spi_transfer_raw_bytes(pSd->pDev->pSpi, NULL, pResp, len);
+}
+//------------------------------------------------------------------------------
+/**
+ * One command in its own CS window (initialization commands)
+ */
+static spi_err_t   spi_sd_command(spi_sd_t *pSd, uint8_t cmd, uint32_t arg, uint8_t *pR1, uint8_t *pResp, uint8_t len){
+    spi_err_t   res;
+
+    res = spi_device_select(pSd->pDev);
+    if (res != SPI_OK) return res;
+    res = spi_sd_cmd(pSd, cmd, arg, pR1, pResp, len);
+    spi_device_release(pSd->pDev);
+    return res;
+}
+//------------------------------------------------------------------------------
+/**
+ * Waits for the end of a R1b busy (MISO low), CS held by the caller
+ */
+static spi_err_t   spi_sd_ready(spi_sd_t *pSd){
+    spi_err_t   res;
+    uint8_t     data;
+    uint16_t    polls;
+
+    for (polls = 0; polls < SPI_SD_TOKEN_POLLS; polls++){
+        res = spi_sd_byte(pSd, &data);
+        if (res != SPI_OK) return res;
+        if (data == 0xFF) return SPI_OK;
+    }
+    return SPI_TIMEOUT;
+}
+//------------------------------------------------------------------------------
+/**
+ * Waits for the end of a block write : one byte read per poll (0x00 while
+ * busy), CS released between polls
+ */
+static spi_err_t   spi_sd_wait(spi_sd_t *pSd){
+    spi_err_t   res;
+    uint8_t     data;
+    uint32_t    polls = 0;
+
+    for (;;){
+        res = spi_device_select(pSd->pDev);
+        if (res != SPI_OK) return res;
+        res = spi_sd_byte(pSd, &data);
+        spi_device_release(pSd->pDev);
+        if (res != SPI_OK) return res;
+        if (data == 0xFF) return SPI_OK;
+        if ((pSd->maxPolls != 0) && (++polls >= pSd->maxPolls)) return SPI_TIMEOUT;
+        if (pSd->pfYield != NULL) pSd->pfYield(pSd->pYieldCtx);
+    }
+}
+//------------------------------------------------------------------------------
+static uint32_t spi_sd_arg(spi_sd_t *pSd, uint32_t block){
+    return pSd->blockAddr?block:(block * SPI_SD_BLOCK_SIZE);
+}
+//------------------------------------------------------------------------------
+/**
+ * Data block (token, 512 bytes, CRC), then data response. CS asserted by 
+ * the caller.
+ */
+static spi_err_t   spi_sd_send_block(spi_sd_t *pSd, uint8_t token, const uint8_t *pData){
+    uint8_t     head[2] = {0xFF, token};
+    spi_err_t   res;
+    uint8_t     resp;
+
+    res = spi_transfer_raw_bytes(pSd->pDev->pSpi, head, NULL, 2);
+    if (res == SPI_OK) res = spi_transfer_raw_bytes(pSd->pDev->pSpi, pData, NULL, SPI_SD_BLOCK_SIZE);
+    if (res == SPI_OK) res = spi_transfer_raw_bytes(pSd->pDev->pSpi, NULL, NULL, 2);     // CRC (not checked)
+    if (res == SPI_OK) res = spi_sd_byte(pSd, &resp);
+    if ((res == SPI_OK) && ((resp & 0x1F) != SPI_SD_DATA_ACCEPTED)) res = SPI_ERROR;
+    return res;
+}
+//------------------------------------------------------------------------------
+/**
+ * One block write (CMD24), then busy wait
+ */
+static spi_err_t   spi_sd_write_block(spi_sd_t *pSd, uint32_t block, const uint8_t *pData){
+    spi_err_t   res;
+    uint8_t     r1;
+
+    res = spi_device_select(pSd->pDev);
+    if (res != SPI_OK) return res;
+    res = spi_sd_cmd(pSd, SPI_SD_CMD24, spi_sd_arg(pSd, block), &r1, NULL, 0);
+    if ((res == SPI_OK) && (r1 != 0)) res = SPI_ERROR;
+    if (res == SPI_OK) res = spi_sd_send_block(pSd, SPI_SD_TOKEN, pData);
+    spi_device_release(pSd->pDev);
+    if (res != SPI_OK) return res;
+    return spi_sd_wait(pSd);
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_sd_init(spi_sd_t *pSd, spi_device_t *pDev, const spi_config_t *pFastCfg, void (*pfYield)(void *pCtx), void *pYieldCtx){
+    spi_device_t    noCs = *pDev;
+    spi_err_t   res;
+    uint8_t     r1, resp[4];
+    uint8_t     v2;
+    uint16_t    polls;
+
+    pSd->pDev = pDev;
+    pSd->pfYield = pfYield;
+    pSd->pYieldCtx = pYieldCtx;
+    pSd->maxPolls = 0;
+    pSd->blockAddr = 0;
+    pSd->cacheBlock = SPI_SD_NO_BLOCK;
+    pSd->cacheDirty = 0;
+
+    // At least 74 clocks with CS high : the card enters the SPI mode on CMD0
+    noCs.cs.pfSelect = spi_sd_no_cs;
+    res = spi_device_transfer_bytes(&noCs, NULL, NULL, 10);
+    if (res != SPI_OK) return res;
+    res = spi_sd_command(pSd, SPI_SD_CMD0, 0, &r1, NULL, 0);
+    if (res != SPI_OK) return res;
+    if (r1 != SPI_SD_R1_IDLE) return SPI_ERROR;
+
+    // Version 2 cards echo the check pattern, version 1 cards reject CMD8
+    res = spi_sd_command(pSd, SPI_SD_CMD8, 0x1AA, &r1, resp, 4);
+    if (res != SPI_OK) return res;
+    v2 = !(r1 & SPI_SD_R1_ILLEGAL);
+    if (v2 && (((resp[2] & 0x0F) != 0x01) || (resp[3] != 0xAA))) return SPI_ERROR;
+
+    for (polls = 0; ; polls++){
+        if (polls >= SPI_SD_INIT_POLLS) return SPI_TIMEOUT;
+        res = spi_sd_command(pSd, SPI_SD_CMD55, 0, &r1, NULL, 0);
+        if (res == SPI_OK) res = spi_sd_command(pSd, SPI_SD_ACMD41, v2?0x40000000UL:0, &r1, NULL, 0);
+        if (res != SPI_OK) return res;
+        if (r1 == 0) break;
+        if (r1 != SPI_SD_R1_IDLE) return SPI_ERROR;
+        if (pfYield != NULL) pfYield(pYieldCtx);
+    }
+
+    if (v2){
+        res = spi_sd_command(pSd, SPI_SD_CMD58, 0, &r1, resp, 4);
+        if (res != SPI_OK) return res;
+        pSd->blockAddr = (resp[0] & 0x40) != 0;    // CCS
+    }
+    if (!pSd->blockAddr){
+        res = spi_sd_command(pSd, SPI_SD_CMD16, SPI_SD_BLOCK_SIZE, &r1, NULL, 0);
+        if (res != SPI_OK) return res;
+        if (r1 != 0) return SPI_ERROR;
+    }
+
+    if (pFastCfg != NULL){
+        pDev->con1 = spi_config_con1(pFastCfg);
+        pDev->con2 = spi_config_con2(pFastCfg);
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_sd_read_blocks(spi_sd_t *pSd, uint32_t block, uint8_t *pData, uint16_t nbBlocks){
+    spi_err_t   res, stop;
+    uint8_t     r1 = 0xFF, token;
+    uint8_t     started;
+    uint16_t    i, polls;
+
+    if (nbBlocks == 0) return SPI_OK;
+    // Modified cached block first : the card must not be read before being written
+    if (pSd->cacheDirty && (pSd->cacheBlock >= block) && (pSd->cacheBlock < (block + nbBlocks))){
+        res = spi_sd_flush(pSd);
+        if (res != SPI_OK) return res;
+    }
+
+    res = spi_device_select(pSd->pDev);
+    if (res != SPI_OK) return res;
+    res = spi_sd_cmd(pSd, (nbBlocks > 1)?SPI_SD_CMD18:SPI_SD_CMD17, spi_sd_arg(pSd, block), &r1, NULL, 0);
+    if ((res == SPI_OK) && (r1 != 0)) res = SPI_ERROR;
+    started = (res == SPI_OK);     // Command accepted : a CMD18 read must be stopped
+    for (i = 0; (i < nbBlocks) && (res == SPI_OK); i++){
+        // Data token (CS held : the card drops the read when released)
+        for (polls = 0; polls < SPI_SD_TOKEN_POLLS; polls++){
+            res = spi_sd_byte(pSd, &token);
+            if ((res != SPI_OK) || (token != 0xFF)) break;
+        }
+        if (res != SPI_OK) break;
+        if (token != SPI_SD_TOKEN){
+            res = (token == 0xFF)?SPI_TIMEOUT:SPI_ERROR;
+            break;
+        }
+        res = spi_transfer_raw_bytes(pSd->pDev->pSpi, NULL, pData, SPI_SD_BLOCK_SIZE);
+        if (res == SPI_OK) res = spi_transfer_raw_bytes(pSd->pDev->pSpi, NULL, NULL, 2);     // CRC (not checked)
+        pData += SPI_SD_BLOCK_SIZE;
+    }
+    if ((nbBlocks > 1) && started){
+        stop = spi_sd_cmd(pSd, SPI_SD_CMD12, 0, &r1, NULL, 0);
+        if ((stop == SPI_OK) && (r1 != 0)) stop = SPI_ERROR;
+        if (stop == SPI_OK) stop = spi_sd_ready(pSd);
+        if (res == SPI_OK) res = stop;  // First error kept
+    }
+    spi_device_release(pSd->pDev);
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_sd_write_blocks(spi_sd_t *pSd, uint32_t block, const uint8_t *pData, uint16_t nbBlocks){
+    static const uint8_t    stopToken[2] = {SPI_SD_TOKEN_STOP, 0xFF};     // Busy from the byte after the token
+    spi_err_t   res, stop;
+    uint8_t     r1;
+    uint16_t    i;
+
+    if (nbBlocks == 0) return SPI_OK;
+    // The cached copy is superseded
+    if ((pSd->cacheBlock >= block) && (pSd->cacheBlock < (block + nbBlocks))){
+        pSd->cacheBlock = SPI_SD_NO_BLOCK;
+        pSd->cacheDirty = 0;
+    }
+    if (nbBlocks == 1) return spi_sd_write_block(pSd, block, pData);
+
+    // CMD25 : one command for the run, CS released while each block is programmed
+    res = spi_device_select(pSd->pDev);
+    if (res != SPI_OK) return res;
+    res = spi_sd_cmd(pSd, SPI_SD_CMD25, spi_sd_arg(pSd, block), &r1, NULL, 0);
+    if ((res == SPI_OK) && (r1 != 0)) res = SPI_ERROR;
+    for (i = 0; (i < nbBlocks) && (res == SPI_OK); i++){
+        if (i != 0) res = spi_device_select(pSd->pDev);
+        if (res != SPI_OK) break;
+        res = spi_sd_send_block(pSd, SPI_SD_TOKEN_MULTI, pData);
+        spi_device_release(pSd->pDev);
+        if (res == SPI_OK) res = spi_sd_wait(pSd);
+        pData += SPI_SD_BLOCK_SIZE;
+    }
+    if ((i == 0) && (res != SPI_OK)){
+        spi_device_release(pSd->pDev);  // CMD25 rejected : nothing to stop
+        return res;
+    }
+
+    // Stop token, also after a failed block (the card leaves the write state)
+    stop = spi_device_select(pSd->pDev);
+    if (stop == SPI_OK){
+        stop = spi_transfer_raw_bytes(pSd->pDev->pSpi, stopToken, NULL, 2);
+        spi_device_release(pSd->pDev);
+    }
+    if (stop == SPI_OK) stop = spi_sd_wait(pSd);
+    return (res != SPI_OK)?res:stop;
+}
+//------------------------------------------------------------------------------
+/**
+ * Brings block into the cache (the block cached before is written back)
+ */
+static spi_err_t   spi_sd_cache_load(spi_sd_t *pSd, uint32_t block){
+    spi_err_t   res;
+
+    if (pSd->cacheBlock == block) return SPI_OK;
+    res = spi_sd_flush(pSd);
+    if (res != SPI_OK) return res;
+    pSd->cacheBlock = SPI_SD_NO_BLOCK;
+    res = spi_sd_read_blocks(pSd, block, pSd->cache, 1);
+    if (res == SPI_OK) pSd->cacheBlock = block;
+    return res;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_sd_read(spi_sd_t *pSd, uint32_t addr, uint8_t *pData, size_t len){
+    spi_err_t   res;
+    uint32_t    block;
+    uint16_t    offset, nbBlocks;
+    size_t      chunk;
+
+    while (len){
+        block = addr / SPI_SD_BLOCK_SIZE;
+        offset = (uint16_t)(addr % SPI_SD_BLOCK_SIZE);
+        if ((offset == 0) && (len >= SPI_SD_BLOCK_SIZE) && (pSd->cacheBlock != block)){
+            // Run of whole blocks : one multiple block read
+            nbBlocks = (len / SPI_SD_BLOCK_SIZE > 0xFFFF)?0xFFFF:(uint16_t)(len / SPI_SD_BLOCK_SIZE);
+            if ((pSd->cacheBlock > block) && (pSd->cacheBlock < (block + nbBlocks))) nbBlocks = (uint16_t)(pSd->cacheBlock - block);
+            res = spi_sd_read_blocks(pSd, block, pData, nbBlocks);
+            if (res != SPI_OK) return res;
+            chunk = (size_t)nbBlocks * SPI_SD_BLOCK_SIZE;
+        }
+        else {
+            res = spi_sd_cache_load(pSd, block);
+            if (res != SPI_OK) return res;
+            chunk = SPI_SD_BLOCK_SIZE - offset;
+            if (chunk > len) chunk = len;
+            memcpy(pData, &pSd->cache[offset], chunk);
+        }
+        pData += chunk;
+        addr += chunk;
+        len -= chunk;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_sd_write(spi_sd_t *pSd, uint32_t addr, const uint8_t *pData, size_t len){
+    spi_err_t   res;
+    uint32_t    block;
+    uint16_t    offset, nbBlocks;
+    size_t      chunk;
+
+    while (len){
+        block = addr / SPI_SD_BLOCK_SIZE;
+        offset = (uint16_t)(addr % SPI_SD_BLOCK_SIZE);
+        if ((offset == 0) && (len >= SPI_SD_BLOCK_SIZE)){
+            // Whole blocks : written straight from pData
+            nbBlocks = (len / SPI_SD_BLOCK_SIZE > 0xFFFF)?0xFFFF:(uint16_t)(len / SPI_SD_BLOCK_SIZE);
+            res = spi_sd_write_blocks(pSd, block, pData, nbBlocks);
+            if (res != SPI_OK) return res;
+            chunk = (size_t)nbBlocks * SPI_SD_BLOCK_SIZE;
+        }
+        else {
+            res = spi_sd_cache_load(pSd, block);
+            if (res != SPI_OK) return res;
+            chunk = SPI_SD_BLOCK_SIZE - offset;
+            if (chunk > len) chunk = len;
+            memcpy(&pSd->cache[offset], pData, chunk);
+            pSd->cacheDirty = 1;
+        }
+        pData += chunk;
+        addr += chunk;
+        len -= chunk;
+    }
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
+spi_err_t   spi_sd_flush(spi_sd_t *pSd){
+    spi_err_t   res;
+
+    if (!pSd->cacheDirty) return SPI_OK;
+    res = spi_sd_write_block(pSd, pSd->cacheBlock, pSd->cache);
+    if (res != SPI_OK) return res;
+    pSd->cacheDirty = 0;
+    return SPI_OK;
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,118 @@
+/**
+ * @file    lib_spi_pic24_sd.h
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	SD card in SPI mode with a block cache (lib_spi_pic24_ll)
+ *
+ * - Block reads use CMD17, or CMD18 + CMD12 for several consecutive blocks
+ *   (one command for the whole run).
+ * - Byte accesses (spi_sd_read / spi_sd_write) go through a one block RAM
+ *   cache : short reads of the same block are served by the cache, writes
+ *   are gathered in it and written back (CMD24) when another block is
+ *   needed or on spi_sd_flush. Whole aligned blocks bypass the cache.
+ * - Block writes use CMD24, or CMD25 + stop token for several consecutive
+ *   blocks.
+ * - Busy polling after a block write issues one short read per poll, the CS
+ *   being released between polls : other devices may use the bus meanwhile
+ *   (see pfYield).
+ *
+ */
+
+#ifndef	__LIB_SPI_PIC24_SD_H__
+#define	__LIB_SPI_PIC24_SD_H__
+#include "lib_spi_pic24_bus.h"
+
+#define SPI_SD_BLOCK_SIZE       512
+#ifndef SPI_SD_TOKEN_POLLS
+#define SPI_SD_TOKEN_POLLS      4096    /**< Bytes read while waiting for a data token or the end of the CMD12 busy (CS asserted) */
+#endif
+#ifndef SPI_SD_INIT_POLLS
+#define SPI_SD_INIT_POLLS       4096    /**< ACMD41 sent before SPI_TIMEOUT */
+#endif
+
+/** Type spi_sd_t
+ *
+ *
+ */
+typedef struct {
+    spi_device_t    *pDev;              /**< Device (BITS8 configuration, SCK <= 400 kHz for spi_sd_init) */
+    void            (*pfYield)(void *pCtx);     /**< Called between 2 busy polls, or NULL */
+    void            *pYieldCtx;
+    uint32_t        maxPolls;           /**< Busy polls before SPI_TIMEOUT (0 : no limit) */
+    uint8_t         blockAddr;          /**< 1 : SDHC / SDXC (block addressing), 0 : byte addressing */
+
+    uint32_t        cacheBlock;         /**< Block held in cache (0xFFFFFFFF : none) */
+    uint8_t         cacheDirty;         /**< 1 : cache not written back yet */
+    uint8_t         cache[SPI_SD_BLOCK_SIZE];
+    } spi_sd_t;
+
+/**
+ * @brief   Initialize the card (CMD0, CMD8, ACMD41, CMD58, CMD16) and the
+ *          handle (cache empty)
+ *
+ * @param[out]  pSd         SD card handle
+ * @param[in]   pDev        Device handle (already initialized, BITS8
+ *                          configuration, SCK <= 400 kHz)
+ * @param[in]   pFastCfg    Configuration of the device once the card is
+ *                          initialized (SCK up to 25 MHz), or NULL : unchanged
+ * @param[in]   pfYield     Called between 2 busy polls (ex : serve other devices), or NULL
+ * @param[in]   pYieldCtx   Context given back to pfYield
+ *
+ * @return  SPI_OK
+ * @return  SPI_ERROR   no card, or card rejected (voltage range, bad response)
+ * @return  SPI_TIMEOUT card still idle after SPI_SD_INIT_POLLS ACMD41
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_sd_init(spi_sd_t *pSd, spi_device_t *pDev, const spi_config_t *pFastCfg, void (*pfYield)(void *pCtx), void *pYieldCtx);
+
+/**
+ * @brief   Reads nbBlocks consecutive blocks (CMD17, or CMD18 + CMD12)
+ *
+ * CMD12 is sent once CMD18 is accepted, even when a block fails ; its R1 and
+ * its busy are checked (the first error is returned).
+ *
+ * @return  SPI_OK
+ * @return  SPI_ERROR   command rejected (ex : out of the card)
+ * @return  SPI_TIMEOUT no data token, or card busy after CMD12
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_sd_read_blocks(spi_sd_t *pSd, uint32_t block, uint8_t *pData, uint16_t nbBlocks);
+
+/**
+ * @brief   Writes nbBlocks consecutive blocks (CMD24, or CMD25 + stop token)
+ *
+ * The card is busy-polled after each block, CS released between the polls.
+ * After a failed block of a CMD25 run the stop token is still sent.
+ *
+ * @return  SPI_OK
+ * @return  SPI_ERROR   command or data rejected
+ * @return  SPI_TIMEOUT busy after maxPolls polls
+ * @return  errors of spi_device_transaction
+ */
+spi_err_t   spi_sd_write_blocks(spi_sd_t *pSd, uint32_t block, const uint8_t *pData, uint16_t nbBlocks);
+
+/**
+ * @brief   Reads len bytes from byte address addr
+ *
+ * Whole aligned blocks are read straight to pData (one CMD18 for the run),
+ * the other bytes through the block cache.
+ *
+ * @return  see spi_sd_read_blocks
+ */
+spi_err_t   spi_sd_read(spi_sd_t *pSd, uint32_t addr, uint8_t *pData, size_t len);
+
+/**
+ * @brief   Writes len bytes at byte address addr (block write-back cache)
+ *
+ * @return  see spi_sd_write_blocks
+ */
+spi_err_t   spi_sd_write(spi_sd_t *pSd, uint32_t addr, const uint8_t *pData, size_t len);
+
+/**
+ * @brief   Writes the cached block back (if modified)
+ *
+ * @return  see spi_sd_write_blocks
+ */
+spi_err_t   spi_sd_flush(spi_sd_t *pSd);
+
+#endif
@@ -9,18 +9,72 @@
 
 
 #include "lib_test_lib_spi_pic24_ll.h" // Inclusion du fichier .h "Applicatif" renomm
+#include "lib_spi_pic24_ll_static.h"
+#ifdef BENCH_STORAGE
+#include "lib_spi_pic24_flash.h"
+#include "lib_spi_pic24_sd.h"
+#endif
 
 /* Directives de compilation - Macros		*/
 
 
 /* Dclarations des variables globales 	*/
 spi_desc_t  mySpi;
+static spi_config_t spiCfg;     /**< Application configuration of the SPI module */
+
+// Benchmark
+typedef enum    {   B_RAW_BYTE,
+                    B_RAW_BYTES,
+                    B_BYTE_REG,
+                    B_BYTE_REGS,
+                    B_RAW_WORD,
+                    B_RAW_WORDS,
+                    B_WORD_REG,
+                    B_WORD_REGS,
+                    B_ASYNC,
+                    B_PACKED_BYTES,
+                    B_SCRIPT,
+                    B_CRC_BYTES,
+                    B_STATIC_BYTE,  /**< lib_spi_pic24_ll_static.h */
+                    B_STATIC_BYTES,
+                    B_REGS_X8,      /**< 8 byte_regs calls of len / 8 bytes */
+                    B_REG_BATCH,    /**< Same reads as 8 batch jobs */
+                    B_NONE          /**< Empty run (timer overhead) */
+                    } bench_func_t;
+                    
+static const char *benchNames[] = { "raw_byte", "raw_bytes", "byte_reg", "byte_regs",
+                                    "raw_word", "raw_words", "word_reg", "word_regs",
+                                    "async", "packed_bytes", "script", "crc_bytes", 
+                                    "static_byte", "static_bytes", "byte_regs_x8", "reg_batch", "none" };
+static const tPriPrescaler benchPri[] = {PRI_PRE_1, PRI_PRE_4, PRI_PRE_16, PRI_PRE_64};
+static const uint8_t benchPriDiv[] = {1, 4, 16, 64};
+static const tSecPrescaler benchSec[] = {SEC_PRE_1, SEC_PRE_2, SEC_PRE_3, SEC_PRE_4, SEC_PRE_5, SEC_PRE_6, SEC_PRE_7, SEC_PRE_8};
+static const size_t benchLen[] = {1, 4, 16, 64, 256, BENCH_MAX_LEN};
+
+static uint16_t benchTxBuf[BENCH_MAX_LEN / 2];    // uint16_t : word aligned for the 16 bits transfers
+static uint16_t benchRxBuf[BENCH_MAX_LEN / 2];
+static uint8_t  * const benchTx = (uint8_t*)benchTxBuf;
+static uint8_t  * const benchRx = (uint8_t*)benchRxBuf;
+static uint32_t benchTimerOffset;   /**< Cost of a bench_timer() call */
+#ifdef BENCH_IDLE_CYCLES
+extern uint64_t BENCH_IDLE_CYCLES(void);
+static uint32_t benchIdleCycles;    /**< Cycles idled by the last bench_run() */
+#endif
+static spi_reg_job_t benchJobs[BENCH_BATCH_JOBS];   /**< No CS : the jobs only differ by their address */
+#if SPI_USE_SCRIPT
+static spi_script_op_t benchScript[] = {SPI_SCRIPT_TX_LIT(0x55), SPI_SCRIPT_RX_BUF(benchRxBuf, 0), SPI_SCRIPT_END()};
+#endif
+#ifdef BENCH_SLAVE_MODULE
+#if !SPI_USE_SLAVE
+#error "BENCH_SLAVE_MODULE : the slave engine is needed (SPI_USE_SLAVE = 1)"
+#endif
+static uint8_t  benchSlaveRxBuf[BENCH_MAX_LEN];
+static uint8_t  benchSlaveTxBuf[BENCH_MAX_LEN];
+#endif
 
 /*	Implmentation du code */
 void Initialiser(void)
 {
-    spi_config_t    spiCfg;
-    
     // Leds
     TRISA &= 0xFF00;
     LATA = 0;
@@ -36,11 +90,564 @@ void Initialiser(void)
     spiCfg.spiSamplePoint = MID_SMP;
     spiCfg.spiPrimaryPrescaler = PRI_PRE_4;
     spiCfg.spiSecondaryPrescaler = SEC_PRE_8;
+    spiCfg.spiBufferMode = STANDARD_BUFFER;
+    spiCfg.spiRole = SPI_MASTER;
+    spiCfg.spiFrameMode = SPI_UNFRAMED;
+    spiCfg.spiFrameSyncPolarity = FSYNC_ACTIVE_LOW;
     
     spi_init(SPI_MODULE, &spiCfg, &mySpi);
     
+    // UART (printf) : 8N1, BRGH = 0
+    __C30_UART = BENCH_UART;
+    U2BRG = (FCY / (16 * BENCH_BAUDRATE)) - 1;
+    U2MODE = 0;
+    U2MODEbits.UARTEN = 1;
+    U2STAbits.UTXEN = 1;
     
+    // Timer2/3 : 32 bits timer, clocked by FCY, free running
+    T2CON = 0;
+    T3CON = 0;
+    T2CONbits.T32 = 1;
+    TMR3 = 0;
+    TMR2 = 0;
+    PR3 = 0xFFFF;
+    PR2 = 0xFFFF;
+    T2CONbits.TON = 1;
+}
+//------------------------------------------------------------------------------
+static uint32_t bench_timer(void){
+    uint16_t    lsw = TMR2;     // TMR3 is latched into TMR3HLD when TMR2 is read
+    return ((uint32_t)TMR3HLD << 16) | lsw;
+}
+//------------------------------------------------------------------------------
+/**
+ * Number of frames sent by one call of the benchmarked function
+ */
+static size_t bench_frames(bench_func_t func, size_t len){
+    switch(func){
+        case B_RAW_BYTE:
+        case B_RAW_WORD:
+        case B_STATIC_BYTE: return 1;
+        case B_BYTE_REG:
+        case B_WORD_REG:    return 2;
+        case B_BYTE_REGS:
+        case B_WORD_REGS:
+        case B_SCRIPT:      return len + 1;
+        case B_REGS_X8:
+        case B_REG_BATCH:   return ((len / BENCH_BATCH_JOBS) + 1) * BENCH_BATCH_JOBS;
+        default:            return len;
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * Runs one call of the benchmarked function, returns its duration in cycles 
+ */
+static uint32_t bench_run(spi_desc_t *pSpi, bench_func_t func, size_t len){
+    uint32_t    start, stop;
+    uint16_t    *pTxWords = benchTxBuf;
+    uint16_t    *pRxWords = benchRxBuf;
+    spi_crc_t   crc;
+    uint8_t     job;
+#ifdef BENCH_IDLE_CYCLES
+    uint64_t    idle;
+#endif
     
-
+    spi_crc_init(&crc, SPI_CRC16, 0);
+    for (job = 0; job < BENCH_BATCH_JOBS; job++) benchJobs[job].len = len / BENCH_BATCH_JOBS;
+#ifdef BENCH_IDLE_CYCLES
+    idle = BENCH_IDLE_CYCLES();
+#endif
+    start = bench_timer();
+    switch(func){
+        case B_RAW_BYTE:    spi_transfer_raw_byte(pSpi, benchTx[0], &benchRx[0]);break;
+        case B_RAW_BYTES:   spi_transfer_raw_bytes(pSpi, benchTx, benchRx, len);break;
+        case B_BYTE_REG:    spi_transfer_byte_reg(pSpi, 0x55, benchTx[0], &benchRx[0]);break;
+        case B_BYTE_REGS:   spi_transfer_byte_regs(pSpi, 0x55, benchTx, benchRx, len);break;
+        case B_RAW_WORD:    spi_transfer_raw_word(pSpi, pTxWords[0], &pRxWords[0]);break;
+        case B_RAW_WORDS:   spi_transfer_raw_words(pSpi, pTxWords, pRxWords, len);break;
+        case B_WORD_REG:    spi_transfer_word_reg(pSpi, 0x5555, pTxWords[0], &pRxWords[0]);break;
+        case B_WORD_REGS:   spi_transfer_word_regs(pSpi, 0x5555, pTxWords, pRxWords, len);break;
+#if SPI_USE_ASYNC
+        case B_ASYNC:
+            spi_transfer_async(pSpi, benchTx, benchRx, len, NULL, NULL);
+            while (spi_async_status(pSpi) == SPI_ASYNC_BUSY);
+            break;
+#endif
+        case B_PACKED_BYTES:spi_transfer_packed_bytes(pSpi, benchTx, benchRx, len);break;
+#if SPI_USE_SCRIPT
+        case B_SCRIPT:
+            benchScript[1].arg = len;
+            spi_script_start(pSpi, benchScript, NULL, NULL, NULL);
+            while (spi_async_status(pSpi) == SPI_ASYNC_BUSY);
+            break;
+#endif
+        case B_CRC_BYTES:   spi_transfer_crc_bytes(pSpi, benchTx, benchRx, len, &crc, 0);break;
+        case B_STATIC_BYTE: benchRx[0] = spi_static_byte(benchTx[0]);break;
+        case B_STATIC_BYTES:spi_static_bytes(benchTx, benchRx, len);break;
+        case B_REGS_X8:
+            for (job = 0; job < BENCH_BATCH_JOBS; job++){
+                spi_transfer_byte_regs(pSpi, benchJobs[job].reg, NULL, &benchRx[job * benchJobs[job].len], benchJobs[job].len);
+            }
+            break;
+        case B_REG_BATCH:   spi_transfer_reg_batch(pSpi, benchJobs, BENCH_BATCH_JOBS, benchRx, BENCH_BATCH_JOBS);break;
+        default: break;
+    }
+    stop = bench_timer();
+#ifdef BENCH_IDLE_CYCLES
+    benchIdleCycles = (uint32_t)(BENCH_IDLE_CYCLES() - idle);
+#endif
+    return stop - start - benchTimerOffset;
+}
+//------------------------------------------------------------------------------
+/**
+ * Runs one function for every transfer length and prints one CSV line per case 
+ */
+static void bench_sweep(spi_desc_t *pSpi, bench_func_t func, const char *mode, uint8_t pri, uint8_t sec){
+    uint8_t     i;
+    size_t      len, frames;
+    uint32_t    cycles, wireCycles, overhead, bytes, runCycles;
+    uint8_t     bits = (pSpi->spiDataFormat == BITS8)?8:16;
+    uint8_t     single = (bench_frames(func, 1) == bench_frames(func, 2));
+    
+    // Functions left out of the library build (see SPI_USE_xxx)
+    if ((!SPI_USE_ASYNC && (func == B_ASYNC)) || (!SPI_USE_SCRIPT && (func == B_SCRIPT))) return;
+    for (i = 0; i < (sizeof(benchLen) / sizeof(benchLen[0])); i++){
+        len = benchLen[i];
+        if ((bits == 16) && (len > (BENCH_MAX_LEN / 2))) break;
+        frames = bench_frames(func, len);
+        cycles = bench_run(pSpi, func, len);
+        wireCycles = (uint32_t)frames * bits * pri * sec;
+        overhead = (cycles > wireCycles)?(cycles - wireCycles):0;
+        bytes = (uint32_t)frames * (bits / 8);
+        // Energy model : the core runs for the whole call, or only for the overhead when it is idled
+#ifdef BENCH_IDLE_CYCLES
+        runCycles = (cycles > benchIdleCycles)?(cycles - benchIdleCycles):0;
+#else
+        runCycles = pSpi->idleWait?overhead:cycles;
+#endif
+        printf("%s,%s,%u,%u,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu\r\n", benchNames[func], mode, pri, sec,
+                (unsigned int)len, (unsigned int)frames, (unsigned long)cycles,
+                (unsigned long)(((uint64_t)bytes * FCY) / cycles),
+                (unsigned long)(FCY / ((uint32_t)pri * sec * 8)) ,
+                (unsigned long)overhead, (unsigned long)(overhead / frames),
+                (unsigned long)(((uint64_t)runCycles * BENCH_IRUN_UA + (uint64_t)(cycles - runCycles) * BENCH_IIDLE_UA)
+                                * BENCH_VDD_MV / (FCY / 1000UL) / bytes));
+        // Functions working on a single frame : one length is enough
+        if (single) break;
+    }
+}
+//------------------------------------------------------------------------------
+#ifdef BENCH_SLAVE_MODULE
+/**
+ * Master (SPI_MODULE) -> slave (BENCH_SLAVE_MODULE) run at one SCK frequency.
+ * The slave answers the complement of benchTx, its Tx ring being preloaded.
+ */
+static void bench_slave(spi_config_t *pCfg, const char *mode, uint8_t pri, uint8_t sec){
+    spi_config_t    slaveCfg = *pCfg;
+    spi_desc_t      master, slave;
+    spi_ring_t      rxRing, txRing;
+    uint16_t        i, received, errors = 0;
+    
+    slaveCfg.spiRole = SPI_SLAVE;
+    spi_init(BENCH_SLAVE_MODULE, &slaveCfg, &slave);
+    spi_init(SPI_MODULE, pCfg, &master);
+    spi_ring_init(&rxRing, benchSlaveRxBuf, BENCH_MAX_LEN, BITS8);
+    spi_ring_init(&txRing, benchSlaveTxBuf, BENCH_MAX_LEN, BITS8);
+    for (i = 0; i < BENCH_MAX_LEN; i++) benchRx[i] = (uint8_t)~benchTx[i];
+    spi_ring_write(&txRing, benchRx, BENCH_MAX_LEN);
+    spi_slave_start(&slave, &rxRing, &txRing, 0xFF);
+    
+    spi_transfer_raw_bytes(&master, benchTx, benchRx, BENCH_MAX_LEN);
+    
+    spi_slave_stop(&slave);
+    received = spi_ring_count(&rxRing);
+    for (i = 0; i < received; i++){
+        if (benchSlaveRxBuf[i] != benchTx[i]) errors++;
+    }
+    for (i = 0; i < BENCH_MAX_LEN; i++){
+        if ((benchRx[i] ^ benchTx[i]) != 0xFF) errors++;
+    }
+    printf("slave,%s,%u,%u,%u,%u,%u,%u,%u\r\n", mode, pri, sec, (unsigned int)BENCH_MAX_LEN, 
+            received, errors, spi_slave_underruns(&slave), spi_slave_overruns(&slave));
+}
+#endif
+//------------------------------------------------------------------------------
+#if SPI_USE_BUS
+/**
+ * Bus arbitration : cost of an uncontended acquire + release (the interrupts 
+ * are only masked within these calls)
+ */
+static void bench_bus(void){
+    spi_desc_t  spi;
+    uint32_t    start, stop;
+    
+    spi_init(SPI_MODULE, &spiCfg, &spi);
+    start = bench_timer();
+    spi_bus_acquire(&spi, &spi, 0, NULL, NULL);
+    spi_bus_release(&spi, &spi);
+    stop = bench_timer();
+    printf("#bus_lock,cycles=%lu\r\n", (unsigned long)(stop - start - benchTimerOffset));
+}
+#endif
+//------------------------------------------------------------------------------
+#if SPI_USE_TRACE
+/**
+ * Trace recorder : cost of one record (raw_byte with the trace off / on), 
+ * then one traced call of a few functions, dumped as CSV
+ */
+static void bench_trace(void){
+    spi_desc_t      spi;
+    spi_trace_rec_t rec;
+    uint32_t        off = 0, on = 0;
+    uint8_t         i;
+    
+    spi_init(SPI_MODULE, &spiCfg, &spi);
+    spi_trace_set_timer(bench_timer);
+    spi_trace_tag(&spi, 0xBE);
+    for (i = 0; i < 8; i++){
+        spi_trace_enable(0);
+        off += bench_run(&spi, B_RAW_BYTE, 1);
+        spi_trace_enable(1);
+        on += bench_run(&spi, B_RAW_BYTE, 1);
+        spi_trace_drain(&rec, 1);
+    }
+    printf("#trace_overhead,cycles=%ld\r\n", ((long)on - (long)off) / 8);
+    
+    bench_run(&spi, B_RAW_BYTES, 16);
+    bench_run(&spi, B_PACKED_BYTES, 16);
+    bench_run(&spi, B_CRC_BYTES, 16);
+    bench_run(&spi, B_ASYNC, 64);
+    bench_run(&spi, B_SCRIPT, 4);
+    spi_trace_enable(0);
+    TraceDump();
+}
+//------------------------------------------------------------------------------
+void TraceDump(void)
+{
+    spi_trace_rec_t rec;
+    uint16_t        lost;
+    uint8_t         i;
+    
+    while (spi_trace_drain(&rec, 1)){
+        printf("trace,%u,%u,%u,%lu,%lu,%u,%u,", rec.module, rec.tag, rec.op, 
+                (unsigned long)rec.start, (unsigned long)rec.end, rec.len, rec.result);
+        for (i = 0; i < SPI_TRACE_DATA; i++) printf("%02X", rec.data[i]);
+        printf("\r\n");
+    }
+    lost = spi_trace_lost();
+    if (lost) printf("#trace_lost,%u\r\n", lost);
+}
+//------------------------------------------------------------------------------
+#endif
+#ifdef BENCH_STORAGE
+#define BENCH_STORAGE_LEN   4096UL  /**< Bytes moved by each storage run */
+static spi_flash_t  benchFlash;
+static spi_sd_t     benchSd;
+/**
+ * Chunk address of the pseudo random runs : permutation of the 
+ * BENCH_STORAGE_LEN / chunk chunks of the area
+ */
+static uint32_t bench_chunk_addr(uint32_t base, uint16_t i, uint16_t chunk, uint8_t random){
+    uint16_t    nbChunks = BENCH_STORAGE_LEN / chunk;
+    
+    if (random) i = (uint16_t)((i * 97U + 31U) & (nbChunks - 1));     // nbChunks : power of 2
+    return base + ((uint32_t)i * chunk);
 }
+//------------------------------------------------------------------------------
+static void bench_storage_line(const char *dev, uint8_t random, const char *op, uint16_t chunk, uint32_t cycles){
+    printf("storage,%s,%s,%s,%u,%lu,%lu,%lu\r\n", dev, random?"rand":"seq", op, chunk, 
+            (unsigned long)BENCH_STORAGE_LEN, (unsigned long)cycles, 
+            (unsigned long)(((uint64_t)BENCH_STORAGE_LEN * FCY) / cycles));
+}
+//------------------------------------------------------------------------------
+/**
+ * One run : BENCH_STORAGE_LEN bytes by chunks, flushed at the end (write)
+ */
+static uint32_t bench_storage_run(uint8_t sd, uint8_t write, uint32_t base, uint16_t chunk, uint8_t random){
+    uint32_t    start, stop, addr;
+    uint16_t    i;
+    
+    start = bench_timer();
+    for (i = 0; i < (BENCH_STORAGE_LEN / chunk); i++){
+        addr = bench_chunk_addr(base, i, chunk, random);
+        if (sd){
+            if (write) spi_sd_write(&benchSd, addr, benchTx, chunk);
+            else spi_sd_read(&benchSd, addr, benchRx, chunk);
+        }
+        else {
+            if (write) spi_flash_write(&benchFlash, addr, benchTx, chunk);
+            else spi_flash_read(&benchFlash, addr, benchRx, chunk);
+        }
+    }
+    if (write){
+        if (sd) spi_sd_flush(&benchSd);
+        else spi_flash_flush(&benchFlash);
+    }
+    stop = bench_timer();
+    return stop - start - benchTimerOffset;
+}
+//------------------------------------------------------------------------------
+void StorageBenchmark(void)
+{
+    static const uint16_t   chunks[] = {16, BENCH_MAX_LEN};
+    spi_config_t    cfg = spiCfg;
+    spi_desc_t      spi;
+    spi_device_t    flashDev, sdDev;
+    spi_cs_t        flashCs = {NULL, NULL, &LATB, BENCH_FLASH_CS_MASK};
+    spi_cs_t        sdCs = {NULL, NULL, &LATB, BENCH_SD_CS_MASK};
+    uint8_t         c, random;
+    uint16_t        i;
+    
+    for (i = 0; i < BENCH_MAX_LEN; i++) benchTx[i] = (uint8_t)i;
+    TRISB &= ~(BENCH_FLASH_CS_MASK | BENCH_SD_CS_MASK);
+    benchTimerOffset = 0;
+    benchTimerOffset = bench_run(&spi, B_NONE, 0);
+    
+    cfg.spiPrimaryPrescaler = PRI_PRE_1;
+    cfg.spiSecondaryPrescaler = SEC_PRE_2;
+    cfg.spiBufferMode = ENHANCED_BUFFER;
+    spi_init(SPI_MODULE, &spiCfg, &spi);
+    spi_device_init(&flashDev, &spi, &cfg, &flashCs);
+    spi_device_init(&sdDev, &spi, &spiCfg, &sdCs);     // SCK <= 400 kHz until the card is initialized
+    spi_flash_init(&benchFlash, &flashDev, NULL, NULL);
+    if (spi_sd_init(&benchSd, &sdDev, &cfg, NULL, NULL) != SPI_OK) printf("#storage,sd_init_failed\r\n");
+    
+    printf("storage,dev,access,op,chunk,bytes,cycles,bytes_per_s\r\n");
+    for (c = 0; c < (sizeof(chunks) / sizeof(chunks[0])); c++){
+        for (random = 0; random < 2; random++){
+            spi_flash_erase_sector(&benchFlash, SPI_FLASH_SECTOR_SIZE * (1 + random));
+            bench_storage_line("flash", random, "write", chunks[c], 
+                    bench_storage_run(0, 1, SPI_FLASH_SECTOR_SIZE * (1 + random), chunks[c], random));
+            bench_storage_line("flash", random, "read", chunks[c], 
+                    bench_storage_run(0, 0, SPI_FLASH_SECTOR_SIZE * (1 + random), chunks[c], random));
+            bench_storage_line("sd", random, "write", chunks[c], 
+                    bench_storage_run(1, 1, 8UL * SPI_SD_BLOCK_SIZE, chunks[c], random));
+            bench_storage_line("sd", random, "read", chunks[c], 
+                    bench_storage_run(1, 0, 8UL * SPI_SD_BLOCK_SIZE, chunks[c], random));
+        }
+    }
+    
+    // Back to the application configuration
+    spi_init(SPI_MODULE, &spiCfg, &mySpi);
+}
+//------------------------------------------------------------------------------
+#endif
+void Benchmark(void)
+{
+    spi_config_t    cfg = spiCfg;
+    spi_desc_t      spi;
+    uint8_t         p, q;
+    uint16_t        i;
+    
+    for (i = 0; i < BENCH_MAX_LEN; i++) benchTx[i] = (uint8_t)i;
+    for (i = 0; i < BENCH_BATCH_JOBS; i++) benchJobs[i].reg = 0x80 | i;
+    benchTimerOffset = 0;
+    benchTimerOffset = bench_run(&spi, B_NONE, 0);
+    
+    printf("#spi_bench,v1,fcy=%lu\r\n", (unsigned long)FCY);
+    printf("func,mode,pri,sec,len,frames,cycles,bytes_per_s,sck_bytes_per_s,overhead_cycles,gap_cycles,pj_per_byte\r\n");
+    
+    for (p = 0; p < (sizeof(benchPri) / sizeof(benchPri[0])); p++){
+        for (q = 0; q < (sizeof(benchSec) / sizeof(benchSec[0])); q++){
+            if ((benchPri[p] == PRI_PRE_1) && (benchSec[q] == SEC_PRE_1)) continue;  // Illegal
+            cfg.spiPrimaryPrescaler = benchPri[p];
+            cfg.spiSecondaryPrescaler = benchSec[q];
+            
+            // 8 bits, standard buffer
+            cfg.spiDataFormat = BITS8;
+            cfg.spiBufferMode = STANDARD_BUFFER;
+            spi_init(SPI_MODULE, &cfg, &spi);
+            bench_sweep(&spi, B_RAW_BYTE, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_RAW_BYTES, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_BYTE_REG, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_BYTE_REGS, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_ASYNC, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_PACKED_BYTES, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_SCRIPT, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_CRC_BYTES, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_STATIC_BYTE, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_STATIC_BYTES, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_REGS_X8, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_REG_BATCH, "std", benchPriDiv[p], q + 1);
+            
+            // 8 bits, standard buffer, core idled while the frames are shifted (polled below the cutover)
+            spi_set_transfer_mode(&spi, SPI_XFER_IDLE);
+            bench_sweep(&spi, B_RAW_BYTE, spi.idleWait?"idle":"idle_poll", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_RAW_BYTES, spi.idleWait?"idle":"idle_poll", benchPriDiv[p], q + 1);
+            
+            // 8 bits, enhanced buffer (burst)
+            cfg.spiBufferMode = ENHANCED_BUFFER;
+            spi_init(SPI_MODULE, &cfg, &spi);
+            if (spi.spiBufferMode == ENHANCED_BUFFER){
+                bench_sweep(&spi, B_RAW_BYTES, "fifo", benchPriDiv[p], q + 1);
+                bench_sweep(&spi, B_BYTE_REGS, "fifo", benchPriDiv[p], q + 1);
+                bench_sweep(&spi, B_ASYNC, "fifo", benchPriDiv[p], q + 1);
+                bench_sweep(&spi, B_PACKED_BYTES, "fifo", benchPriDiv[p], q + 1);
+                bench_sweep(&spi, B_SCRIPT, "fifo", benchPriDiv[p], q + 1);
+                bench_sweep(&spi, B_CRC_BYTES, "fifo", benchPriDiv[p], q + 1);
+                bench_sweep(&spi, B_REGS_X8, "fifo", benchPriDiv[p], q + 1);
+                bench_sweep(&spi, B_REG_BATCH, "fifo", benchPriDiv[p], q + 1);
+                spi_set_transfer_mode(&spi, SPI_XFER_IDLE);
+                bench_sweep(&spi, B_RAW_BYTES, spi.idleWait?"fifo_idle":"fifo_idle_poll", benchPriDiv[p], q + 1);
+            }
+            
+            // 16 bits, standard buffer
+            cfg.spiDataFormat = BITS16;
+            cfg.spiBufferMode = STANDARD_BUFFER;
+            spi_init(SPI_MODULE, &cfg, &spi);
+            bench_sweep(&spi, B_RAW_WORD, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_RAW_WORDS, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_WORD_REG, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_WORD_REGS, "std", benchPriDiv[p], q + 1);
+            bench_sweep(&spi, B_ASYNC, "std", benchPriDiv[p], q + 1);
+            spi_set_transfer_mode(&spi, SPI_XFER_IDLE);
+            bench_sweep(&spi, B_RAW_WORDS, spi.idleWait?"idle":"idle_poll", benchPriDiv[p], q + 1);
+        }
+    }
+#ifdef BENCH_SLAVE_MODULE
+    printf("slave,mode,pri,sec,len,received,errors,underruns,overruns\r\n");
+    cfg = spiCfg;
+    cfg.spiClockPhase = IDLE_TO_ACTIVE_CPHASE;  // SSx not wired : CKE must be cleared
+    for (p = 0; p < (sizeof(benchPri) / sizeof(benchPri[0])); p++){
+        for (q = 0; q < (sizeof(benchSec) / sizeof(benchSec[0])); q++){
+            if ((benchPri[p] == PRI_PRE_1) && (benchSec[q] == SEC_PRE_1)) continue;  // Illegal
+            cfg.spiPrimaryPrescaler = benchPri[p];
+            cfg.spiSecondaryPrescaler = benchSec[q];
+            cfg.spiBufferMode = STANDARD_BUFFER;
+            bench_slave(&cfg, "std", benchPriDiv[p], q + 1);
+            cfg.spiBufferMode = ENHANCED_BUFFER;
+            bench_slave(&cfg, "fifo", benchPriDiv[p], q + 1);
+        }
+    }
+    spi_init(BENCH_SLAVE_MODULE, &spiCfg, &spi);    // Back to master mode (module idle)
+#endif
+#if SPI_USE_BUS
+    bench_bus();
+#endif
+#if SPI_USE_TRACE
+    printf("trace,module,tag,op,start,end,len,result,data\r\n");
+    bench_trace();
+#endif
+    printf("#end\r\n");
+    
+    // Back to the application configuration
+    spi_init(SPI_MODULE, &spiCfg, &mySpi);
+}
+//------------------------------------------------------------------------------
+#ifdef TEST_LOOPBACK
+static uint16_t testSeed = 0xACE1;  /**< Pseudo random generator (16 bits LFSR) */
+static uint16_t testCases;
+static uint16_t testErrors;
 
+static uint16_t test_random(void){
+    testSeed = (testSeed >> 1) ^ (-(testSeed & 1) & 0xB400);
+    return testSeed;
+}
+//------------------------------------------------------------------------------
+/**
+ * Runs one transfer, checks the frames received (loopback) 
+ */
+static void test_case(spi_desc_t *pSpi, bench_func_t func, const char *mode, size_t len, uint8_t useTx, uint8_t useRx){
+    uint8_t     bits = (pSpi->spiDataFormat == BITS8)?8:16;
+    uint16_t    fill = (bits == 8)?0xFF:0xFFFF;
+    const void  *pTx = useTx?(const void*)benchTxBuf:NULL;
+    void        *pRx = useRx?(void*)benchRxBuf:NULL;
+    spi_err_t   res = SPI_OK;
+    spi_crc_t   crc;
+    size_t      i, bad = len;
+    uint16_t    sent, got;
+    
+    for (i = 0; i < (BENCH_MAX_LEN / 2); i++){
+        benchTxBuf[i] = test_random();
+        benchRxBuf[i] = ~benchTxBuf[i];
+    }
+    switch(func){
+        case B_RAW_BYTES:   res = spi_transfer_raw_bytes(pSpi, pTx, pRx, len);break;
+        case B_RAW_WORDS:   res = spi_transfer_raw_words(pSpi, pTx, pRx, len);break;
+        case B_PACKED_BYTES:res = spi_transfer_packed_bytes(pSpi, pTx, pRx, len);break;
+        case B_CRC_BYTES:
+            spi_crc_init(&crc, SPI_CRC16, 0);
+            res = spi_transfer_crc_bytes(pSpi, pTx, pRx, len, &crc, useTx?(SPI_CRC_SEND | SPI_CRC_CHECK):0);
+            if ((res == SPI_OK) && useTx && (crc.txCrc != crc.rxCrc)) res = SPI_CRC_ERROR;
+            break;
+#if SPI_USE_ASYNC
+        case B_ASYNC:
+            res = spi_transfer_async(pSpi, pTx, pRx, len, NULL, NULL);
+            while (spi_async_status(pSpi) == SPI_ASYNC_BUSY);
+            break;
+#endif
+        default: break;
+    }
+    // Loopback : frame received = frame sent
+    if ((res == SPI_OK) && useRx){
+        for (i = 0; i < len; i++){
+            if (bits == 8){
+                sent = useTx?benchTx[i]:fill;
+                got = benchRx[i];
+            }
+            else{
+                sent = useTx?benchTxBuf[i]:fill;
+                got = benchRxBuf[i];
+            }
+            if (got != sent){
+                bad = i;
+                break;
+            }
+        }
+    }
+    testCases++;
+    if ((res != SPI_OK) || (bad != len)){
+        testErrors++;
+        printf("selftest,%s,%s,%u,%u,%u,%u,%u,%u\r\n", benchNames[func], mode, bits, (unsigned int)len, 
+                useTx, useRx, res, (unsigned int)bad);
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * Runs one function with every NULL combination and a set of lengths 
+ */
+static void test_func(spi_desc_t *pSpi, bench_func_t func, const char *mode){
+    static const size_t testLen[] = {0, 1, 2, 7, 8, 9, 16, 17};
+    size_t      maxLen = (pSpi->spiDataFormat == BITS8)?BENCH_MAX_LEN:(BENCH_MAX_LEN / 2);
+    uint8_t     i, k;
+    
+    if (!SPI_USE_ASYNC && (func == B_ASYNC)) return;   // Not built
+    for (k = 0; k < 4; k++){
+        for (i = 0; i < (sizeof(testLen) / sizeof(testLen[0])); i++) test_case(pSpi, func, mode, testLen[i], k & 1, k >> 1);
+        for (i = 0; i < 8; i++) test_case(pSpi, func, mode, test_random() % (maxLen + 1), k & 1, k >> 1);
+    }
+}
+//------------------------------------------------------------------------------
+uint16_t SelfTest(void)
+{
+    spi_config_t    cfg = spiCfg;
+    spi_desc_t      spi;
+    uint8_t         m;
+    const char      *mode;
+    
+    testCases = 0;
+    testErrors = 0;
+    for (m = 0; m < 2; m++){
+        cfg.spiBufferMode = (m == 0)?STANDARD_BUFFER:ENHANCED_BUFFER;
+        mode = (m == 0)?"std":"fifo";
+        
+        cfg.spiDataFormat = BITS8;
+        spi_init(SPI_MODULE, &cfg, &spi);
+        if (spi.spiBufferMode != cfg.spiBufferMode) break;     // No Enhanced Buffer mode
+        test_func(&spi, B_RAW_BYTES, mode);
+        test_func(&spi, B_PACKED_BYTES, mode);
+        test_func(&spi, B_CRC_BYTES, mode);
+        test_func(&spi, B_ASYNC, mode);
+        
+        cfg.spiDataFormat = BITS16;
+        spi_init(SPI_MODULE, &cfg, &spi);
+        test_func(&spi, B_RAW_WORDS, mode);
+        test_func(&spi, B_ASYNC, mode);
+    }
+    printf("#selftest,cases=%u,errors=%u\r\n", testCases, testErrors);
+    
+    // Back to the application configuration
+    spi_init(SPI_MODULE, &spiCfg, &mySpi);
+    return testErrors;
+}
+#endif
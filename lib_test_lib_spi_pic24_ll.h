@@ -15,17 +15,49 @@
 
 #include <libpic30.h>
 #include <xc.h>
+#include <stdio.h>
 
 #include "lib_spi_pic24_ll.h"
 
 #define SPI_MODULE  _SPI1
 
+// Same module bound at compile time (lib_spi_pic24_ll_static.h), compared 
+// with the generic API by the benchmark (8 bits, standard buffer)
+#define SPI_STATIC_MODULE   1
+#define SPI_STATIC_CON1     SPI_CON1(CLK_IDLE_IS_LOW, ACTIVE_TO_IDLE_CPHASE, MID_SMP, BITS8, PRI_PRE_4, SEC_PRE_8)
+#define SPI_STATIC_CON2     SPI_CON2(STANDARD_BUFFER)
+
 #define CS_PIN      LATBbits.LATB2      //b23
 #define TRIS_CS     TRISBbits.TRISB2
 
 #define CS_LOW()    CS_PIN=0
 #define CS_HIGH()   CS_PIN=1
 
+// Benchmark report : printf() on UART2 (RS-232 port of the Explorer 16 board)
+#define BENCH_UART          2
+#define BENCH_BAUDRATE      19200UL
+#define BENCH_MAX_LEN       512     /**< Largest transfer (bytes) of the sweep, power of 2 */
+#define BENCH_BATCH_JOBS    8       /**< Devices of the byte_regs_x8 / reg_batch runs */
+// Energy model of the benchmark : supply current of the core running / idled
+// (datasheet typical values at FCY, to be replaced by measured ones)
+#define BENCH_VDD_MV        3300UL
+#define BENCH_IRUN_UA       6000UL
+#define BENCH_IIDLE_UA      2500UL
+// Counter of the cycles spent in Idle (uint64_t function), when the platform 
+// has one (ex : simulator : sim_idle_cycles). Otherwise the core is taken as 
+// idled while the bits are shifted (SPI_XFER_IDLE).
+//#define BENCH_IDLE_CYCLES   sim_idle_cycles
+// Self test : uncomment when SDO is wired to SDI of SPI_MODULE (loopback)
+//#define TEST_LOOPBACK
+// Slave benchmark : uncomment when a second module is wired to SPI_MODULE 
+// (SCKx <-> SCKy, SDOx -> SDIy, SDIx <- SDOy)
+//#define BENCH_SLAVE_MODULE  _SPI2
+// Storage benchmark : uncomment when a 25 series flash and a SD card are 
+// wired to SPI_MODULE (CS lines below)
+//#define BENCH_STORAGE
+#define BENCH_FLASH_CS_MASK (1 << 3)    /**< LATB : RB3 */
+#define BENCH_SD_CS_MASK    (1 << 4)    /**< LATB : RB4 */
+
 /**
  * @brief Global init function/task 
  * 
@@ -36,6 +68,135 @@
  */
 void Initialiser(void);
 
+/**
+ * @brief Throughput / latency benchmark of the SPI library
+ * 
+ * Every transfer function is run for each transfer length and each legal 
+ * Primary x Secondary prescaler combination. Each case is timed with the 
+ * 32 bits Timer2/3 (clocked at FCY) and reported as a CSV line on the UART :
+ * 
+ * func,mode,pri,sec,len,frames,cycles,bytes_per_s,sck_bytes_per_s,overhead_cycles,gap_cycles,pj_per_byte
+ * 
+ *  - bytes_per_s     : bytes actually moved per second
+ *  - sck_bytes_per_s : theoretical rate given by the SCK frequency
+ *  - overhead_cycles : cycles of the call not spent shifting bits
+ *  - gap_cycles      : overhead_cycles / frames (mean inter-frame gap)
+ *  - pj_per_byte     : energy per byte of the model BENCH_VDD_MV x 
+ *                      (BENCH_IRUN_UA x running cycles + BENCH_IIDLE_UA x 
+ *                      idled cycles) ; the idled cycles are measured with 
+ *                      BENCH_IDLE_CYCLES when defined, otherwise the core is 
+ *                      taken as idled while the bits are shifted in the 
+ *                      "idle" modes only (SPI_XFER_IDLE), the "idle_poll" 
+ *                      modes being below the SPI_IDLE_MIN_CYCLES cutover
+ * 
+ * @param	None
+ * 
+ * @return  Nothing 
+ *
+ * When BENCH_SLAVE_MODULE is defined (SPI_USE_SLAVE = 1), the slave engine 
+ * is then run for each SCK frequency, SPI_MODULE sending BENCH_MAX_LEN bytes 
+ * (raw_bytes) to BENCH_SLAVE_MODULE, and reported as :
+ * 
+ * slave,mode,pri,sec,len,received,errors,underruns,overruns
+ * 
+ *  - received        : frames stored in the Rx ring of the slave
+ *  - errors          : frames received by the slave or by the master with a 
+ *                      wrong value
+ *  - underruns       : fill frames loaded by the slave (includes the few 
+ *                      frames prefetched past the end of the run)
+ * 
+ * The byte_regs_x8 / reg_batch lines read len / 8 bytes from each of 8 
+ * devices (no CS line), with 8 spi_transfer_byte_regs calls or with one 
+ * spi_transfer_reg_batch call (structure of arrays).
+ * 
+ * The static_byte(s) lines are the same transfers made by the functions of 
+ * lib_spi_pic24_ll_static.h (module registers accessed directly), the 
+ * module being configured by the generic API for each SCK frequency.
+ * 
+ * The async / script lines are only printed when SPI_USE_ASYNC / 
+ * SPI_USE_SCRIPT are 1. When SPI_USE_BUS is 1, the cost of an uncontended 
+ * spi_bus_acquire + spi_bus_release is printed as "#bus_lock,cycles=N".
+ * 
+ * When SPI_USE_TRACE is 1, the cost of one trace record is printed as 
+ * "#trace_overhead,cycles=N" (raw_byte, trace on - trace off), followed by 
+ * the records of a few traced calls (see TraceDump).
+ * 
+ * @param	None
+ * 
+ * @return  Nothing 
+ *
+ * @attention : The SPI module is re-initialized with the application 
+ *              configuration once the benchmark is over
+ */
+void Benchmark(void);
+
+#ifdef BENCH_STORAGE
+/**
+ * @brief Throughput of the storage layers (BENCH_STORAGE) : sequential vs 
+ *        random accesses
+ * 
+ * The flash (lib_spi_pic24_flash) and the SD card (lib_spi_pic24_sd) are 
+ * driven at FCY / 2 (SPI_MODULE, enhanced buffer). Each run moves 4 KB 
+ * (sector 1..2 of the flash, blocks 8..15 of the card are overwritten) and 
+ * is reported as a CSV line on the UART :
+ * 
+ * storage,dev,access,op,chunk,bytes,cycles,bytes_per_s
+ * 
+ *  - access          : seq (consecutive chunks) or rand (pseudo random 
+ *                      chunk addresses)
+ *  - chunk           : bytes per call
+ * 
+ * @param	None
+ * 
+ * @return  Nothing 
+ *
+ * @attention : The SPI module is re-initialized with the application 
+ *              configuration once the benchmark is over
+ */
+void StorageBenchmark(void);
+#endif
+
+/**
+ * @brief On-wire self test of the transfer functions (TEST_LOOPBACK)
+ * 
+ * With SDO wired to SDI, every frame received must be the frame sent. Each 
+ * transfer function is run with random data and lengths, every NULL Tx / Rx 
+ * combination, both data formats and both buffer modes. The frames received 
+ * are checked against the data sent, or against the fill frame (0xFF / 
+ * 0xFFFF) when pTxData is NULL. One CSV line is printed per failing case :
+ * 
+ * selftest,func,mode,bits,len,tx,rx,result,first_bad_index
+ * 
+ * then "#selftest,cases=N,errors=M".
+ * 
+ * @param	None
+ * 
+ * @return  Number of failing cases
+ *
+ * @attention : The SPI module is re-initialized with the application 
+ *              configuration once the test is over
+ */
+uint16_t SelfTest(void);
+
+#if SPI_USE_TRACE
+/**
+ * @brief Prints the records of the trace ring as CSV lines (SPI_USE_TRACE)
+ * 
+ * trace,module,tag,op,start,end,len,result,data
+ * 
+ *  - start, end      : Timer2/3 values (cycles)
+ *  - data            : first bytes sent, in hex
+ * 
+ * then "#trace_lost,N" when records were lost. The lines are decoded on the 
+ * host by tools/spi_trace_decode.c.
+ * 
+ * @param	None
+ * 
+ * @return  Nothing 
+ */
+void TraceDump(void);
+#endif
+
 /**
  * @brief  
  * 
@@ -0,0 +1,21 @@
+/**
+ * @file    libpic30.h
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Host replacement of <libpic30.h> : delays advance the simulated time
+ *
+ * FCY must be defined before inclusion, as with the XC16 header.
+ *
+ */
+
+#ifndef	__SIM_LIBPIC30_H__
+#define	__SIM_LIBPIC30_H__
+#include <stdint.h>
+
+void    sim_delay(uint64_t nbCycles);
+
+#define __delay32(n)        sim_delay((uint64_t)(n))
+#define __delay_ms(d)       sim_delay((uint64_t)(d) * (FCY / 1000UL))
+#define __delay_us(d)       sim_delay((uint64_t)(d) * (FCY / 1000000UL))
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file    sim_board.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Wiring of the test application (Test_lib_spi_pic24_ll_main.c) on the simulator
+ *
+ * Built with the options of the application :
+ *  - TEST_LOOPBACK       : SDO of SPI_MODULE wired to SDI
+ *  - BENCH_SLAVE_MODULE  : SPI_MODULE wired to BENCH_SLAVE_MODULE (master -> slave)
+ *  - BENCH_STORAGE       : 25 series flash and SD card on SPI_MODULE
+ *
+ */
+
+#include "spi_sim.h"
+#include "lib_test_lib_spi_pic24_ll.h"
+
+/* Declarations des variables globales 	*/
+#ifdef TEST_LOOPBACK
+static sim_loopback_t   simBoardLoopback;
+#endif
+#ifdef BENCH_STORAGE
+static sim_flash_t      simBoardFlash;
+static sim_sdcard_t     simBoardSd;
+#endif
+
+/*	Implementation du code */
+__attribute__((constructor(102))) static void sim_board(void){
+#ifdef TEST_LOOPBACK
+    sim_loopback_init(&simBoardLoopback, NULL, 0);
+    sim_attach(SPI_MODULE, &simBoardLoopback.dev);
+#endif
+#ifdef BENCH_SLAVE_MODULE
+    sim_link(SPI_MODULE, BENCH_SLAVE_MODULE, NULL, 0);
+#endif
+#ifdef BENCH_STORAGE
+    LATB |= BENCH_FLASH_CS_MASK | BENCH_SD_CS_MASK;
+    sim_flash_init(&simBoardFlash, &LATB, BENCH_FLASH_CS_MASK);
+    sim_sdcard_init(&simBoardSd, &LATB, BENCH_SD_CS_MASK);
+    sim_attach(SPI_MODULE, &simBoardFlash.dev);
+    sim_attach(SPI_MODULE, &simBoardSd.dev);
+#endif
+}
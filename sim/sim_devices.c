@@ -0,0 +1,355 @@
+/**
+ * @file    sim_devices.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Device models of the SPI simulator (see spi_sim.h)
+ *
+ */
+
+#include <string.h>
+#include "spi_sim.h"
+
+/* Directives de compilation - Macros		*/
+#define SIM_REGDEV_READ     0x80    /**< Address frame : read */
+#define SIM_FLASH_WIP       0x01
+#define SIM_FLASH_WEL       0x02
+#define SIM_SD_CMD          0       /**< sim_sdcard_t.state */
+#define SIM_SD_READ         1
+#define SIM_SD_WRITE        2
+#define SIM_SD_R1_IDLE      0x01
+#define SIM_SD_R1_ILLEGAL   0x04
+#define SIM_SD_R1_PARAM     0x40
+
+/*	Implementation du code */
+static uint16_t sim_loopback_frame(sim_device_t *pDev, uint16_t mosi, uint8_t bits){
+    (void)pDev;
+    (void)bits;
+    return mosi;
+}
+//------------------------------------------------------------------------------
+void sim_loopback_init(sim_loopback_t *pDev, volatile uint16_t *pLat, uint16_t csMask){
+    memset(pDev, 0, sizeof(*pDev));
+    pDev->dev.pfFrame = sim_loopback_frame;
+    pDev->dev.pLat = pLat;
+    pDev->dev.csMask = csMask;
+}
+//------------------------------------------------------------------------------
+static uint16_t sim_regdev_frame(sim_device_t *pDev, uint16_t mosi, uint8_t bits){
+    sim_regdev_t    *p = (sim_regdev_t*)pDev;
+    uint16_t    miso = 0xFF;
+
+    (void)bits;
+    if (p->frames++ == 0){
+        p->addr = mosi & 0x7F;
+        p->read = (mosi & SIM_REGDEV_READ) != 0;
+        return miso;
+    }
+    if (p->read) miso = p->regs[p->addr];
+    else p->regs[p->addr] = (uint8_t)mosi;
+    if (p->nbLog < SIM_REGDEV_LOG){
+        p->log[p->nbLog].write = !p->read;
+        p->log[p->nbLog].reg = p->addr;
+        p->log[p->nbLog].value = p->regs[p->addr];
+        p->nbLog++;
+    }
+    p->addr = (p->addr + 1) & 0x7F;
+    return miso;
+}
+//------------------------------------------------------------------------------
+static void sim_regdev_select(sim_device_t *pDev, uint8_t selected){
+    (void)selected;
+    ((sim_regdev_t*)pDev)->frames = 0;
+}
+//------------------------------------------------------------------------------
+void sim_regdev_init(sim_regdev_t *pDev, volatile uint16_t *pLat, uint16_t csMask){
+    memset(pDev, 0, sizeof(*pDev));
+    pDev->dev.pfFrame = sim_regdev_frame;
+    pDev->dev.pfSelect = sim_regdev_select;
+    pDev->dev.pLat = pLat;
+    pDev->dev.csMask = csMask;
+}
+/**
+ * 16 bits frames : two bytes, MSB first
+ */
+static uint16_t sim_byte_frames(uint8_t (*pfByte)(sim_device_t *pDev, uint8_t mosi), sim_device_t *pDev, uint16_t mosi, uint8_t bits){
+    uint16_t    miso;
+
+    if (bits != 16) return pfByte(pDev, (uint8_t)mosi);
+    miso = (uint16_t)pfByte(pDev, (uint8_t)(mosi >> 8)) << 8;
+    return miso | pfByte(pDev, (uint8_t)mosi);
+}
+//------------------------------------------------------------------------------
+static uint8_t sim_flash_byte(sim_device_t *pDev, uint8_t mosi){
+    sim_flash_t *p = (sim_flash_t*)pDev;
+    static const uint8_t    id[3] = {0xEF, 0x40, 0x16};
+    uint32_t    idx = p->frames++;
+    uint8_t     status;
+
+    if (idx == 0){
+        p->cmd = mosi;
+        p->addr = 0;
+        if (p->busy && (mosi != 0x05)) p->cmd = 0;     // Busy : status reads only
+        switch (p->cmd){
+            case 0x06: p->wel = 1; break;
+            case 0x05: p->nbStatus++; break;
+            case 0x03:
+            case 0x0B: p->nbReads++; break;
+            default: break;
+        }
+        return 0xFF;
+    }
+    switch (p->cmd){
+        case 0x05:
+            status = (p->busy ? SIM_FLASH_WIP : 0) | (p->wel ? SIM_FLASH_WEL : 0);
+            if (p->busy) p->busy--;
+            return status;
+        case 0x9F:
+            return (idx <= 3) ? id[idx - 1] : 0xFF;
+        case 0x03:
+        case 0x0B:
+        case 0x02:
+        case 0x20:
+            if (idx <= 3){
+                p->addr = (p->addr << 8) | mosi;
+                return 0xFF;
+            }
+            if (p->cmd == 0x0B){
+                if (idx == 4) return 0xFF;  // Dummy byte
+            }
+            else if (p->cmd != 0x03){
+                if ((p->cmd == 0x02) && p->wel){
+                    p->mem[p->addr % SIM_FLASH_SIZE] &= mosi;
+                    p->addr = (p->addr & ~0xFFUL) | ((p->addr + 1) & 0xFF);
+                }
+                return 0xFF;
+            }
+            return p->mem[p->addr++ % SIM_FLASH_SIZE];
+        default:
+            return 0xFF;
+    }
+}
+//------------------------------------------------------------------------------
+static uint16_t sim_flash_frame(sim_device_t *pDev, uint16_t mosi, uint8_t bits){
+    return sim_byte_frames(sim_flash_byte, pDev, mosi, bits);
+}
+//------------------------------------------------------------------------------
+/**
+ * Program / erase started on the CS rising edge
+ */
+static void sim_flash_select(sim_device_t *pDev, uint8_t selected){
+    sim_flash_t *p = (sim_flash_t*)pDev;
+
+    if (selected || (p->frames == 0)) return;
+    if ((p->cmd == 0x02) && p->wel && (p->frames > 4)){
+        p->nbPrograms++;
+        p->busy = p->busyPolls;
+        p->wel = 0;
+    }
+    else if ((p->cmd == 0x20) && p->wel && (p->frames == 4)){
+        memset(&p->mem[p->addr & (SIM_FLASH_SIZE - 1) & ~0xFFFUL], 0xFF, 4096);
+        p->nbErases++;
+        p->busy = p->busyPolls;
+        p->wel = 0;
+    }
+    p->frames = 0;
+}
+//------------------------------------------------------------------------------
+void sim_flash_init(sim_flash_t *pDev, volatile uint16_t *pLat, uint16_t csMask){
+    memset(pDev, 0, sizeof(*pDev));
+    memset(pDev->mem, 0xFF, sizeof(pDev->mem));
+    pDev->busyPolls = 2;
+    pDev->dev.pfFrame = sim_flash_frame;
+    pDev->dev.pfSelect = sim_flash_select;
+    pDev->dev.pLat = pLat;
+    pDev->dev.csMask = csMask;
+}
+//------------------------------------------------------------------------------
+/**
+ * Queues a response : NCR byte, R1, then len bytes
+ */
+static void sim_sd_respond(sim_sdcard_t *p, uint8_t r1, const uint8_t *pData, uint8_t len){
+    p->resp[0] = 0xFF;
+    p->resp[1] = r1;
+    if (len) memcpy(&p->resp[2], pData, len);
+    p->respLen = len + 2;
+    p->respIdx = 0;
+}
+//------------------------------------------------------------------------------
+static void sim_sd_command(sim_sdcard_t *p){
+    uint8_t     idx = p->cmd[0] & 0x3F;
+    uint32_t    arg = ((uint32_t)p->cmd[1] << 24) | ((uint32_t)p->cmd[2] << 16) | ((uint32_t)p->cmd[3] << 8) | p->cmd[4];
+    uint8_t     r1, data[4];
+    uint8_t     appCmd = p->appCmd;
+
+    p->nbCmds++;
+    p->appCmd = 0;
+    r1 = p->idle ? SIM_SD_R1_IDLE : 0;
+    switch (idx){
+        case 0:
+            p->idle = 1;
+            p->state = SIM_SD_CMD;
+            sim_sd_respond(p, SIM_SD_R1_IDLE, NULL, 0);
+            break;
+        case 8:
+            data[0] = 0;
+            data[1] = 0;
+            data[2] = (uint8_t)(arg >> 8) & 0x0F;
+            data[3] = (uint8_t)arg;
+            sim_sd_respond(p, r1, data, 4);
+            break;
+        case 55:
+            p->appCmd = 1;
+            sim_sd_respond(p, r1, NULL, 0);
+            break;
+        case 41:
+            if (!appCmd) sim_sd_respond(p, r1 | SIM_SD_R1_ILLEGAL, NULL, 0);
+            else {
+                if (p->initPolls) p->initPolls--;
+                else p->idle = 0;
+                sim_sd_respond(p, p->idle ? SIM_SD_R1_IDLE : 0, NULL, 0);
+            }
+            break;
+        case 58:
+            data[0] = 0xC0;     // Powered up, CCS (block addressing)
+            data[1] = 0xFF;
+            data[2] = 0x80;
+            data[3] = 0x00;
+            sim_sd_respond(p, r1, data, 4);
+            break;
+        case 16:
+            sim_sd_respond(p, r1, NULL, 0);
+            break;
+        case 12:
+            // Stuff byte, then R1
+            p->state = SIM_SD_CMD;
+            data[0] = r1;
+            sim_sd_respond(p, 0xFF, data, 1);
+            p->busy = p->stopBusy;
+            break;
+        case 17:
+        case 18:
+        case 24:
+        case 25:
+            if (p->idle) r1 |= SIM_SD_R1_ILLEGAL;
+            else if (arg >= SIM_SD_BLOCKS) r1 |= SIM_SD_R1_PARAM;
+            sim_sd_respond(p, r1, NULL, 0);
+            if (r1) break;
+            p->block = arg;
+            p->pos = 0;
+            p->multi = (idx == 18) || (idx == 25);
+            p->state = ((idx == 24) || (idx == 25)) ? SIM_SD_WRITE : SIM_SD_READ;
+            break;
+        default:
+            sim_sd_respond(p, r1 | SIM_SD_R1_ILLEGAL, NULL, 0);
+            break;
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * Data block sent : NAC byte, token 0xFE, 512 bytes, 2 CRC bytes
+ */
+static uint8_t sim_sd_read_byte(sim_sdcard_t *p){
+    uint16_t    pos = p->pos++;
+
+    if (pos == 0) return 0xFF;
+    if (pos == 1) return 0xFE;
+    if (pos == (1 + SIM_SD_BLOCK)) p->nbReadBlocks++;
+    if (pos < (2 + SIM_SD_BLOCK)) return p->mem[p->block][pos - 2];
+    if (pos == (SIM_SD_BLOCK + 3)){
+        p->pos = 0;
+        if (p->multi && ((p->block + 1) < SIM_SD_BLOCKS)) p->block++;
+        else p->state = SIM_SD_CMD;
+    }
+    return 0x00;    // CRC (not checked in SPI mode)
+}
+//------------------------------------------------------------------------------
+/**
+ * Data block received : token 0xFE (CMD24) or 0xFC (CMD25), 512 bytes, 2 CRC
+ * bytes, then data response 0x05 (accepted) and busy. CMD25 : blocks until
+ * the stop token 0xFD (busy after it).
+ */
+static void sim_sd_write_byte(sim_sdcard_t *p, uint8_t mosi){
+    uint16_t    pos = p->pos;
+
+    if (pos == 0){
+        if (mosi == (p->multi ? 0xFC : 0xFE)) p->pos++;
+        else if (p->multi && (mosi == 0xFD)){
+            p->nbStops++;
+            p->busy = p->busyFrames;
+            p->state = SIM_SD_CMD;
+        }
+        return;
+    }
+    p->pos++;
+    if (pos <= SIM_SD_BLOCK) p->wbuf[pos - 1] = mosi;
+    else if (pos == (SIM_SD_BLOCK + 2)){
+        // Block out of the card (CMD25 run) : write error 0x0D
+        if (p->block < SIM_SD_BLOCKS){
+            memcpy(p->mem[p->block], p->wbuf, SIM_SD_BLOCK);
+            p->nbWriteBlocks++;
+            p->resp[0] = 0x05;
+            p->busy = p->busyFrames;
+        }
+        else p->resp[0] = 0x0D;
+        p->respLen = 1;
+        p->respIdx = 0;
+        p->pos = 0;
+        if (p->multi) p->block++;
+        else p->state = SIM_SD_CMD;
+    }
+}
+//------------------------------------------------------------------------------
+static uint8_t sim_sd_byte(sim_device_t *pDev, uint8_t mosi){
+    sim_sdcard_t    *p = (sim_sdcard_t*)pDev;
+    uint8_t     miso = 0xFF;
+
+    if (p->respIdx < p->respLen) miso = p->resp[p->respIdx++];
+    else if (p->state == SIM_SD_READ) miso = sim_sd_read_byte(p);
+    else if (p->busy){
+        p->busy--;
+        miso = 0x00;
+    }
+    if (p->state == SIM_SD_WRITE){
+        sim_sd_write_byte(p, mosi);
+        return miso;
+    }
+    // Command frames (also accepted during a multiple block read : CMD12)
+    if (p->cmdLen || ((mosi & 0xC0) == 0x40)){
+        p->cmd[p->cmdLen++] = mosi;
+        if (p->cmdLen == 6){
+            p->cmdLen = 0;
+            sim_sd_command(p);
+        }
+    }
+    return miso;
+}
+//------------------------------------------------------------------------------
+static uint16_t sim_sd_frame(sim_device_t *pDev, uint16_t mosi, uint8_t bits){
+    return sim_byte_frames(sim_sd_byte, pDev, mosi, bits);
+}
+//------------------------------------------------------------------------------
+/**
+ * CS released : pending command and response dropped, a write in progress
+ * goes on (busy), a CMD25 run waits for its next block
+ */
+static void sim_sd_select(sim_device_t *pDev, uint8_t selected){
+    sim_sdcard_t    *p = (sim_sdcard_t*)pDev;
+
+    if (selected) return;
+    p->cmdLen = 0;
+    p->respLen = 0;
+    p->respIdx = 0;
+    p->pos = 0;
+    if ((p->state != SIM_SD_WRITE) || !p->multi) p->state = SIM_SD_CMD;
+}
+//------------------------------------------------------------------------------
+void sim_sdcard_init(sim_sdcard_t *pDev, volatile uint16_t *pLat, uint16_t csMask){
+    memset(pDev, 0, sizeof(*pDev));
+    pDev->initPolls = 3;
+    pDev->busyFrames = 16;
+    pDev->dev.pfFrame = sim_sd_frame;
+    pDev->dev.pfSelect = sim_sd_select;
+    pDev->dev.pLat = pLat;
+    pDev->dev.csMask = csMask;
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,756 @@
+/**
+ * @file    spi_sim.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Host model of the PIC24 SPI modules (see spi_sim.h)
+ *
+ * Linux x86-64 only : the page fault error code (read / write) and the trap
+ * flag are taken from / set in the ucontext of the signal handlers.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include "spi_sim.h"
+
+/* Directives de compilation - Macros		*/
+#ifndef FCY
+#define FCY     4000000UL
+#endif
+#define SIM_EFLAGS_TF   0x0100      /**< x86 trap flag */
+#define SIM_PF_WRITE    0x0002      /**< Page fault error code : write access */
+#define SIM_FIFO_DEPTH  8
+#define SIM_TICK_US     100
+
+// SPIxSTAT, SPIxCON1, SPIxCON2 (PIC24 family reference manual, section 23)
+#define STAT_SPIEN      0x8000
+#define STAT_SPISIDL    0x2000
+#define STAT_SRMPT      0x0080
+#define STAT_SPIROV     0x0040
+#define STAT_SRXMPT     0x0020
+#define STAT_SISEL      0x001C
+#define STAT_SPITBF     0x0002
+#define STAT_SPIRBF     0x0001
+#define STAT_WRITABLE   (STAT_SPIEN | STAT_SPISIDL | STAT_SISEL)
+#define CON1_MODE16     0x0400
+#define CON1_SSEN       0x0080
+#define CON1_MSTEN      0x0020
+#define CON2_SPIBEN     0x0001
+
+// SISEL : SPIxIF events of the enhanced buffer mode
+#define SIM_SISEL_RX_EMPTY      0   /**< Last data of the Rx FIFO read */
+#define SIM_SISEL_RX_NOT_EMPTY  1   /**< Data available in the Rx FIFO */
+#define SIM_SISEL_RX_6          2   /**< 6 data or more in the Rx FIFO */
+#define SIM_SISEL_RX_FULL       3   /**< Rx FIFO full */
+#define SIM_SISEL_TX_ONE        4   /**< One data moved to the shift register */
+#define SIM_SISEL_SHIFT_DONE    5   /**< Last bit shifted out, Tx FIFO empty */
+#define SIM_SISEL_TX_EMPTY      6   /**< Last data moved to the shift register */
+#define SIM_SISEL_TX_SPACE      7   /**< Tx FIFO not full */
+
+/** Type sim_spi_t
+ *
+ * One SPI module : registers, interrupt bits and state of the model
+ */
+typedef struct {
+    volatile uint16_t   *pStat, *pCon1, *pCon2, *pBuf;
+    volatile uint16_t   *pIfs, *pIec, *pIpc;
+    uint16_t    itMask;         /**< SPIxIF / SPIxIE bit */
+    uint8_t     ipShift;        /**< SPIxIP position */
+    void        (*pfIsr)(void);
+    uint16_t    stat;           /**< Writable SPIxSTAT bits */
+    uint8_t     rov;
+    uint16_t    tx[SIM_FIFO_DEPTH];
+    uint8_t     txHead, txCount;
+    uint16_t    rx[SIM_FIFO_DEPTH];
+    uint8_t     rxHead, rxCount;
+    uint16_t    bufLast;        /**< Value read from an empty SPIxBUF */
+    uint8_t     busy;           /**< Master : frame being shifted, ends at end */
+    uint8_t     slaveBusy;      /**< Slave : frame of the linked master being shifted */
+    uint64_t    end;
+    uint16_t    mosi, miso;
+    uint16_t    sr;             /**< Slave : shift register (last frame received) */
+    int8_t      link;           /**< Master : slave module wired to it, -1 : none */
+    volatile uint16_t   *pLinkLat;
+    uint16_t    linkMask;
+    uint8_t     linkSelected;
+    sim_device_t    *pDevs;
+    } sim_spi_t;
+
+/* Declarations des variables globales 	*/
+sim_sfr_t   simSfr __attribute__((aligned(4096)));
+sim_io_t    simIo;
+int         __C30_UART;
+
+extern void _SPI1Interrupt(void) __attribute__((weak));
+extern void _SPI2Interrupt(void) __attribute__((weak));
+extern void _SPI3Interrupt(void) __attribute__((weak));
+extern char __executable_start, etext;  // Text of the program (tick : code interrupted)
+
+static sim_spi_t    simSpi[SIM_NB_MODULES];
+static uint64_t     simNow;             /**< Cycles */
+static uint64_t     simPending;         /**< Cycles of the writes not yet applied (see sim_pre_access) */
+static uint64_t     simIdle;
+static uint64_t     simAccesses, simTickAccesses;
+static uint64_t     simDisiEnd;
+static uint64_t     simRunLimit;
+static uint32_t     simWarnings;
+static uint8_t      simFifo = 1;
+static uint8_t      simLog;
+static int          simOpen;            /**< Page accessible (nesting count) */
+static volatile int simBusy;            /**< Model API running : no tick */
+static sim_access_hook_t    pfSimHook;
+
+static uint64_t     simTmrBase;         /**< Timer2/3 : simNow when the timer was 0 */
+static uint32_t     simTmrFrozen;       /**< Timer2/3 : value while stopped */
+
+static struct {
+    volatile uint16_t   *pReg;
+    uint16_t    old;            /**< Value before the access */
+    uint8_t     write;
+    uint8_t     alrmBlocked;
+    } simAcc;                           /**< Access being single stepped */
+
+static struct {
+    uintptr_t   rip;
+    volatile uint16_t   *pReg;
+    uint8_t     write;
+    uint16_t    value;
+    } simLast;                          /**< Previous access (poll detection) */
+
+#define SIM_REG(r)      {&r, #r}
+static const struct {
+    volatile uint16_t   *pReg;
+    const char  *pName;
+    } simRegs[] = {
+    SIM_REG(SPI1STAT), SIM_REG(SPI1CON1), SIM_REG(SPI1CON2), SIM_REG(SPI1BUF),
+    SIM_REG(SPI2STAT), SIM_REG(SPI2CON1), SIM_REG(SPI2CON2), SIM_REG(SPI2BUF),
+    SIM_REG(SPI3STAT), SIM_REG(SPI3CON1), SIM_REG(SPI3CON2), SIM_REG(SPI3BUF),
+    SIM_REG(IFS0), SIM_REG(IFS2), SIM_REG(IFS5), SIM_REG(IEC0), SIM_REG(IEC2), SIM_REG(IEC5),
+    SIM_REG(IPC2), SIM_REG(IPC8), SIM_REG(IPC22), SIM_REG(SR),
+    SIM_REG(T2CON), SIM_REG(T3CON), SIM_REG(TMR2), SIM_REG(TMR3), SIM_REG(TMR3HLD), SIM_REG(PR2), SIM_REG(PR3),
+    SIM_REG(LATA), SIM_REG(LATB), SIM_REG(LATC), SIM_REG(LATD), SIM_REG(LATE), SIM_REG(LATF), SIM_REG(LATG),
+    };
+#define SIM_NB_REGS     (sizeof(simRegs) / sizeof(simRegs[0]))
+
+/*	Implementation du code */
+static void sim_open(void){
+    if (simOpen++ == 0) mprotect(simSfr.simPage, sizeof(simSfr), PROT_READ | PROT_WRITE);
+}
+//------------------------------------------------------------------------------
+static void sim_close(void){
+    if (--simOpen == 0) mprotect(simSfr.simPage, sizeof(simSfr), PROT_NONE);
+}
+//------------------------------------------------------------------------------
+static const char *sim_reg_name(volatile uint16_t *pReg){
+    uint8_t i;
+
+    for (i = 0; i < SIM_NB_REGS; i++) if (simRegs[i].pReg == pReg) return simRegs[i].pName;
+    return "?";
+}
+//------------------------------------------------------------------------------
+static uint8_t sim_depth(sim_spi_t *p){
+    return (*p->pCon2 & CON2_SPIBEN) ? SIM_FIFO_DEPTH : 1;
+}
+//------------------------------------------------------------------------------
+/**
+ * Cycles per bit : primary (SPIxCON1[1:0]) x secondary (SPIxCON1[4:2]) prescaler
+ */
+static uint16_t sim_bit_cycles(uint16_t con1){
+    static const uint8_t pri[] = {64, 16, 4, 1};
+
+    return pri[con1 & 0x03] * (8 - ((con1 >> 2) & 0x07));
+}
+//------------------------------------------------------------------------------
+static void sim_set_if(sim_spi_t *p){
+    *p->pIfs |= p->itMask;
+}
+//------------------------------------------------------------------------------
+static uint8_t sim_sisel(sim_spi_t *p){
+    return (p->stat & STAT_SISEL) >> 2;
+}
+//------------------------------------------------------------------------------
+/**
+ * A data left the Tx FIFO (frame start)
+ */
+static void sim_tx_events(sim_spi_t *p){
+    if (sim_depth(p) == 1) return;
+    switch (sim_sisel(p)){
+        case SIM_SISEL_TX_ONE:
+        case SIM_SISEL_TX_SPACE:    sim_set_if(p); break;
+        case SIM_SISEL_TX_EMPTY:    if (p->txCount == 0) sim_set_if(p); break;
+        default:                break;
+    }
+}
+//------------------------------------------------------------------------------
+static void sim_rx_push(sim_spi_t *p, uint16_t value){
+    uint8_t depth = sim_depth(p);
+
+    if (p->rxCount >= depth) p->rov = 1;    // Frame lost
+    else p->rx[(p->rxHead + p->rxCount++) % SIM_FIFO_DEPTH] = value;
+    if (depth == 1){
+        sim_set_if(p);      // Standard buffer : every frame
+        return;
+    }
+    switch (sim_sisel(p)){
+        case SIM_SISEL_RX_NOT_EMPTY:    sim_set_if(p); break;
+        case SIM_SISEL_RX_6:            if (p->rxCount >= 6) sim_set_if(p); break;
+        case SIM_SISEL_RX_FULL:         if (p->rxCount == depth) sim_set_if(p); break;
+        default:                    break;
+    }
+}
+//------------------------------------------------------------------------------
+static void sim_spi_flush(sim_spi_t *p){
+    p->txHead = p->txCount = 0;
+    p->rxHead = p->rxCount = 0;
+    p->busy = p->slaveBusy = 0;
+    p->rov = 0;
+}
+//------------------------------------------------------------------------------
+/**
+ * Slave side of a frame of the linked master : returns MISO
+ */
+static uint16_t sim_slave_begin(sim_spi_t *pMaster, sim_spi_t *p){
+    uint16_t    con1 = *p->pCon1;
+
+    if (!(p->stat & STAT_SPIEN) || (con1 & CON1_MSTEN)) return 0xFFFF;
+    if ((con1 & CON1_SSEN) && !pMaster->linkSelected) return 0xFFFF;
+    if (p->txCount){
+        p->sr = p->tx[p->txHead];
+        p->txHead = (p->txHead + 1) % SIM_FIFO_DEPTH;
+        p->txCount--;
+        sim_tx_events(p);
+    }
+    p->slaveBusy = 1;
+    return p->sr;
+}
+//------------------------------------------------------------------------------
+static void sim_spi_start(sim_spi_t *p){
+    uint16_t    con1 = *p->pCon1;
+    uint16_t    mask = (con1 & CON1_MODE16) ? 0xFFFF : 0x00FF;
+    uint8_t     bits = (con1 & CON1_MODE16) ? 16 : 8;
+    sim_device_t    *pDev;
+
+    if (!(p->stat & STAT_SPIEN) || !(con1 & CON1_MSTEN) || p->busy || !p->txCount) return;
+    p->mosi = p->tx[p->txHead] & mask;
+    p->txHead = (p->txHead + 1) % SIM_FIFO_DEPTH;
+    p->txCount--;
+    p->busy = 1;
+    p->end = simNow + simPending + (uint64_t)bits * sim_bit_cycles(con1);
+    p->miso = mask;
+    for (pDev = p->pDevs; pDev != NULL; pDev = pDev->pNext){
+        if (pDev->selected) p->miso &= pDev->pfFrame(pDev, p->mosi, bits);
+    }
+    if (p->link >= 0) p->miso &= sim_slave_begin(p, &simSpi[p->link]);
+    sim_tx_events(p);
+}
+//------------------------------------------------------------------------------
+static void sim_frame_end(sim_spi_t *p){
+    sim_spi_t   *pSlave;
+
+    p->busy = 0;
+    sim_rx_push(p, p->miso);
+    if ((p->link >= 0) && simSpi[p->link].slaveBusy){
+        pSlave = &simSpi[p->link];
+        pSlave->slaveBusy = 0;
+        pSlave->sr = p->mosi & ((*pSlave->pCon1 & CON1_MODE16) ? 0xFFFF : 0x00FF);
+        sim_rx_push(pSlave, pSlave->sr);
+        if ((sim_depth(pSlave) > 1) && (sim_sisel(pSlave) == SIM_SISEL_SHIFT_DONE) && !pSlave->txCount) sim_set_if(pSlave);
+    }
+    sim_spi_start(p);
+    if ((sim_depth(p) > 1) && (sim_sisel(p) == SIM_SISEL_SHIFT_DONE) && !p->busy) sim_set_if(p);
+}
+//------------------------------------------------------------------------------
+static sim_spi_t *sim_next_event(void){
+    sim_spi_t   *pNext = NULL;
+    uint8_t     m;
+
+    for (m = 0; m < SIM_NB_MODULES; m++){
+        if (simSpi[m].busy && ((pNext == NULL) || (simSpi[m].end < pNext->end))) pNext = &simSpi[m];
+    }
+    return pNext;
+}
+//------------------------------------------------------------------------------
+/**
+ * Processes the events up to the cycle t (page open)
+ */
+static void sim_advance(uint64_t t){
+    sim_spi_t   *p;
+
+    while (((p = sim_next_event()) != NULL) && (p->end <= t)){
+        if (p->end > simNow) simNow = p->end;
+        sim_frame_end(p);
+    }
+    if (t > simNow) simNow = t;
+}
+//------------------------------------------------------------------------------
+static void sim_apply_pending(void){
+    sim_advance(simNow + simPending);
+    simPending = 0;
+}
+//------------------------------------------------------------------------------
+static const uint16_t   simTmrPs[] = {1, 8, 64, 256};     /**< TCKPS */
+
+static uint32_t sim_timer(void){
+    uint32_t    value;
+
+    if (!T2CONbits.TON) return simTmrFrozen;
+    value = (uint32_t)((simNow - simTmrBase) / simTmrPs[T2CONbits.TCKPS]);
+    if (!T2CONbits.T32) value %= (uint32_t)PR2 + 1;
+    return value;
+}
+//------------------------------------------------------------------------------
+static void sim_timer_set(uint32_t value){
+    simTmrFrozen = value;
+    simTmrBase = simNow - ((uint64_t)value * simTmrPs[T2CONbits.TCKPS]);
+}
+//------------------------------------------------------------------------------
+static uint16_t sim_stat(sim_spi_t *p){
+    uint8_t     depth = sim_depth(p);
+    uint16_t    stat = p->stat;
+
+    if (p->rov) stat |= STAT_SPIROV;
+    if (p->txCount >= depth) stat |= STAT_SPITBF;
+    if (p->rxCount >= depth) stat |= STAT_SPIRBF;
+    if (depth > 1){
+        stat |= (uint16_t)(p->txCount & 0x07) << 8;     // SPIBEC
+        if (!p->busy && !p->slaveBusy && !p->txCount) stat |= STAT_SRMPT;
+        if (!p->rxCount) stat |= STAT_SRXMPT;
+    }
+    return stat;
+}
+//------------------------------------------------------------------------------
+/**
+ * Updates the register before it is accessed (page open)
+ */
+static void sim_refresh(volatile uint16_t *pReg, uint8_t write){
+    sim_spi_t   *p;
+    uint32_t    tmr;
+
+    for (p = simSpi; p < simSpi + SIM_NB_MODULES; p++){
+        if (pReg == p->pStat) *pReg = sim_stat(p);
+        else if ((pReg == p->pBuf) && !write) *pReg = p->rxCount ? p->rx[p->rxHead] : p->bufLast;
+    }
+    if (pReg == &TMR2){
+        tmr = sim_timer();
+        TMR2 = (uint16_t)tmr;
+        TMR3HLD = (uint16_t)(tmr >> 16);
+    }
+    else if (pReg == &TMR3) TMR3 = (uint16_t)(sim_timer() >> 16);
+}
+//------------------------------------------------------------------------------
+static uint8_t sim_is_status(volatile uint16_t *pReg){
+    uint8_t     m;
+
+    if ((pReg == &IFS0) || (pReg == &IFS2) || (pReg == &IFS5)) return 1;
+    for (m = 0; m < SIM_NB_MODULES; m++) if (pReg == simSpi[m].pStat) return 1;
+    return 0;
+}
+//------------------------------------------------------------------------------
+/**
+ * Before the access : time advanced (reads only), register updated
+ *
+ * The writes are charged at the next read : a read-modify-write of an
+ * interrupt flag register then never loses a flag raised between the read
+ * and the write.
+ */
+static void sim_pre_access(uintptr_t rip){
+    volatile uint16_t   *pReg = simAcc.pReg;
+    sim_spi_t   *pNext;
+    uint64_t    steps;
+
+    simAccesses++;
+    if (simAcc.write){
+        simPending += SIM_ACCESS_CYCLES;
+        sim_refresh(pReg, 1);
+        simLast.write = 1;
+        return;
+    }
+    simPending += SIM_ACCESS_CYCLES;
+    sim_apply_pending();
+    sim_refresh(pReg, 0);
+    // Same status register polled by the same instruction : next event
+    if ((rip == simLast.rip) && (pReg == simLast.pReg) && !simLast.write &&
+        (*pReg == simLast.value) && sim_is_status(pReg) && ((pNext = sim_next_event()) != NULL)){
+        steps = (pNext->end - simNow + SIM_ACCESS_CYCLES - 1) / SIM_ACCESS_CYCLES;
+        sim_advance(simNow + (steps * SIM_ACCESS_CYCLES));
+        sim_refresh(pReg, 0);
+    }
+    simLast.rip = rip;
+    simLast.pReg = pReg;
+    simLast.write = 0;
+    simLast.value = *pReg;
+}
+//------------------------------------------------------------------------------
+static void sim_cs_update(volatile uint16_t *pLat){
+    sim_spi_t   *p;
+    sim_device_t    *pDev;
+    uint8_t     selected;
+
+    for (p = simSpi; p < simSpi + SIM_NB_MODULES; p++){
+        for (pDev = p->pDevs; pDev != NULL; pDev = pDev->pNext){
+            if (pDev->pLat != pLat) continue;
+            selected = !(*pLat & pDev->csMask);
+            if (selected == pDev->selected) continue;
+            pDev->selected = selected;
+            if (pDev->pfSelect != NULL) pDev->pfSelect(pDev, selected);
+        }
+        if (p->pLinkLat == pLat) p->linkSelected = !(*pLat & p->linkMask);
+    }
+}
+//------------------------------------------------------------------------------
+/**
+ * After the access : side effects (page open)
+ */
+static void sim_post_access(void){
+    volatile uint16_t   *pReg = simAcc.pReg;
+    uint16_t    value = *pReg;
+    sim_spi_t   *p;
+
+    for (p = simSpi; p < simSpi + SIM_NB_MODULES; p++){
+        if (pReg == p->pStat){
+            if (!simAcc.write) break;
+            if ((p->stat & STAT_SPIEN) && !(value & STAT_SPIEN)) sim_spi_flush(p);
+            p->stat = value & STAT_WRITABLE;
+            if (!(value & STAT_SPIROV)) p->rov = 0;
+            sim_spi_start(p);
+        }
+        else if ((pReg == p->pCon1) || (pReg == p->pCon2)){
+            if (!simAcc.write) break;
+            if (p->busy || p->slaveBusy || (p->stat & STAT_SPIEN)) simWarnings++;
+            if (!simFifo) *p->pCon2 &= ~CON2_SPIBEN;
+        }
+        else if (pReg == p->pBuf){
+            if (simAcc.write){
+                if ((p->stat & STAT_SPIEN) && (p->txCount < sim_depth(p))){
+                    p->tx[(p->txHead + p->txCount++) % SIM_FIFO_DEPTH] = value;
+                    sim_spi_start(p);
+                }
+            }
+            else if (p->rxCount){
+                p->bufLast = p->rx[p->rxHead];
+                p->rxHead = (p->rxHead + 1) % SIM_FIFO_DEPTH;
+                p->rxCount--;
+                if ((sim_depth(p) > 1) && (sim_sisel(p) == SIM_SISEL_RX_EMPTY) && !p->rxCount) sim_set_if(p);
+            }
+        }
+        else continue;
+        break;
+    }
+    if (simAcc.write){
+        if ((pReg >= &LATA) && (pReg <= &LATG)) sim_cs_update(pReg);
+        else if (pReg == &TMR2) sim_timer_set((sim_timer() & 0xFFFF0000UL) | value);
+        else if (pReg == &TMR3) sim_timer_set((sim_timer() & 0x0000FFFFUL) | ((uint32_t)value << 16));
+        else if ((pReg == &T2CON) && ((value ^ simAcc.old) & 0x8000)){
+            if (T2CONbits.TON) sim_timer_set(simTmrFrozen);     // Started : counts from its value
+            else {
+                T2CON = simAcc.old;
+                simTmrFrozen = sim_timer();                     // Stopped : value kept
+                T2CON = value;
+            }
+        }
+    }
+    if (simLog) fprintf(stderr, "%10llu %c %-8s 0x%04X\n", (unsigned long long)simNow, simAcc.write ? 'W' : 'R', sim_reg_name(pReg), value);
+    if (pfSimHook != NULL) pfSimHook(sim_reg_name(pReg), value, simAcc.write);
+}
+//------------------------------------------------------------------------------
+static uint8_t sim_disi_active(void){
+    return (simDisiEnd != 0) && (simNow + simPending < simDisiEnd);
+}
+//------------------------------------------------------------------------------
+/**
+ * Vectors the pending interrupts (page closed)
+ */
+static void sim_dispatch(void){
+    sim_spi_t   *p, *pBest;
+    uint16_t    ipl, ip, bestIp;
+
+    for (;;){
+        sim_open();
+        ipl = SRbits.IPL;
+        pBest = NULL;
+        bestIp = 0;
+        if (!sim_disi_active()){
+            for (p = simSpi; p < simSpi + SIM_NB_MODULES; p++){
+                if (!(*p->pIfs & *p->pIec & p->itMask)) continue;
+                ip = (*p->pIpc >> p->ipShift) & 0x07;
+                if ((ip > ipl) && (ip > bestIp)){
+                    pBest = p;
+                    bestIp = ip;
+                }
+            }
+        }
+        if (pBest == NULL){
+            sim_close();
+            return;
+        }
+        if (pBest->pfIsr == NULL){
+            fprintf(stderr, "sim: SPI%u interrupt without ISR\n", (unsigned)(pBest - simSpi) + 1);
+            abort();
+        }
+        SRbits.IPL = bestIp;
+        sim_close();
+        pBest->pfIsr();
+        sim_open();
+        SRbits.IPL = ipl;
+        sim_close();
+    }
+}
+//------------------------------------------------------------------------------
+static void sim_segv(int sig, siginfo_t *pInfo, void *pCtx){
+    ucontext_t  *pUc = pCtx;
+    uint8_t     *pAddr = pInfo->si_addr;
+
+    if ((pAddr < simSfr.simPage) || (pAddr >= simSfr.simPage + sizeof(simSfr)) || simOpen){
+        signal(sig, SIG_DFL);   // Genuine fault : default action when the access is retried
+        return;
+    }
+    sim_open();
+    simAcc.pReg = (volatile uint16_t*)(simSfr.simPage + ((pAddr - simSfr.simPage) & ~1));
+    simAcc.write = (pUc->uc_mcontext.gregs[REG_ERR] & SIM_PF_WRITE) != 0;
+    sim_pre_access((uintptr_t)pUc->uc_mcontext.gregs[REG_RIP]);
+    simAcc.old = *simAcc.pReg;
+    // Single steps the access with the page open, no tick meanwhile
+    pUc->uc_mcontext.gregs[REG_EFL] |= SIM_EFLAGS_TF;
+    simAcc.alrmBlocked = sigismember(&pUc->uc_sigmask, SIGALRM);
+    sigaddset(&pUc->uc_sigmask, SIGALRM);
+}
+//------------------------------------------------------------------------------
+static void sim_trap(int sig, siginfo_t *pInfo, void *pCtx){
+    ucontext_t  *pUc = pCtx;
+
+    (void)pInfo;
+    if (!(pUc->uc_mcontext.gregs[REG_EFL] & SIM_EFLAGS_TF) || (simOpen == 0)){
+        signal(sig, SIG_DFL);
+        return;
+    }
+    pUc->uc_mcontext.gregs[REG_EFL] &= ~SIM_EFLAGS_TF;
+    if (!simAcc.alrmBlocked) sigdelset(&pUc->uc_sigmask, SIGALRM);
+    sim_post_access();
+    sim_close();
+    sim_dispatch();
+}
+//------------------------------------------------------------------------------
+/**
+ * Tick : a program spinning on RAM only (no trapped access since the last
+ * tick) jumps to the next event, and the interrupts are vectored
+ */
+static void sim_tick(int sig){
+    sim_spi_t   *pNext;
+
+    (void)sig;
+    if (simBusy || simOpen) return;
+    if (simAccesses != simTickAccesses){
+        simTickAccesses = simAccesses;
+        return;
+    }
+    sim_open();
+    sim_apply_pending();
+    if ((pNext = sim_next_event()) != NULL) sim_advance(pNext->end);
+    sim_close();
+    sim_dispatch();
+}
+//------------------------------------------------------------------------------
+static void sim_tick_handler(int sig, siginfo_t *pInfo, void *pCtx){
+    ucontext_t  *pUc = pCtx;
+    uintptr_t   rip = (uintptr_t)pUc->uc_mcontext.gregs[REG_RIP];
+
+    (void)pInfo;
+    // Only the program code may be interrupted (not libc, not the model)
+    if ((rip < (uintptr_t)&__executable_start) || (rip >= (uintptr_t)&etext)) return;
+    sim_tick(sig);
+}
+//------------------------------------------------------------------------------
+static void sim_report(void){
+    printf("#sim,cycles=%llu,idle_cycles=%llu,accesses=%llu,warnings=%lu\n",
+            (unsigned long long)simNow, (unsigned long long)simIdle,
+            (unsigned long long)simAccesses, (unsigned long)simWarnings);
+}
+//------------------------------------------------------------------------------
+void sim_reset(void){
+    static const struct {
+        volatile uint16_t   *pStat, *pIfs, *pIec, *pIpc;
+        uint16_t    itMask;
+        uint8_t     ipShift;
+        } map[SIM_NB_MODULES] = {
+            {&SPI1STAT, &IFS0, &IEC0, &IPC2, 0x0400, 8},
+            {&SPI2STAT, &IFS2, &IEC2, &IPC8, 0x0002, 4},
+            {&SPI3STAT, &IFS5, &IEC5, &IPC22, 0x0100, 0},
+        };
+    uint8_t     m;
+
+    simBusy++;
+    sim_open();
+    memset(simSfr.simPage, 0, sizeof(simSfr));
+    memset(simSpi, 0, sizeof(simSpi));
+    IPC2 = IPC8 = IPC22 = 0x4444;   // Reset value : priority 4
+    for (m = 0; m < SIM_NB_MODULES; m++){
+        simSpi[m].pStat = map[m].pStat;
+        simSpi[m].pCon1 = map[m].pStat + 1;
+        simSpi[m].pCon2 = map[m].pStat + 2;
+        simSpi[m].pBuf = map[m].pStat + 3;
+        simSpi[m].pIfs = map[m].pIfs;
+        simSpi[m].pIec = map[m].pIec;
+        simSpi[m].pIpc = map[m].pIpc;
+        simSpi[m].itMask = map[m].itMask;
+        simSpi[m].ipShift = map[m].ipShift;
+        simSpi[m].link = -1;
+    }
+    simSpi[0].pfIsr = _SPI1Interrupt;
+    simSpi[1].pfIsr = _SPI2Interrupt;
+    simSpi[2].pfIsr = _SPI3Interrupt;
+    simDisiEnd = 0;
+    simTmrFrozen = 0;
+    simLast.pReg = NULL;
+    sim_close();
+    simBusy--;
+}
+//------------------------------------------------------------------------------
+__attribute__((constructor(101))) static void sim_init(void){
+    struct sigaction    sa;
+    struct itimerval    tick;
+    const char  *pEnv;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, SIGALRM);
+    sa.sa_sigaction = sim_segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = sim_trap;
+    sigaction(SIGTRAP, &sa, NULL);
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sa.sa_sigaction = sim_tick_handler;
+    sigaction(SIGALRM, &sa, NULL);
+
+    sim_reset();
+    if ((pEnv = getenv("SIM_RUN_MS")) != NULL) simRunLimit = strtoull(pEnv, NULL, 0) * (FCY / 1000UL);
+    if ((pEnv = getenv("SIM_LOG")) != NULL) simLog = (uint8_t)atoi(pEnv);
+    pEnv = getenv("SIM_TICK_US");
+    memset(&tick, 0, sizeof(tick));
+    tick.it_interval.tv_usec = (pEnv != NULL) ? atol(pEnv) : SIM_TICK_US;
+    tick.it_value = tick.it_interval;
+    setitimer(ITIMER_REAL, &tick, NULL);
+    mprotect(simSfr.simPage, sizeof(simSfr), PROT_NONE);
+    atexit(sim_report);
+}
+//------------------------------------------------------------------------------
+void sim_attach(uint8_t module, sim_device_t *pDev){
+    sim_device_t    **ppDev = &simSpi[module].pDevs;
+
+    simBusy++;
+    sim_open();
+    pDev->selected = (pDev->pLat == NULL) || !(*pDev->pLat & pDev->csMask);
+    pDev->pNext = NULL;
+    while (*ppDev != NULL) ppDev = &(*ppDev)->pNext;
+    *ppDev = pDev;
+    sim_close();
+    simBusy--;
+}
+//------------------------------------------------------------------------------
+void sim_link(uint8_t master, uint8_t slave, volatile uint16_t *pLat, uint16_t csMask){
+    simBusy++;
+    sim_open();
+    simSpi[master].link = slave;
+    simSpi[master].pLinkLat = pLat;
+    simSpi[master].linkMask = csMask;
+    simSpi[master].linkSelected = (pLat == NULL) || !(*pLat & csMask);
+    sim_close();
+    simBusy--;
+}
+//------------------------------------------------------------------------------
+void sim_set_fifo(uint8_t fifo){
+    simFifo = fifo;
+}
+//------------------------------------------------------------------------------
+void sim_set_access_hook(sim_access_hook_t pfHook){
+    pfSimHook = pfHook;
+}
+//------------------------------------------------------------------------------
+uint64_t sim_cycles(void){
+    return simNow + simPending;
+}
+//------------------------------------------------------------------------------
+uint64_t sim_idle_cycles(void){
+    return simIdle;
+}
+//------------------------------------------------------------------------------
+uint64_t sim_accesses(void){
+    return simAccesses;
+}
+//------------------------------------------------------------------------------
+uint32_t sim_warnings(void){
+    return simWarnings;
+}
+//------------------------------------------------------------------------------
+void sim_delay(uint64_t nbCycles){
+    sim_spi_t   *pNext;
+    uint64_t    target;
+
+    simBusy++;
+    sim_open();
+    sim_apply_pending();
+    target = simNow + nbCycles;
+    for (;;){
+        pNext = sim_next_event();
+        if ((pNext == NULL) || (pNext->end > target)) break;
+        sim_advance(pNext->end);
+        sim_close();
+        sim_dispatch();     // The ISRs run during the delay
+        sim_open();
+    }
+    sim_advance(target);
+    sim_close();
+    simBusy--;
+    sim_dispatch();
+    if (simRunLimit && (simNow >= simRunLimit)) exit(0);
+}
+//------------------------------------------------------------------------------
+void sim_idle(void){
+    sim_spi_t   *p, *pNext;
+    uint64_t    start;
+    uint8_t     wake = 0;
+
+    simBusy++;
+    sim_open();
+    sim_apply_pending();
+    start = simNow;
+    for (;;){
+        for (p = simSpi; p < simSpi + SIM_NB_MODULES; p++) if (*p->pIfs & *p->pIec & p->itMask) wake = 1;
+        if (wake) break;
+        if ((pNext = sim_next_event()) == NULL){
+            fprintf(stderr, "sim: Idle() without wake-up source\n");
+            abort();
+        }
+        sim_advance(pNext->end);
+    }
+    simIdle += simNow - start;
+    sim_close();
+    simBusy--;
+    sim_dispatch();     // Vectored if its priority is above SR.IPL
+}
+//------------------------------------------------------------------------------
+void sim_disi(uint16_t nbCycles){
+    simDisiEnd = nbCycles ? (simNow + simPending + nbCycles + 1) : 0;
+    if (!nbCycles) sim_dispatch();
+}
+//------------------------------------------------------------------------------
+spi_config_t    sim_default_config(spiDataFormat_t format, spiBufferMode_t buffer){
+    spi_config_t    cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.spiClockPolarity = CLK_IDLE_IS_LOW;
+    cfg.spiClockPhase = ACTIVE_TO_IDLE_CPHASE;
+    cfg.spiSamplePoint = MID_SMP;
+    cfg.spiDataFormat = format;
+    cfg.spiPrimaryPrescaler = PRI_PRE_1;
+    cfg.spiSecondaryPrescaler = SEC_PRE_4;
+    cfg.spiBufferMode = buffer;
+    cfg.spiRole = SPI_MASTER;
+    cfg.spiFrameMode = SPI_UNFRAMED;
+    return cfg;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file    spi_sim.h
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Host model of the PIC24 SPI modules, to run lib_spi_pic24_ll off target
+ *
+ * The library is built unmodified with gcc against the xc.h of this
+ * directory (Linux x86-64). The trapped SFRs (see xc.h) live in one page of
+ * memory kept inaccessible : every access raises SIGSEGV, the model updates
+ * the register, the access is single-stepped (SIGTRAP) and the model then
+ * applies its side effects (BUF write pushed to the Tx FIFO, BUF read popping
+ * the Rx FIFO, CS edges on LATx, ...).
+ *
+ * Time : simulated cycles (FCY). Each SFR access costs SIM_ACCESS_CYCLES, a
+ * frame lasts bits x primary x secondary prescaler cycles, Idle() and
+ * __delay_xx() jump to the next event. A register polled in a tight loop
+ * (same instruction, same register, same value, no other access between)
+ * jumps to the next event as well : the spin budgets of the library see
+ * fewer iterations than on target. The instructions between two trapped
+ * accesses cost no cycle : the durations measured on the model are those
+ * of the SFR accesses and of the frames (lower bounds of the target ones).
+ *
+ * SPI : standard buffer (TBF / RBF, SPIROV) and enhanced buffer (8 deep
+ * FIFOs, SRXMPT, SRMPT, SISEL interrupt events) modes, master and slave.
+ * MISO is given by the devices attached to the module (sim_attach) : AND of
+ * the devices selected, 0xFF / 0xFFFF when none is. Framed mode sync pulses,
+ * clock polarity / phase and DMA are not modeled.
+ *
+ * Interrupts : SPIxIF is vectored to _SPIxInterrupt when SPIxIE is set and
+ * SPIxIP > SR.IPL (outside __builtin_disi windows), after the access that
+ * raised it, from Idle() and __delay_xx(), and from a periodic tick for the
+ * loops that spin on RAM only (ex : while (spi_async_status(..) == BUSY)).
+ *
+ * Environment variables :
+ *  - SIM_RUN_MS  : simulated time after which __delay_xx() ends the program
+ *  - SIM_TICK_US : period of the tick (host time, default 100 us)
+ *  - SIM_LOG     : 1 : every trapped access is printed on stderr
+ *
+ */
+
+#ifndef	__SPI_SIM_H__
+#define	__SPI_SIM_H__
+#include <stdint.h>
+#include <stdio.h>
+#include <xc.h>
+#include "lib_spi_pic24_ll.h"
+
+#ifndef SIM_ACCESS_CYCLES
+#define SIM_ACCESS_CYCLES   2   /**< Cycles charged per trapped access */
+#endif
+#define SIM_NB_MODULES      3
+
+/** Check of the host test suites (each one defines nbChecks and nbErrors) */
+#define CHECK(cond)     do { nbChecks++; if (!(cond)){ nbErrors++; printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+/** Type sim_device_t
+ *
+ * Device wired to a module. Device models embed it as their first member.
+ */
+typedef struct sim_device_s {
+    uint16_t    (*pfFrame)(struct sim_device_s *pDev, uint16_t mosi, uint8_t bits); /**< One frame (device selected) : returns MISO */
+    void        (*pfSelect)(struct sim_device_s *pDev, uint8_t selected);           /**< CS edge, or NULL */
+    volatile uint16_t   *pLat;      /**< LATx of the CS line (active low), NULL : always selected */
+    uint16_t    csMask;             /**< CS bit of *pLat */
+    uint8_t     selected;           /**< (model) */
+    struct sim_device_s *pNext;     /**< (model) */
+    } sim_device_t;
+
+/** Type sim_access_hook_t
+ *
+ * Called for each trapped access, once it is done
+ */
+typedef void (*sim_access_hook_t)(const char *pName, uint16_t value, uint8_t write);
+
+/** Type sim_loopback_t
+ *
+ * SDO wired to SDI : MISO = MOSI
+ */
+typedef struct {
+    sim_device_t    dev;
+    } sim_loopback_t;
+
+/** Type sim_regdev_t
+ *
+ * 8 bits register device : first frame of a CS window = address (bit 7 :
+ * read), next frames = data, address auto incremented. Each access is logged.
+ */
+#define SIM_REGDEV_LOG  64
+typedef struct {
+    sim_device_t    dev;
+    uint8_t     regs[128];
+    uint8_t     addr;
+    uint8_t     read;
+    uint8_t     frames;         /**< Frames of the current CS window */
+    uint16_t    nbLog;
+    struct {
+        uint8_t write;
+        uint8_t reg;
+        uint8_t value;
+        } log[SIM_REGDEV_LOG];
+    } sim_regdev_t;
+
+/** Type sim_flash_t
+ *
+ * 25 series NOR flash (64 KB) : WREN, RDSR, READ, FAST READ, PP (wraps in
+ * the page, bits only cleared), SE, RDID. A program / erase keeps WIP set
+ * for busyPolls status reads.
+ */
+#define SIM_FLASH_SIZE  65536UL
+typedef struct {
+    sim_device_t    dev;
+    uint8_t     mem[SIM_FLASH_SIZE];
+    uint16_t    busyPolls;      /**< (user) Status reads with WIP set after a program / erase */
+    uint8_t     cmd;
+    uint8_t     wel;            /**< Write enable latch */
+    uint16_t    busy;           /**< Status reads left with WIP set */
+    uint32_t    frames;         /**< Bytes of the current command */
+    uint32_t    addr;
+    uint32_t    nbReads;        /**< READ / FAST READ commands */
+    uint32_t    nbPrograms;
+    uint32_t    nbErases;
+    uint32_t    nbStatus;       /**< RDSR commands */
+    } sim_flash_t;
+
+/** Type sim_sdcard_t
+ *
+ * SD card in SPI mode (SDHC, block addressing, 64 KB) : CMD0, CMD8, CMD12,
+ * CMD16, CMD17, CMD18, CMD24, CMD25, CMD55, ACMD41, CMD58. R1 after one NCR byte,
+ * read data token after one NAC byte, busy (0x00) for busyFrames frames
+ * after a block write and stopBusy frames after CMD12.
+ */
+#define SIM_SD_BLOCKS   128
+#define SIM_SD_BLOCK    512
+typedef struct {
+    sim_device_t    dev;
+    uint8_t     mem[SIM_SD_BLOCKS][SIM_SD_BLOCK];
+    uint8_t     initPolls;      /**< (user) ACMD41 answered "idle" initPolls times */
+    uint16_t    busyFrames;     /**< (user) Busy frames after a block write */
+    uint16_t    stopBusy;       /**< (user) Busy frames after CMD12 */
+    uint8_t     cmd[6];
+    uint8_t     cmdLen;
+    uint8_t     resp[8];        /**< Response queued (NCR included) */
+    uint8_t     respLen, respIdx;
+    uint8_t     state;          /**< (model) */
+    uint8_t     idle, appCmd, multi;
+    uint32_t    block;
+    uint16_t    pos;            /**< Position in the data block */
+    uint16_t    busy;
+    uint8_t     wbuf[SIM_SD_BLOCK];
+    uint32_t    nbCmds;
+    uint32_t    nbReadBlocks;
+    uint32_t    nbWriteBlocks;
+    uint32_t    nbStops;        /**< CMD25 stop tokens */
+    } sim_sdcard_t;
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief   Wires a device to a module (the CS line state is sampled)
+ *
+ * @param[in]   module  0 : SPI1, 1 : SPI2, 2 : SPI3
+ * @param[in]   pDev    Device
+ */
+void    sim_attach(uint8_t module, sim_device_t *pDev);
+
+/**
+ * @brief   Unwires every device and link, resets the modules and the interrupt controller
+ */
+void    sim_reset(void);
+
+/**
+ * @brief   Wires master SCK/SDO/SDI to a slave module
+ *
+ * @param[in]   master  Module driving SCK
+ * @param[in]   slave   Module in slave mode
+ * @param[in]   pLat    LATx of the line wired to SSx of the slave, NULL : none
+ * @param[in]   csMask  Bit of *pLat
+ */
+void    sim_link(uint8_t master, uint8_t slave, volatile uint16_t *pLat, uint16_t csMask);
+
+/**
+ * @brief   Enhanced buffer mode implemented (1, default) or not (SPIBEN reads 0)
+ */
+void    sim_set_fifo(uint8_t fifo);
+
+/**
+ * @brief   Access hook (golden traces), NULL : none
+ */
+void    sim_set_access_hook(sim_access_hook_t pfHook);
+
+/**
+ * @brief   Simulated time, cycles
+ */
+uint64_t    sim_cycles(void);
+
+/**
+ * @brief   Cycles spent in Idle()
+ */
+uint64_t    sim_idle_cycles(void);
+
+/**
+ * @brief   Number of trapped accesses
+ */
+uint64_t    sim_accesses(void);
+
+/**
+ * @brief   Model warnings (SPIxCON1 / SPIxCON2 written while a frame is
+ *          shifted) since the start
+ */
+uint32_t    sim_warnings(void);
+
+/**
+ * @brief   Advances the simulated time (events processed, interrupts vectored)
+ */
+void    sim_delay(uint64_t nbCycles);
+
+void    sim_loopback_init(sim_loopback_t *pDev, volatile uint16_t *pLat, uint16_t csMask);
+void    sim_regdev_init(sim_regdev_t *pDev, volatile uint16_t *pLat, uint16_t csMask);
+void    sim_flash_init(sim_flash_t *pDev, volatile uint16_t *pLat, uint16_t csMask);
+void    sim_sdcard_init(sim_sdcard_t *pDev, volatile uint16_t *pLat, uint16_t csMask);
+
+/**
+ * @brief   Configuration of the host test suites : master, CKE set, SCK = 
+ *          FCY / 4 (1:1 x 1:4), unframed
+ */
+spi_config_t    sim_default_config(spiDataFormat_t format, spiBufferMode_t buffer);
+
+#endif
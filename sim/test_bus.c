@@ -0,0 +1,155 @@
+/**
+ * @file    test_bus.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Tests of lib_spi_pic24_bus on the SPI model
+ *
+ */
+
+#include <string.h>
+#include "spi_sim.h"
+#include "lib_spi_pic24_bus.h"
+
+/* Directives de compilation - Macros		*/
+#define CS_A_MASK       (1 << 2)    // RB2
+#define CS_B_MASK       (1 << 3)    // RB3
+
+/* Declarations des variables globales 	*/
+static uint16_t     nbChecks, nbErrors;
+static spi_desc_t   spi1;
+static spi_config_t spiCfg;
+static sim_loopback_t   loopback;
+
+/*	Implementation du code */
+static void test_setup(void){
+    spiCfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    sim_reset();
+    LATB = CS_A_MASK;
+    CHECK(spi_init(_SPI1, &spiCfg, &spi1) == SPI_OK);
+}
+//------------------------------------------------------------------------------
+/**
+ * spi_device_init : NULL CS (no line driven), NULL configuration rejected
+ */
+static void test_device_init(void){
+    spi_device_t    dev;
+    uint8_t     tx[4] = {1, 2, 3, 4}, rx[4];
+
+    test_setup();
+    sim_loopback_init(&loopback, NULL, 0);
+    sim_attach(_SPI1, &loopback.dev);
+    CHECK(spi_init(_SPI1, NULL, &spi1) == SPI_ERROR);
+    memset(&dev, 0xA5, sizeof(dev));
+    CHECK(spi_device_init(&dev, &spi1, NULL, NULL) == SPI_ERROR);
+    CHECK(dev.busTaken == 0xA5);    // Unchanged
+    CHECK(spi_device_init(&dev, NULL, &spiCfg, NULL) == SPI_ERROR);
+
+    CHECK(spi_device_init(&dev, &spi1, &spiCfg, NULL) == SPI_OK);
+    CHECK(spi_device_transfer_bytes(&dev, tx, rx, sizeof(tx)) == SPI_OK);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+    CHECK(LATB == CS_A_MASK);       // No line driven
+    CHECK(spi_device_select(&dev) == SPI_OK);
+    spi_device_release(&dev);
+    CHECK(spi_bus_owner(&spi1) == NULL);
+}
+//------------------------------------------------------------------------------
+/**
+ * spi_device_read_batch : the bus is released, the CS of pDev (held by the 
+ * caller) is left asserted
+ */
+static void test_read_batch(void){
+    spi_device_t    dev;
+    spi_cs_t    csA = {NULL, NULL, &LATB, CS_A_MASK}, csB = {NULL, NULL, &LATB, CS_B_MASK};
+    spi_reg_job_t   jobs[] = {{&csB, 0x81, 2}, {&csB, 0x82, 2}};
+    uint8_t     rx[4];
+
+    test_setup();
+    LATB = CS_A_MASK | CS_B_MASK;
+    sim_loopback_init(&loopback, NULL, 0);
+    sim_attach(_SPI1, &loopback.dev);
+    CHECK(spi_device_init(&dev, &spi1, &spiCfg, &csA) == SPI_OK);
+    spi_cs_assert(&csA);
+    CHECK(spi_device_read_batch(&dev, jobs, 2, rx, 2) == SPI_OK);
+    CHECK(!(LATB & CS_A_MASK));     // Still asserted
+    CHECK(LATB & CS_B_MASK);
+    CHECK(spi_bus_owner(&spi1) == NULL);
+    CHECK(dev.busTaken == 0);
+    spi_cs_release(&csA);
+
+    // Bus owned by the caller : kept
+    CHECK(spi_bus_acquire(&spi1, &dev, 0, NULL, NULL) == SPI_OK);
+    spi_cs_assert(&csA);
+    CHECK(spi_device_read_batch(&dev, jobs, 2, rx, 2) == SPI_OK);
+    CHECK(!(LATB & CS_A_MASK));
+    CHECK(spi_bus_owner(&spi1) == &dev);
+    spi_cs_release(&csA);
+    CHECK(spi_bus_release(&spi1, &dev) == SPI_OK);
+}
+//------------------------------------------------------------------------------
+/**
+ * Grant callback : the new owner runs its transaction from the handoff
+ */
+static void test_grant(spi_desc_t *pSpi, void *pCtx){
+    spi_device_t    *pDev = (spi_device_t*)pCtx;
+    uint8_t     tx = 0x5A, rx = 0;
+
+    CHECK(spi_bus_owner(pSpi) == pDev);
+    CHECK(spi_device_transfer_bytes(pDev, &tx, &rx, 1) == SPI_OK);
+    CHECK(rx == tx);
+    CHECK(spi_bus_release(pSpi, pDev) == SPI_OK);
+}
+//------------------------------------------------------------------------------
+/**
+ * Ownership : two devices at the same priority do not share the bus, only 
+ * the owner may release it, the handoff goes to the pending user
+ */
+static void test_owner(void){
+    spi_device_t    devA, devB;
+    spi_cs_t    csA = {NULL, NULL, &LATB, CS_A_MASK}, csB = {NULL, NULL, &LATB, CS_B_MASK};
+    uint8_t     tx[2] = {0x12, 0x34}, rx[2];
+
+    test_setup();
+    LATB = CS_A_MASK | CS_B_MASK;
+    sim_loopback_init(&loopback, NULL, 0);
+    sim_attach(_SPI1, &loopback.dev);
+    CHECK(spi_device_init(&devA, &spi1, &spiCfg, &csA) == SPI_OK);
+    CHECK(spi_device_init(&devB, &spi1, &spiCfg, &csB) == SPI_OK);
+    CHECK(spi_bus_acquire(&spi1, NULL, 0, NULL, NULL) == SPI_ERROR);
+    CHECK(spi_bus_release(&spi1, &devA) == SPI_ERROR);     // Bus free
+
+    // Same priority : devB is refused while devA holds the bus
+    CHECK(spi_device_select(&devA) == SPI_OK);
+    CHECK(spi_device_transfer_bytes(&devB, tx, rx, sizeof(tx)) == SPI_BUSY);
+    CHECK(LATB & CS_B_MASK);
+    CHECK(spi_bus_release(&spi1, &devB) == SPI_ERROR);
+    CHECK(spi_bus_owner(&spi1) == &devA);
+    CHECK(spi_bus_acquire(&spi1, &devA, 0, NULL, NULL) == SPI_ERROR);
+    spi_device_release(&devA);
+    CHECK(spi_bus_owner(&spi1) == NULL);
+    CHECK(spi_device_transfer_bytes(&devB, tx, rx, sizeof(tx)) == SPI_OK);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+
+    // Pending request : granted to devB on release, cancelled afterwards
+    CHECK(spi_bus_acquire(&spi1, &devA, 0, NULL, NULL) == SPI_OK);
+    CHECK(spi_bus_acquire(&spi1, &devB, 0, test_grant, &devB) == SPI_BUSY);
+    CHECK(spi_bus_acquire(&spi1, &devB, 0, test_grant, &devB) == SPI_ERROR);   // Already pending
+    CHECK(spi_bus_release(&spi1, &devB) == SPI_ERROR);
+    CHECK(spi_bus_release(&spi1, &devA) == SPI_OK);
+    CHECK(spi_bus_owner(&spi1) == NULL);            // Released by test_grant
+    CHECK(spi_bus_cancel(&spi1, &devB) == SPI_OK);
+
+    CHECK(spi_bus_acquire(&spi1, &devA, 0, NULL, NULL) == SPI_OK);
+    CHECK(spi_bus_acquire(&spi1, &devB, 1, test_grant, &devB) == SPI_BUSY);
+    CHECK(spi_bus_cancel(&spi1, &devB) == SPI_OK);
+    CHECK(spi_bus_cancel(&spi1, &devA) == SPI_BUSY);
+    CHECK(spi_bus_release(&spi1, &devA) == SPI_OK);
+    CHECK(spi_bus_owner(&spi1) == NULL);
+}
+//------------------------------------------------------------------------------
+int main(void){
+    test_device_init();
+    test_read_batch();
+    test_owner();
+    printf("#test_bus,checks=%u,errors=%u\n", nbChecks, nbErrors);
+    return nbErrors ? 1 : 0;
+}
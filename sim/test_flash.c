@@ -0,0 +1,223 @@
+/**
+ * @file    test_flash.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Tests of lib_spi_pic24_flash and lib_spi_pic24_sd on the flash / SD card models
+ *
+ */
+
+#include <string.h>
+#include "spi_sim.h"
+#include "lib_spi_pic24_flash.h"
+#include "lib_spi_pic24_sd.h"
+
+/* Directives de compilation - Macros		*/
+#define FLASH_CS_MASK   (1 << 3)    // RB3
+#define SD_CS_MASK      (1 << 4)    // RB4
+
+/* Declarations des variables globales 	*/
+static uint16_t     nbChecks, nbErrors;
+static spi_desc_t   spi1;
+static spi_config_t spiCfg;
+static spi_device_t flashDev, sdDev;
+static sim_flash_t  simFlash;
+static sim_sdcard_t simSd;
+static spi_flash_t  flash;
+static spi_sd_t     sd;
+static uint16_t     nbYields;
+static uint8_t      buf[3 * SPI_SD_BLOCK_SIZE], ref[3 * SPI_SD_BLOCK_SIZE];
+
+/*	Implementation du code */
+static void test_yield(void *pCtx){
+    (void)pCtx;
+    nbYields++;
+}
+//------------------------------------------------------------------------------
+/**
+ * Busy poll : the next frames time out (slowest SCK, smallest spin budget)
+ */
+static void test_yield_stall(void *pCtx){
+    (void)pCtx;
+    sdDev.con1 = (sdDev.con1 & ~0x001F) | SPI_CON1_PRESCALERS(PRI_PRE_64, SEC_PRE_8);   // PPRE / SPRE
+    spi_set_spin_budget(&spi1, SPI_SPIN_BUDGET_MIN);
+}
+//------------------------------------------------------------------------------
+static void test_setup(void){
+    spi_cs_t    flashCs = {NULL, NULL, &LATB, FLASH_CS_MASK};
+    spi_cs_t    sdCs = {NULL, NULL, &LATB, SD_CS_MASK};
+
+    spiCfg = sim_default_config(BITS8, ENHANCED_BUFFER);
+    spiCfg.spiSecondaryPrescaler = SEC_PRE_2;
+    sim_reset();
+    LATB = FLASH_CS_MASK | SD_CS_MASK;
+    sim_flash_init(&simFlash, &LATB, FLASH_CS_MASK);
+    sim_sdcard_init(&simSd, &LATB, SD_CS_MASK);
+    sim_attach(_SPI1, &simFlash.dev);
+    sim_attach(_SPI1, &simSd.dev);
+    CHECK(spi_init(_SPI1, &spiCfg, &spi1) == SPI_OK);
+    CHECK(spi_device_init(&flashDev, &spi1, &spiCfg, &flashCs) == SPI_OK);
+    CHECK(spi_device_init(&sdDev, &spi1, &spiCfg, &sdCs) == SPI_OK);
+    CHECK(spi_flash_init(&flash, &flashDev, test_yield, NULL) == SPI_OK);
+    nbYields = 0;
+}
+//------------------------------------------------------------------------------
+/**
+ * A read ahead fetching the erased bytes of a staged page must not be served
+ * once the page is programmed
+ */
+static void test_flash_read_ahead(void){
+    uint8_t     data[16], i;
+
+    test_setup();
+    for (i = 0; i < sizeof(data); i++) data[i] = i + 1;
+    CHECK(spi_flash_erase_sector(&flash, 0) == SPI_OK);
+    CHECK(spi_flash_write(&flash, 0x100, data, sizeof(data)) == SPI_OK);
+    CHECK(simFlash.nbPrograms == 0);
+
+    // Random read, then sequential read : the read ahead covers 0x100..0x11F
+    CHECK(spi_flash_read(&flash, 0x0D0, buf, 16) == SPI_OK);
+    CHECK(spi_flash_read(&flash, 0x0E0, buf, 16) == SPI_OK);
+    CHECK(simFlash.nbPrograms == 0);
+    CHECK(spi_flash_flush(&flash) == SPI_OK);
+    CHECK(simFlash.nbPrograms == 1);
+    CHECK(spi_flash_read(&flash, 0x100, buf, sizeof(data)) == SPI_OK);
+    CHECK(memcmp(buf, data, sizeof(data)) == 0);
+
+    // Same, the flush being made by the read of the page
+    CHECK(spi_flash_write(&flash, 0x200, data, sizeof(data)) == SPI_OK);
+    CHECK(spi_flash_read(&flash, 0x1D0, buf, 16) == SPI_OK);
+    CHECK(spi_flash_read(&flash, 0x1E0, buf, 16) == SPI_OK);
+    CHECK(spi_flash_read(&flash, 0x1F0, buf, 32) == SPI_OK);
+    CHECK(simFlash.nbPrograms == 2);
+    CHECK(memcmp(&buf[16], data, sizeof(data)) == 0);
+}
+//------------------------------------------------------------------------------
+/**
+ * Sequential short reads : one FAST READ per cache block. Random ones : one
+ * per read.
+ */
+static void test_flash_access(void){
+    uint16_t    i;
+    uint32_t    reads, addr;
+    uint8_t     id[3];
+
+    test_setup();
+    for (i = 0; i < 4096; i++) simFlash.mem[i] = (uint8_t)(i * 7);
+    CHECK(spi_flash_read_id(&flash, id) == SPI_OK);
+    CHECK((id[0] == 0xEF) && (id[1] == 0x40) && (id[2] == 0x16));
+
+    reads = simFlash.nbReads;
+    for (i = 0; i < 64; i++){
+        CHECK(spi_flash_read(&flash, 16 * i, buf, 16) == SPI_OK);
+        if (memcmp(buf, &simFlash.mem[16 * i], 16) != 0) break;
+    }
+    CHECK(i == 64);
+    CHECK((simFlash.nbReads - reads) == (1 + (1024 - 16 + SPI_FLASH_CACHE_SIZE - 1) / SPI_FLASH_CACHE_SIZE));
+
+    reads = simFlash.nbReads;
+    for (i = 0, addr = 0; i < 64; i++){
+        addr = (addr * 13 + 1024 + 16) & 0xFF0;
+        CHECK(spi_flash_read(&flash, addr, buf, 16) == SPI_OK);
+        if (memcmp(buf, &simFlash.mem[addr], 16) != 0) break;
+    }
+    CHECK(i == 64);
+    CHECK((simFlash.nbReads - reads) >= 60);
+
+    // Writes across pages : only the span written is programmed, one program per page
+    CHECK(spi_flash_erase_sector(&flash, 0x1000) == SPI_OK);
+    for (i = 0; i < 300; i++) ref[i] = (uint8_t)(i ^ 0xA5);
+    simFlash.busyPolls = 5;
+    nbYields = 0;
+    CHECK(spi_flash_write(&flash, 0x10F0, ref, 300) == SPI_OK);
+    CHECK(spi_flash_flush(&flash) == SPI_OK);
+    CHECK(simFlash.nbPrograms == 3);
+    CHECK(nbYields == 3 * 5);       // CS released between polls
+    CHECK(memcmp(&simFlash.mem[0x10F0], ref, 300) == 0);
+    CHECK(simFlash.mem[0x10EF] == 0xFF);
+    CHECK(simFlash.mem[0x10F0 + 300] == 0xFF);
+}
+//------------------------------------------------------------------------------
+static void test_sd(void){
+    uint16_t    i;
+    uint32_t    cmds;
+    uint64_t    start, single, multi;
+
+    test_setup();
+    CHECK(spi_sd_init(&sd, &sdDev, NULL, test_yield, NULL) == SPI_OK);
+    CHECK(sd.blockAddr == 1);
+    CHECK(nbYields == 3);           // ACMD41 answered idle 3 times
+
+    // Block accesses : one CMD25 + stop token, one CMD18 + CMD12 for several blocks
+    for (i = 0; i < sizeof(ref); i++) ref[i] = (uint8_t)(i * 3 + (i >> 8));
+    cmds = simSd.nbCmds;
+    CHECK(spi_sd_write_blocks(&sd, 4, ref, 3) == SPI_OK);
+    CHECK((simSd.nbCmds - cmds) == 1);
+    CHECK(simSd.nbStops == 1);
+    CHECK(simSd.nbWriteBlocks == 3);
+    CHECK(memcmp(simSd.mem[4], ref, sizeof(ref)) == 0);
+    memset(buf, 0, sizeof(buf));
+    cmds = simSd.nbCmds;
+    CHECK(spi_sd_read_blocks(&sd, 4, buf, 3) == SPI_OK);
+    CHECK((simSd.nbCmds - cmds) == 2);
+    CHECK(simSd.nbReadBlocks == 3);
+    CHECK(memcmp(buf, ref, sizeof(ref)) == 0);
+    CHECK(spi_sd_read_blocks(&sd, SIM_SD_BLOCKS, buf, 1) == SPI_ERROR);
+    // CMD18 rejected : no CMD12. CMD12 busy : waited for, then SPI_TIMEOUT
+    cmds = simSd.nbCmds;
+    CHECK(spi_sd_read_blocks(&sd, SIM_SD_BLOCKS, buf, 2) == SPI_ERROR);
+    CHECK((simSd.nbCmds - cmds) == 1);
+    simSd.stopBusy = 100;
+    CHECK(spi_sd_read_blocks(&sd, 4, buf, 2) == SPI_OK);
+    simSd.stopBusy = SPI_SD_TOKEN_POLLS + 1;
+    CHECK(spi_sd_read_blocks(&sd, 4, buf, 2) == SPI_TIMEOUT);
+    simSd.stopBusy = 0;
+
+    // Byte accesses : write back cache
+    cmds = simSd.nbCmds;
+    CHECK(spi_sd_write(&sd, 4 * SPI_SD_BLOCK_SIZE + 500, (const uint8_t*)"0123456789ABCDEFGHIJKLMNOPQRST", 30) == SPI_OK);
+    memcpy(&ref[500], "0123456789ABCDEFGHIJKLMNOPQRST", 30);
+    CHECK(simSd.nbWriteBlocks == 4);    // Block 4 written back when block 5 was loaded
+    CHECK(memcmp(simSd.mem[5], &ref[SPI_SD_BLOCK_SIZE], SPI_SD_BLOCK_SIZE) != 0);
+    // Modified cached block written before the card is read
+    CHECK(spi_sd_read_blocks(&sd, 5, buf, 1) == SPI_OK);
+    CHECK(memcmp(buf, &ref[SPI_SD_BLOCK_SIZE], SPI_SD_BLOCK_SIZE) == 0);
+    CHECK(spi_sd_read(&sd, 4 * SPI_SD_BLOCK_SIZE + 500, buf, 30) == SPI_OK);
+    CHECK(memcmp(buf, &ref[500], 30) == 0);
+    CHECK(spi_sd_flush(&sd) == SPI_OK);
+    CHECK(memcmp(simSd.mem[4], ref, sizeof(ref)) == 0);
+
+    // Aligned byte read : whole blocks in one command, the tail through the cache
+    memset(buf, 0, sizeof(buf));
+    CHECK(spi_sd_read(&sd, 4 * SPI_SD_BLOCK_SIZE, buf, 2 * SPI_SD_BLOCK_SIZE + 10) == SPI_OK);
+    CHECK(memcmp(buf, ref, 2 * SPI_SD_BLOCK_SIZE + 10) == 0);
+    CHECK(sd.cacheBlock == 6);
+
+    // CMD25 against one CMD24 per block
+    cmds = simSd.nbCmds;
+    start = sim_cycles();
+    for (i = 0; i < 3; i++) CHECK(spi_sd_write_blocks(&sd, 16 + i, &ref[i * SPI_SD_BLOCK_SIZE], 1) == SPI_OK);
+    single = sim_cycles() - start;
+    start = sim_cycles();
+    CHECK(spi_sd_write_blocks(&sd, 16, ref, 3) == SPI_OK);
+    multi = sim_cycles() - start;
+    CHECK((simSd.nbCmds - cmds) == 4);     // 3 x CMD24, then 1 x CMD25
+    CHECK(memcmp(simSd.mem[16], ref, sizeof(ref)) == 0);
+    printf("#sd_write_blocks,blocks=3,cmd24_cycles=%llu,cmd25_cycles=%llu\n", (unsigned long long)single, (unsigned long long)multi);
+    // Stop token sent after a block out of the card
+    cmds = simSd.nbStops;
+    CHECK(spi_sd_write_blocks(&sd, SIM_SD_BLOCKS - 1, ref, 2) == SPI_ERROR);
+    CHECK((simSd.nbStops - cmds) == 1);
+    CHECK(memcmp(simSd.mem[SIM_SD_BLOCKS - 1], ref, SPI_SD_BLOCK_SIZE) == 0);
+
+    // Busy poll failing : the error is returned, the card is not taken as ready
+    sd.pfYield = test_yield_stall;
+    CHECK(spi_sd_write_blocks(&sd, 8, ref, 1) == SPI_TIMEOUT);
+}
+//------------------------------------------------------------------------------
+int main(void){
+    test_flash_read_ahead();
+    test_flash_access();
+    test_sd();
+    printf("#test_flash,checks=%u,errors=%u\n", nbChecks, nbErrors);
+    return nbErrors ? 1 : 0;
+}
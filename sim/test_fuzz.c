@@ -0,0 +1,231 @@
+/**
+ * @file    test_fuzz.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Seeded random tests of spi_config_t (spi_config_con1 / con2, spi_init)
+ *          and of the blocking transfers on the SPI model
+ *
+ * Environment variables :
+ *  - FUZZ_SEED  : seed of the generator (default 1), printed on each failure
+ *  - FUZZ_ITER  : configurations drawn (default 4000)
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "spi_sim.h"
+#include "lib_spi_pic24_ll.h"
+
+/* Directives de compilation - Macros		*/
+#undef  CHECK           // Seed and iteration of the failure printed as well
+#define CHECK(cond)     do { nbChecks++; if (!(cond)){ nbErrors++; \
+                            printf("FAIL %s:%d %s (seed %lu, iteration %lu)\n", __FILE__, __LINE__, #cond, fuzzSeed, fuzzIter); } } while (0)
+#define FUZZ_MAX_LEN    40
+#define FUZZ_CON1_FIELDS    0x07FF  /**< MODE16 .. PPRE */
+#define FUZZ_CON2_FIELDS    0xE001  /**< FRMEN, SPIFSD, SPIFPOL, SPIBEN */
+
+/* Declarations des variables globales 	*/
+static uint32_t     nbChecks, nbErrors;
+static unsigned long    fuzzSeed = 1, fuzzNbIter = 4000, fuzzIter;
+static uint32_t     fuzzState;
+static spi_desc_t   spi;
+static sim_loopback_t   loopback;
+static uint16_t     nbWrites;
+static volatile uint16_t * const fuzzCon1[SPI_NB_MODULES] = {&SPI1CON1, &SPI2CON1, &SPI3CON1};
+static volatile uint16_t * const fuzzCon2[SPI_NB_MODULES] = {&SPI1CON2, &SPI2CON2, &SPI3CON2};
+static volatile uint16_t * const fuzzStat[SPI_NB_MODULES] = {&SPI1STAT, &SPI2STAT, &SPI3STAT};
+
+/*	Implementation du code */
+/** xorshift32 : value in 0..n-1 */
+static uint32_t fuzz_rand(uint32_t n){
+    fuzzState ^= fuzzState << 13;
+    fuzzState ^= fuzzState >> 17;
+    fuzzState ^= fuzzState << 5;
+    return fuzzState % n;
+}
+//------------------------------------------------------------------------------
+static void fuzz_hook(const char *pName, uint16_t value, uint8_t write){
+    (void)value;
+    if (write && (strncmp(pName, "SPI", 3) == 0)) nbWrites++;
+}
+//------------------------------------------------------------------------------
+/** Each field drawn over its enum and 2 values past it */
+static void fuzz_config(spi_config_t *pCfg){
+    memset(pCfg, 0, sizeof(*pCfg));
+    pCfg->spiClockPolarity = (clock_polarity_t)fuzz_rand(2 + 2);
+    pCfg->spiClockPhase = (clock_phase_t)fuzz_rand(2 + 2);
+    pCfg->spiSamplePoint = (spiSamplePoint_t)fuzz_rand(2 + 2);
+    pCfg->spiDataFormat = (spiDataFormat_t)fuzz_rand(2 + 2);
+    pCfg->spiPrimaryPrescaler = (tPriPrescaler)fuzz_rand(4 + 2);
+    pCfg->spiSecondaryPrescaler = (tSecPrescaler)fuzz_rand(8 + 2);
+    pCfg->spiBufferMode = (spiBufferMode_t)fuzz_rand(2 + 2);
+    pCfg->spiRole = (spiRole_t)fuzz_rand(3 + 2);
+    pCfg->spiFrameMode = (spiFrameMode_t)fuzz_rand(3 + 2);
+    pCfg->spiFrameSyncPolarity = (spiFrameSyncPolarity_t)fuzz_rand(2 + 2);
+    // Mostly valid configurations
+    if (fuzz_rand(4) != 0){
+        pCfg->spiClockPolarity &= 1;
+        pCfg->spiClockPhase &= 1;
+        pCfg->spiSamplePoint &= 1;
+        pCfg->spiDataFormat &= 1;
+        pCfg->spiPrimaryPrescaler &= 3;
+        pCfg->spiSecondaryPrescaler &= 7;
+        pCfg->spiBufferMode &= 1;
+        pCfg->spiRole = (spiRole_t)(pCfg->spiRole % 3);
+        pCfg->spiFrameMode = (spiFrameMode_t)(pCfg->spiFrameMode % 3);
+        pCfg->spiFrameSyncPolarity &= 1;
+    }
+}
+//------------------------------------------------------------------------------
+/** Configurations with every field in its enum (see spi_config_t) */
+static uint8_t fuzz_valid(const spi_config_t *pCfg){
+    if ((pCfg->spiClockPolarity > 1) || (pCfg->spiClockPhase > 1) || (pCfg->spiDataFormat > 1) || (pCfg->spiBufferMode > 1)) return 0;
+    if ((pCfg->spiRole > 2) || (pCfg->spiFrameMode > 2)) return 0;
+    if ((pCfg->spiFrameMode != 0) && (pCfg->spiFrameSyncPolarity > 1)) return 0;
+    if ((pCfg->spiRole == 0) && ((pCfg->spiSamplePoint > 1) || (pCfg->spiPrimaryPrescaler > 3) || (pCfg->spiSecondaryPrescaler > 7))) return 0;
+    return 1;
+}
+//------------------------------------------------------------------------------
+/** Configurations spi_config_check must accept (from the data sheet) */
+static uint8_t fuzz_legal(const spi_config_t *pCfg){
+    if (!fuzz_valid(pCfg)) return 0;
+    if ((pCfg->spiRole == 0) && (pCfg->spiPrimaryPrescaler == 3) && (pCfg->spiSecondaryPrescaler == 7)) return 0;  // 1:1 x 1:1
+    if ((pCfg->spiRole == 1) && (pCfg->spiClockPhase == 1)) return 0;    // CKE without SSx
+    return 1;
+}
+//------------------------------------------------------------------------------
+/** SPIxCON1 bit by bit (MODE16 10, SMP 9, CKE 8, SSEN 7, CKP 6, MSTEN 5, SPRE 4..2, PPRE 1..0) */
+static uint16_t fuzz_con1(const spi_config_t *pCfg){
+    uint16_t    con1 = 0;
+
+    if (pCfg->spiDataFormat == 1) con1 |= 1 << 10;
+    if (pCfg->spiClockPhase == 1) con1 |= 1 << 8;
+    if (pCfg->spiClockPolarity == 1) con1 |= 1 << 6;
+    if (pCfg->spiRole == 0){
+        if (pCfg->spiSamplePoint == 1) con1 |= 1 << 9;
+        con1 |= 1 << 5;
+        con1 |= (uint16_t)((pCfg->spiSecondaryPrescaler << 2) | pCfg->spiPrimaryPrescaler);
+    }
+    else if (pCfg->spiRole == 2) con1 |= 1 << 7;
+    return con1;
+}
+//------------------------------------------------------------------------------
+/** SPIxCON2 bit by bit (FRMEN 15, SPIFSD 14, SPIFPOL 13, SPIBEN 0) */
+static uint16_t fuzz_con2(const spi_config_t *pCfg){
+    uint16_t    con2 = (pCfg->spiBufferMode == 1) ? 1 : 0;
+
+    if (pCfg->spiFrameMode != 0){
+        con2 |= 1 << 15;
+        if (pCfg->spiFrameMode == 2) con2 |= 1 << 14;
+        if (pCfg->spiFrameSyncPolarity == 1) con2 |= 1 << 13;
+    }
+    return con2;
+}
+//------------------------------------------------------------------------------
+/**
+ * spi_config_con1 / con2 against the bit model. Out of range fields stay in 
+ * their bit fields, and spi_init writes the values of spi_config_con1 / con2
+ * (an unknown module writes no register). spi_config_check against the data
+ * sheet rules.
+ */
+static void test_config(void){
+    spi_config_t    cfg;
+    spi_id_t    id;
+    spi_err_t   res;
+    uint16_t    con1, con2;
+
+    sim_set_access_hook(fuzz_hook);
+    for (fuzzIter = 0; fuzzIter < fuzzNbIter; fuzzIter++){
+        fuzz_config(&cfg);
+        id = (spi_id_t)fuzz_rand(SPI_NB_MODULES + 1);
+        con1 = spi_config_con1(&cfg);
+        con2 = spi_config_con2(&cfg);
+        if (fuzz_valid(&cfg)){
+            CHECK(con1 == fuzz_con1(&cfg));
+            CHECK(con2 == fuzz_con2(&cfg));
+        }
+        CHECK((con1 & ~FUZZ_CON1_FIELDS) == 0);
+        CHECK((con2 & ~FUZZ_CON2_FIELDS) == 0);
+        CHECK((spi_config_check(&cfg) == SPI_OK) == fuzz_legal(&cfg));
+        sim_reset();
+        nbWrites = 0;
+        memset(&spi, 0xA5, sizeof(spi));
+        res = spi_init(id, &cfg, &spi);
+        if (id >= SPI_NB_MODULES){
+            CHECK(res == SPI_UNKNOWN_MODULE);
+            CHECK(nbWrites == 0);
+        }
+        else {
+            CHECK(res == SPI_OK);
+            CHECK(*fuzzCon1[id] == con1);
+            CHECK(*fuzzCon2[id] == con2);
+            CHECK(*fuzzStat[id] & SPIEN_MASK);
+            if (fuzz_valid(&cfg)) CHECK(spi.spiDataFormat == cfg.spiDataFormat);
+        }
+    }
+    sim_set_access_hook(NULL);
+    CHECK(spi_init(_SPI1, NULL, &spi) == SPI_ERROR);
+    CHECK(spi_config_check(NULL) == SPI_ERROR);
+}
+//------------------------------------------------------------------------------
+/**
+ * Blocking transfers on the loopback : random format, buffer mode, length,
+ * NULL Tx (fill sent) / NULL Rx, nothing written past len
+ */
+static void test_transfers(void){
+    spi_config_t    cfg;
+    uint8_t     tx[FUZZ_MAX_LEN + 2], rx[FUZZ_MAX_LEN + 2];
+    uint16_t    txw[FUZZ_MAX_LEN + 2], rxw[FUZZ_MAX_LEN + 2];
+    size_t      len, i;
+    uint8_t     noTx, noRx, packed;
+    uint32_t    warnings;
+
+    for (fuzzIter = 0; fuzzIter < 400; fuzzIter++){
+        cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+        cfg.spiClockPhase = (clock_phase_t)fuzz_rand(2);
+        cfg.spiDataFormat = (spiDataFormat_t)fuzz_rand(2);
+        cfg.spiPrimaryPrescaler = (tPriPrescaler)(PRI_PRE_4 + fuzz_rand(2));
+        cfg.spiSecondaryPrescaler = (tSecPrescaler)(SEC_PRE_4 + fuzz_rand(4));
+        if ((cfg.spiPrimaryPrescaler == PRI_PRE_1) && (cfg.spiSecondaryPrescaler == SEC_PRE_1)) cfg.spiSecondaryPrescaler = SEC_PRE_2;
+        cfg.spiBufferMode = (spiBufferMode_t)fuzz_rand(2);
+        sim_reset();
+        sim_loopback_init(&loopback, NULL, 0);
+        sim_attach(_SPI1, &loopback.dev);
+        CHECK(spi_init(_SPI1, &cfg, &spi) == SPI_OK);
+
+        len = fuzz_rand(FUZZ_MAX_LEN + 1);
+        noTx = (fuzz_rand(3) == 0);
+        noRx = (fuzz_rand(4) == 0);
+        packed = (cfg.spiDataFormat == BITS8) && fuzz_rand(2);
+        for (i = 0; i < FUZZ_MAX_LEN + 2; i++){
+            tx[i] = (uint8_t)fuzz_rand(256);
+            txw[i] = (uint16_t)fuzz_rand(65536);
+        }
+        memset(rx, 0x5C, sizeof(rx));
+        memset(rxw, 0x5C, sizeof(rxw));
+        warnings = sim_warnings();
+        if (cfg.spiDataFormat == BITS8){
+            if (packed) CHECK(spi_transfer_packed_bytes(&spi, noTx ? NULL : tx, noRx ? NULL : rx, len) == SPI_OK);
+            else CHECK(spi_transfer_raw_bytes(&spi, noTx ? NULL : tx, noRx ? NULL : rx, len) == SPI_OK);
+            for (i = 0; i < len; i++) CHECK(rx[i] == (noRx ? 0x5C : (noTx ? 0xFF : tx[i])));
+            CHECK((rx[len] == 0x5C) && (rx[len + 1] == 0x5C));
+            CHECK(!(SPI1CON1 & MODE16_MASK));
+        }
+        else {
+            CHECK(spi_transfer_raw_words(&spi, noTx ? NULL : txw, noRx ? NULL : rxw, len) == SPI_OK);
+            for (i = 0; i < len; i++) CHECK(rxw[i] == (noRx ? 0x5C5C : (noTx ? 0xFFFF : txw[i])));
+            CHECK((rxw[len] == 0x5C5C) && (rxw[len + 1] == 0x5C5C));
+        }
+        CHECK(sim_warnings() == warnings);
+    }
+}
+//------------------------------------------------------------------------------
+int main(void){
+    if (getenv("FUZZ_SEED") != NULL) fuzzSeed = strtoul(getenv("FUZZ_SEED"), NULL, 0);
+    if (getenv("FUZZ_ITER") != NULL) fuzzNbIter = strtoul(getenv("FUZZ_ITER"), NULL, 0);
+    fuzzState = (uint32_t)fuzzSeed ? (uint32_t)fuzzSeed : 1;
+    test_config();
+    test_transfers();
+    printf("#test_fuzz,seed=%lu,checks=%lu,errors=%lu\n", fuzzSeed, (unsigned long)nbChecks, (unsigned long)nbErrors);
+    return nbErrors ? 1 : 0;
+}
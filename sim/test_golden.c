@@ -0,0 +1,546 @@
+/**
+ * @file    test_golden.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Golden register traces of the public entry points of lib_spi_pic24_ll
+ *
+ * Every write to a SPIx register (SPIxCON1, SPIxCON2, SPIxSTAT, SPIxBUF) and
+ * to the CS latch (LATB) done by a call is recorded, followed by the return
+ * value and the data received. The trace of each group is compared with
+ * golden/<group>.trace.
+ *
+ *  ./test_golden       compare
+ *  ./test_golden -u    rewrite the golden files (make golden), to be
+ *                      reviewed with git diff before being committed
+ *
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "spi_sim.h"
+#include "lib_spi_pic24_bus.h"
+
+/* Directives de compilation - Macros		*/
+#define GOLDEN_DIR      "golden/"
+#define GOLDEN_SIZE     (256UL * 1024UL)
+#define CS_A_MASK       (1 << 2)    // RB2
+#define CS_B_MASK       (1 << 3)    // RB3
+
+/* Declarations des variables globales 	*/
+static uint16_t     nbChecks, nbErrors;
+static uint8_t      goldenUpdate;
+static char         goldenTrace[GOLDEN_SIZE], goldenRef[GOLDEN_SIZE];
+static size_t       goldenLen;
+static spi_desc_t   spi1, spi2;
+static sim_loopback_t   loopback;
+static const spi_cs_t   csA = {NULL, NULL, &LATB, CS_A_MASK}, csB = {NULL, NULL, &LATB, CS_B_MASK};
+static uint16_t     nbCallbacks;
+
+/*	Implementation du code */
+static void golden_printf(const char *pFormat, ...){
+    va_list     args;
+    int         n;
+
+    va_start(args, pFormat);
+    n = vsnprintf(goldenTrace + goldenLen, GOLDEN_SIZE - goldenLen, pFormat, args);
+    va_end(args);
+    if ((n > 0) && ((size_t)n < GOLDEN_SIZE - goldenLen)) goldenLen += (size_t)n;
+}
+//------------------------------------------------------------------------------
+static void golden_hook(const char *pName, uint16_t value, uint8_t write){
+    if (!write) return;
+    if ((strncmp(pName, "SPI", 3) == 0) || (strcmp(pName, "LATB") == 0)) golden_printf("  %s=%04X\n", pName, value);
+}
+//------------------------------------------------------------------------------
+/** Header of a call : its writes follow */
+static void golden_call(const char *pFormat, ...){
+    va_list     args;
+    int         n;
+
+    va_start(args, pFormat);
+    n = vsnprintf(goldenTrace + goldenLen, GOLDEN_SIZE - goldenLen, pFormat, args);
+    va_end(args);
+    if ((n > 0) && ((size_t)n < GOLDEN_SIZE - goldenLen)) goldenLen += (size_t)n;
+    golden_printf("\n");
+}
+//------------------------------------------------------------------------------
+/** Return value of a call and the len frames received (bytes : size 1, words : size 2) */
+static void golden_result(spi_err_t err, const void *pRx, size_t len, uint8_t size){
+    size_t  i;
+
+    golden_printf("  -> %d", (int)err);
+    for (i = 0; (pRx != NULL) && (i < len); i++){
+        if (size == 1) golden_printf(" %02X", ((const uint8_t*)pRx)[i]);
+        else golden_printf(" %04X", ((const uint16_t*)pRx)[i]);
+    }
+    golden_printf("\n");
+}
+//------------------------------------------------------------------------------
+static void golden_begin(void){
+    goldenLen = 0;
+    goldenTrace[0] = '\0';
+}
+//------------------------------------------------------------------------------
+/** Compares the trace with golden/<pGroup>.trace (or rewrites it) */
+static void golden_end(const char *pGroup){
+    char    path[64];
+    FILE    *pFile;
+    size_t  len, i, line;
+
+    sim_set_access_hook(NULL);
+    snprintf(path, sizeof(path), GOLDEN_DIR "%s.trace", pGroup);
+    if (goldenUpdate){
+        pFile = fopen(path, "w");
+        CHECK(pFile != NULL);
+        if (pFile == NULL) return;
+        CHECK(fwrite(goldenTrace, 1, goldenLen, pFile) == goldenLen);
+        fclose(pFile);
+        return;
+    }
+    pFile = fopen(path, "r");
+    if (pFile == NULL){
+        printf("FAIL %s missing (make golden)\n", path);
+        nbChecks++;
+        nbErrors++;
+        return;
+    }
+    len = fread(goldenRef, 1, GOLDEN_SIZE - 1, pFile);
+    fclose(pFile);
+    goldenRef[len] = '\0';
+    nbChecks++;
+    if ((len == goldenLen) && (memcmp(goldenRef, goldenTrace, len) == 0)) return;
+    nbErrors++;
+    for (i = 0, line = 1; (i < len) && (i < goldenLen) && (goldenRef[i] == goldenTrace[i]); i++) if (goldenRef[i] == '\n') line++;
+    printf("FAIL %s:%lu differs (expected \"%.40s\", got \"%.40s\")\n", path, (unsigned long)line,
+            goldenRef + i, goldenTrace + i);
+}
+//------------------------------------------------------------------------------
+/** Loopback on SPI1, CS lines released, then recording */
+static void golden_setup(spiDataFormat_t format, spiBufferMode_t buffer){
+    spi_config_t    cfg;
+
+    sim_reset();
+    LATB = CS_A_MASK | CS_B_MASK;
+    sim_loopback_init(&loopback, NULL, 0);
+    sim_attach(_SPI1, &loopback.dev);
+    cfg = sim_default_config(format, buffer);
+    sim_set_access_hook(golden_hook);
+    golden_call("spi_init %s %s", (format == BITS8) ? "BITS8" : "BITS16", (buffer == STANDARD_BUFFER) ? "STANDARD" : "ENHANCED");
+    golden_result(spi_init(_SPI1, &cfg, &spi1), NULL, 0, 1);
+}
+//------------------------------------------------------------------------------
+/**
+ * spi_init (roles, frame modes, invalid configurations), spi_init_regs,
+ * spi_reconfigure, spi_set_spin_budget, spi_set_transfer_mode
+ */
+static void test_init(void){
+    spi_config_t    cfg;
+
+    golden_begin();
+    sim_reset();
+    sim_set_access_hook(golden_hook);
+
+    cfg = sim_default_config(BITS16, ENHANCED_BUFFER);
+    cfg.spiClockPolarity = CLK_IDLE_IS_HIGH;
+    cfg.spiSamplePoint = END_SMP;
+    cfg.spiPrimaryPrescaler = PRI_PRE_16;
+    cfg.spiSecondaryPrescaler = SEC_PRE_3;
+    golden_call("spi_init SPI1 master CKP SMP 1:16 x 1:3");
+    golden_result(spi_init(_SPI1, &cfg, &spi1), NULL, 0, 1);
+
+    cfg.spiFrameMode = SPI_FRAMED_SYNC_OUT;
+    cfg.spiFrameSyncPolarity = FSYNC_ACTIVE_HIGH;
+    golden_call("spi_init SPI1 framed sync out, active high");
+    golden_result(spi_init(_SPI1, &cfg, &spi1), NULL, 0, 1);
+
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    cfg.spiRole = SPI_SLAVE_SS;
+    golden_call("spi_init SPI2 slave SSx");
+    golden_result(spi_init(_SPI2, &cfg, &spi2), NULL, 0, 1);
+
+    cfg.spiRole = SPI_SLAVE;
+    cfg.spiClockPhase = IDLE_TO_ACTIVE_CPHASE;
+    golden_call("spi_init SPI2 slave");
+    golden_result(spi_init(_SPI2, &cfg, &spi2), NULL, 0, 1);
+
+    cfg.spiClockPhase = ACTIVE_TO_IDLE_CPHASE;
+    golden_call("spi_init SPI2 slave CKE without SSx (invalid)");
+    golden_result(spi_init(_SPI2, &cfg, &spi2), NULL, 0, 1);
+
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    cfg.spiPrimaryPrescaler = PRI_PRE_1;
+    cfg.spiSecondaryPrescaler = SEC_PRE_1;
+    golden_call("spi_init SPI1 1:1 x 1:1 (invalid)");
+    golden_result(spi_init(_SPI1, &cfg, &spi1), NULL, 0, 1);
+
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    cfg.spiRole = (spiRole_t)3;
+    golden_call("spi_init SPI1 role 3 (invalid)");
+    golden_result(spi_init(_SPI1, &cfg, &spi1), NULL, 0, 1);
+
+    golden_call("spi_init SPI1 NULL");
+    golden_result(spi_init(_SPI1, NULL, &spi1), NULL, 0, 1);
+
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    golden_call("spi_init module 7");
+    golden_result(spi_init((spi_id_t)7, &cfg, &spi1), NULL, 0, 1);
+
+    golden_call("spi_init_regs SPI3 CON1=0x0522 CON2=0x0001");
+    golden_result(spi_init_regs(_SPI3, 0x0522, 0x0001, &spi1), NULL, 0, 1);
+
+    golden_call("spi_init SPI1 BITS8 STANDARD");
+    golden_result(spi_init(_SPI1, &cfg, &spi1), NULL, 0, 1);
+
+    golden_call("spi_reconfigure CON1 BITS16 1:4 x 1:2, CON2 ENHANCED");
+    golden_result(spi_reconfigure(&spi1, SPI_CON1(CLK_IDLE_IS_LOW, ACTIVE_TO_IDLE_CPHASE, MID_SMP, BITS16, PRI_PRE_4, SEC_PRE_2),
+                                  SPI_CON2(ENHANCED_BUFFER)), NULL, 0, 1);
+
+    golden_call("spi_set_spin_budget 100");
+    spi_set_spin_budget(&spi1, 100);
+    golden_result(SPI_OK, NULL, 0, 1);
+
+    golden_call("spi_set_transfer_mode IDLE");
+    golden_result(spi_set_transfer_mode(&spi1, SPI_XFER_IDLE), NULL, 0, 1);
+    golden_call("spi_set_transfer_mode DMA");
+    golden_result(spi_set_transfer_mode(&spi1, SPI_XFER_DMA), NULL, 0, 1);
+    golden_call("spi_set_transfer_mode CPU");
+    golden_result(spi_set_transfer_mode(&spi1, SPI_XFER_CPU), NULL, 0, 1);
+
+    golden_end("init");
+}
+//------------------------------------------------------------------------------
+/**
+ * Blocking transfers, Tx / Rx buffers given or NULL
+ */
+static void test_blocking(spiBufferMode_t buffer){
+    uint8_t     tx[12], rx[14];
+    uint16_t    txw[6], rxw[6];
+    uint16_t    rxWord;
+    uint8_t     rxByte;
+    uint8_t     i;
+    spi_crc_t   crc;
+    spi_segment_t   seg[] = {{tx, rx, 2, 0xFF, 8}, {txw, rxw, 3, 0xFFFF, 16}, {NULL, rx + 2, 3, 0xA5, 8}};
+    const spi_reg_job_t jobs[] = {{&csA, 0x81, 3}, {&csB, 0x82, 3}};
+
+    for (i = 0; i < sizeof(tx); i++) tx[i] = (uint8_t)(i * 29 + 3);
+    for (i = 0; i < 6; i++) txw[i] = (uint16_t)(i * 4099 + 0x1234);
+
+    golden_begin();
+    golden_setup(BITS8, buffer);
+    golden_call("spi_transfer_raw_byte 0x5A");
+    golden_result(spi_transfer_raw_byte(&spi1, 0x5A, &rxByte), &rxByte, 1, 1);
+    golden_call("spi_transfer_raw_byte 0xC3 NULL");
+    golden_result(spi_transfer_raw_byte(&spi1, 0xC3, NULL), NULL, 0, 1);
+    golden_call("spi_transfer_raw_word (BITS8)");
+    golden_result(spi_transfer_raw_word(&spi1, 0x1234, &rxWord), NULL, 0, 1);
+
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_transfer_raw_bytes tx rx 10");
+    golden_result(spi_transfer_raw_bytes(&spi1, tx, rx, 10), rx, 10, 1);
+    golden_call("spi_transfer_raw_bytes NULL rx 10");
+    golden_result(spi_transfer_raw_bytes(&spi1, NULL, rx, 10), rx, 10, 1);
+    golden_call("spi_transfer_raw_bytes tx NULL 10");
+    golden_result(spi_transfer_raw_bytes(&spi1, tx, NULL, 10), NULL, 0, 1);
+    golden_call("spi_transfer_raw_bytes NULL NULL 3");
+    golden_result(spi_transfer_raw_bytes(&spi1, NULL, NULL, 3), NULL, 0, 1);
+    golden_call("spi_transfer_raw_bytes tx rx 0");
+    golden_result(spi_transfer_raw_bytes(&spi1, tx, rx, 0), NULL, 0, 1);
+
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_transfer_packed_bytes tx rx %u", SPI_PACKED_MIN_LEN - 1);
+    golden_result(spi_transfer_packed_bytes(&spi1, tx, rx, SPI_PACKED_MIN_LEN - 1), rx, SPI_PACKED_MIN_LEN - 1, 1);
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_transfer_packed_bytes tx rx 11");
+    golden_result(spi_transfer_packed_bytes(&spi1, tx, rx, 11), rx, 11, 1);
+    golden_call("spi_transfer_packed_bytes NULL rx 11");
+    golden_result(spi_transfer_packed_bytes(&spi1, NULL, rx, 11), rx, 11, 1);
+
+    golden_call("spi_transfer_byte_reg 0x12 0x34");
+    golden_result(spi_transfer_byte_reg(&spi1, 0x12, 0x34, &rxByte), &rxByte, 1, 1);
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_transfer_byte_regs 0x81 out in 4");
+    golden_result(spi_transfer_byte_regs(&spi1, 0x81, tx, rx, 4), rx, 4, 1);
+    golden_call("spi_transfer_byte_regs 0x81 NULL in 4");
+    golden_result(spi_transfer_byte_regs(&spi1, 0x81, NULL, rx, 4), rx, 4, 1);
+    golden_call("spi_transfer_byte_regs 0x01 out NULL 4");
+    golden_result(spi_transfer_byte_regs(&spi1, 0x01, tx, NULL, 4), NULL, 0, 1);
+
+    memset(rx, 0, sizeof(rx));
+    memset(rxw, 0, sizeof(rxw));
+    golden_call("spi_transfer_segments 8 / 16 / 8 fill 0xA5");
+    golden_result(spi_transfer_segments(&spi1, seg, 3), rx, 5, 1);
+    golden_result(SPI_OK, rxw, 3, 2);
+
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_transfer_reg_batch 2 jobs x 3");
+    golden_result(spi_transfer_reg_batch(&spi1, jobs, 2, rx, 2), rx, 6, 1);
+
+    memset(rx, 0, sizeof(rx));
+    spi_crc_init(&crc, SPI_CRC16, 0);
+    golden_call("spi_transfer_crc_bytes tx rx 6 CRC16 SEND CHECK");
+    golden_result(spi_transfer_crc_bytes(&spi1, tx, rx, 6, &crc, SPI_CRC_SEND | SPI_CRC_CHECK), rx, 6, 1);
+    golden_printf("  crc %04X %04X\n", crc.txCrc, crc.rxCrc);
+    spi_crc_init(&crc, SPI_CRC7, 0);
+    golden_call("spi_transfer_crc_bytes NULL rx 4 CRC7 CHECK");
+    golden_result(spi_transfer_crc_bytes(&spi1, NULL, rx, 4, &crc, SPI_CRC_CHECK), rx, 4, 1);
+
+    golden_call("spi_transfer_raw_words (BITS8)");
+    golden_result(spi_transfer_raw_words(&spi1, txw, rxw, 2), NULL, 0, 1);
+
+    golden_setup(BITS16, buffer);
+    golden_call("spi_transfer_raw_word 0xBEEF");
+    golden_result(spi_transfer_raw_word(&spi1, 0xBEEF, &rxWord), &rxWord, 1, 2);
+    golden_call("spi_transfer_raw_byte (BITS16)");
+    golden_result(spi_transfer_raw_byte(&spi1, 0x5A, &rxByte), NULL, 0, 1);
+    memset(rxw, 0, sizeof(rxw));
+    golden_call("spi_transfer_raw_words tx rx 6");
+    golden_result(spi_transfer_raw_words(&spi1, txw, rxw, 6), rxw, 6, 2);
+    golden_call("spi_transfer_raw_words NULL rx 6");
+    golden_result(spi_transfer_raw_words(&spi1, NULL, rxw, 6), rxw, 6, 2);
+    golden_call("spi_transfer_raw_words tx NULL 6");
+    golden_result(spi_transfer_raw_words(&spi1, txw, NULL, 6), NULL, 0, 1);
+    golden_call("spi_transfer_word_reg 0x8001 0x5555");
+    golden_result(spi_transfer_word_reg(&spi1, 0x8001, 0x5555, &rxWord), &rxWord, 1, 2);
+    memset(rxw, 0, sizeof(rxw));
+    golden_call("spi_transfer_word_regs 0x8002 NULL in 3");
+    golden_result(spi_transfer_word_regs(&spi1, 0x8002, NULL, rxw, 3), rxw, 3, 2);
+    golden_call("spi_transfer_packed_bytes (BITS16)");
+    golden_result(spi_transfer_packed_bytes(&spi1, tx, rx, 11), NULL, 0, 1);
+
+    golden_end((buffer == STANDARD_BUFFER) ? "blocking_std" : "blocking_enh");
+}
+//------------------------------------------------------------------------------
+/**
+ * SPI_XFER_IDLE : one frame at a time, SPIxIF waking the core up
+ */
+static void test_idle(void){
+    spi_config_t    cfg;
+    uint8_t     tx[4] = {0x81, 0x42, 0x24, 0x18}, rx[4];
+
+    golden_begin();
+    sim_reset();
+    sim_loopback_init(&loopback, NULL, 0);
+    sim_attach(_SPI1, &loopback.dev);
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    cfg.spiPrimaryPrescaler = PRI_PRE_64;
+    cfg.spiSecondaryPrescaler = SEC_PRE_8;
+    sim_set_access_hook(golden_hook);
+    golden_call("spi_init BITS8 STANDARD 1:64 x 1:8");
+    golden_result(spi_init(_SPI1, &cfg, &spi1), NULL, 0, 1);
+    golden_call("spi_set_transfer_mode IDLE");
+    golden_result(spi_set_transfer_mode(&spi1, SPI_XFER_IDLE), NULL, 0, 1);
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_transfer_raw_bytes tx rx 4");
+    golden_result(spi_transfer_raw_bytes(&spi1, tx, rx, sizeof(tx)), rx, sizeof(tx), 1);
+    golden_call("spi_transfer_raw_bytes NULL rx 2");
+    golden_result(spi_transfer_raw_bytes(&spi1, NULL, rx, 2), rx, 2, 1);
+    golden_end("idle");
+}
+//------------------------------------------------------------------------------
+static void golden_async_callback(spi_desc_t *pSpi, spi_err_t result, void *pCtx){
+    (void)pSpi;
+    (void)pCtx;
+    golden_printf("  callback %d\n", (int)result);
+}
+//------------------------------------------------------------------------------
+static void golden_stream_callback(spi_desc_t *pSpi, void *pBuffer, void *pCtx){
+    (void)pCtx;
+    golden_printf("  slot %u\n", (unsigned int)(((uint8_t*)pBuffer - (uint8_t*)pCtx) / 4));
+    nbCallbacks++;
+    spi_stream_release(pSpi, pBuffer);
+}
+//------------------------------------------------------------------------------
+static void golden_script_callback(spi_desc_t *pSpi, uint16_t code, void *pCtx){
+    (void)pSpi;
+    (void)pCtx;
+    golden_printf("  step %u\n", code);
+}
+//------------------------------------------------------------------------------
+static void golden_wait(void){
+    while (spi_async_status(&spi1) == SPI_ASYNC_BUSY) Idle();
+    golden_printf("  status %d\n", (int)spi_async_status(&spi1));
+}
+//------------------------------------------------------------------------------
+/**
+ * Interrupt driven transfers : async, cancel, stream, script
+ */
+static void test_async(spiBufferMode_t buffer){
+    uint8_t     tx[12], rx[12], slots[3 * 4];
+    uint16_t    txw[5], rxw[5];
+    uint8_t     i;
+    const spi_script_op_t   script[] = {SPI_SCRIPT_CS_ASSERT(&csA), SPI_SCRIPT_TX_LIT(0xA8), SPI_SCRIPT_RX_BUF(rx, 3),
+                                        SPI_SCRIPT_CS_RELEASE(&csA), SPI_SCRIPT_CALLBACK(1), SPI_SCRIPT_DELAY(2),
+                                        SPI_SCRIPT_CS_ASSERT(&csB), SPI_SCRIPT_TX_BUF(tx, 2), SPI_SCRIPT_CS_RELEASE(&csB),
+                                        SPI_SCRIPT_END()};
+
+    for (i = 0; i < sizeof(tx); i++) tx[i] = (uint8_t)(0xA0 + i);
+    for (i = 0; i < 5; i++) txw[i] = (uint16_t)(0xF00D + i * 0x1111);
+
+    golden_begin();
+    golden_setup(BITS8, buffer);
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_transfer_async tx rx 12 callback");
+    golden_result(spi_transfer_async(&spi1, tx, rx, sizeof(tx), golden_async_callback, NULL), NULL, 0, 1);
+    golden_wait();
+    golden_result(SPI_OK, rx, sizeof(rx), 1);
+    golden_call("spi_transfer_async NULL rx 3");
+    golden_result(spi_transfer_async(&spi1, NULL, rx, 3, NULL, NULL), NULL, 0, 1);
+    golden_wait();
+    golden_result(SPI_OK, rx, 3, 1);
+    golden_call("spi_transfer_async tx NULL 12 + spi_async_cancel");
+    golden_result(spi_transfer_async(&spi1, tx, NULL, sizeof(tx), golden_async_callback, NULL), NULL, 0, 1);
+    golden_result(spi_async_cancel(&spi1), NULL, 0, 1);
+    golden_printf("  status %d\n", (int)spi_async_status(&spi1));
+
+    nbCallbacks = 0;
+    golden_call("spi_stream_start 3 x 4 command 0x80");
+    golden_result(spi_stream_start(&spi1, slots, 3, 4, 0x80, NULL, golden_stream_callback, slots), NULL, 0, 1);
+    while (nbCallbacks < 4) Idle();
+    golden_call("spi_stream_stop");
+    golden_result(spi_stream_stop(&spi1), NULL, 0, 1);
+    golden_call("spi_stream_start per frame CS 2 x 2 command 0x81");
+    golden_result(spi_stream_start(&spi1, slots, 2, 2, 0x81, &csA, golden_stream_callback, slots), NULL, 0, 1);
+    nbCallbacks = 0;
+    while (nbCallbacks < 2) Idle();
+    golden_call("spi_stream_stop");
+    golden_result(spi_stream_stop(&spi1), NULL, 0, 1);
+
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_script_start");
+    golden_result(spi_script_start(&spi1, script, golden_script_callback, golden_async_callback, NULL), NULL, 0, 1);
+    golden_wait();
+    golden_result(SPI_OK, rx, 3, 1);
+
+    golden_setup(BITS16, buffer);
+    memset(rxw, 0, sizeof(rxw));
+    golden_call("spi_transfer_async words tx rx 5");
+    golden_result(spi_transfer_async(&spi1, txw, rxw, 5, NULL, NULL), NULL, 0, 1);
+    golden_wait();
+    golden_result(SPI_OK, rxw, 5, 2);
+    golden_call("spi_transfer_async words NULL rx 5");
+    golden_result(spi_transfer_async(&spi1, NULL, rxw, 5, NULL, NULL), NULL, 0, 1);
+    golden_wait();
+    golden_result(SPI_OK, rxw, 5, 2);
+
+    golden_end((buffer == STANDARD_BUFFER) ? "async_std" : "async_enh");
+}
+//------------------------------------------------------------------------------
+/**
+ * Slave engine on SPI2, clocked by SPI1 (SS2 = RB2), and the bus arbitration
+ */
+static void test_slave(spiBufferMode_t buffer){
+    spi_config_t    cfg;
+    spi_ring_t      rxRing, txRing;
+    uint8_t     rxBuf[8], txBuf[8], tx[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66}, rx[6];
+    uint8_t     reply[3] = {0xD1, 0xD2, 0xD3};
+    uint8_t     userA, userB;       // Bus users : identified by their address
+
+    golden_begin();
+    sim_reset();
+    LATB = CS_A_MASK;
+    sim_link(_SPI1, _SPI2, &LATB, CS_A_MASK);
+    cfg = sim_default_config(BITS8, buffer);
+    CHECK(spi_init(_SPI1, &cfg, &spi1) == SPI_OK);
+    sim_set_access_hook(golden_hook);
+    cfg.spiRole = SPI_SLAVE_SS;
+    golden_call("spi_init SPI2 slave SSx");
+    golden_result(spi_init(_SPI2, &cfg, &spi2), NULL, 0, 1);
+    golden_call("spi_ring_init 8 + 8");
+    golden_result(spi_ring_init(&rxRing, rxBuf, sizeof(rxBuf), BITS8), NULL, 0, 1);
+    golden_result(spi_ring_init(&txRing, txBuf, sizeof(txBuf), BITS8), NULL, 0, 1);
+    spi_ring_write(&txRing, reply, sizeof(reply));
+    golden_call("spi_slave_start fill 0x5A");
+    golden_result(spi_slave_start(&spi2, &rxRing, &txRing, 0x5A), NULL, 0, 1);
+    golden_call("spi_slave_start SPI1 (master)");
+    golden_result(spi_slave_start(&spi1, NULL, NULL, 0x5A), NULL, 0, 1);
+
+    memset(rx, 0, sizeof(rx));
+    golden_call("master spi_transfer_raw_bytes tx rx 6 (SS2 asserted)");
+    spi_cs_assert(&csA);
+    golden_result(spi_transfer_raw_bytes(&spi1, tx, rx, sizeof(tx)), rx, sizeof(rx), 1);
+    spi_cs_release(&csA);
+    memset(rx, 0, sizeof(rx));
+    golden_printf("  ring %u\n", spi_ring_read(&rxRing, rx, sizeof(rx)));
+    golden_result(SPI_OK, rx, sizeof(rx), 1);
+    golden_printf("  underruns %u overruns %u\n", spi_slave_underruns(&spi2), spi_slave_overruns(&spi2));
+    golden_call("spi_transfer_raw_byte SPI2 (engine running)");
+    golden_result(spi_transfer_raw_byte(&spi2, 0x00, NULL), NULL, 0, 1);
+    golden_call("spi_slave_stop");
+    golden_result(spi_slave_stop(&spi2), NULL, 0, 1);
+
+    golden_call("spi_bus_acquire A 1");
+    golden_result(spi_bus_acquire(&spi1, &userA, 1, NULL, NULL), NULL, 0, 1);
+    golden_call("spi_bus_acquire B 1 (owned)");
+    golden_result(spi_bus_acquire(&spi1, &userB, 1, NULL, NULL), NULL, 0, 1);
+    golden_call("spi_bus_release B (not owner)");
+    golden_result(spi_bus_release(&spi1, &userB), NULL, 0, 1);
+    golden_call("spi_bus_release A");
+    golden_result(spi_bus_release(&spi1, &userA), NULL, 0, 1);
+    golden_printf("  owner %s\n", (spi_bus_owner(&spi1) == NULL) ? "none" : "?");
+
+    golden_end((buffer == STANDARD_BUFFER) ? "slave_std" : "slave_enh");
+}
+//------------------------------------------------------------------------------
+/**
+ * Device layer : configuration switch on select, transaction, batch
+ */
+static void test_device(void){
+    spi_config_t    cfg;
+    spi_device_t    devA, devB;
+    uint8_t     tx[4] = {0x9F, 0x01, 0x02, 0x03}, rx[6];
+    uint16_t    txw[2] = {0xCAFE, 0x0BAD}, rxw[2];
+    const spi_segment_t seg[] = {{tx, NULL, 1, 0, 0}, {NULL, rx, 3, 0xFF, 0}};
+    const spi_transaction_t trans = {seg, 2};
+    const spi_reg_job_t jobs[] = {{&csA, 0xE8, 2}, {&csB, 0xE8, 2}};
+
+    golden_begin();
+    golden_setup(BITS8, ENHANCED_BUFFER);
+    cfg = sim_default_config(BITS8, ENHANCED_BUFFER);
+    golden_call("spi_device_init A");
+    golden_result(spi_device_init(&devA, &spi1, &cfg, &csA), NULL, 0, 1);
+    cfg.spiDataFormat = BITS16;
+    cfg.spiClockPolarity = CLK_IDLE_IS_HIGH;
+    golden_call("spi_device_init B BITS16 CKP");
+    golden_result(spi_device_init(&devB, &spi1, &cfg, &csB), NULL, 0, 1);
+
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_device_transfer_bytes A tx rx 4");
+    golden_result(spi_device_transfer_bytes(&devA, tx, rx, 4), rx, 4, 1);
+    memset(rxw, 0, sizeof(rxw));
+    golden_call("spi_device_transfer_words B tx rx 2");
+    golden_result(spi_device_transfer_words(&devB, txw, rxw, 2), rxw, 2, 2);
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_device_transaction A");
+    golden_result(spi_device_transaction(&devA, &trans), rx, 3, 1);
+    golden_call("spi_device_select B + spi_device_release");
+    golden_result(spi_device_select(&devB), NULL, 0, 1);
+    spi_device_release(&devB);
+    memset(rx, 0, sizeof(rx));
+    golden_call("spi_device_read_batch A 2 jobs x 2");
+    golden_result(spi_device_read_batch(&devA, jobs, 2, rx, 2), rx, 4, 1);
+
+    golden_end("device");
+}
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[]){
+    struct itimerval    noTick;
+
+    // No tick : the ISRs only run on the SFR accesses and Idle(), so that the 
+    // order of the writes does not depend on the host timing
+    memset(&noTick, 0, sizeof(noTick));
+    setitimer(ITIMER_REAL, &noTick, NULL);
+    goldenUpdate = (argc > 1) && (strcmp(argv[1], "-u") == 0);
+    test_init();
+    test_blocking(STANDARD_BUFFER);
+    test_blocking(ENHANCED_BUFFER);
+    test_idle();
+    test_async(STANDARD_BUFFER);
+    test_async(ENHANCED_BUFFER);
+    test_slave(STANDARD_BUFFER);
+    test_slave(ENHANCED_BUFFER);
+    test_device();
+    printf("#test_golden,checks=%u,errors=%u\n", nbChecks, nbErrors);
+    return nbErrors ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file    test_ll.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Tests of lib_spi_pic24_ll on the SPI model (built with SPI_USE_STATS and SPI_USE_TRACE, 
+ *          SPI_TRACE_DEPTH = 256)
+ *
+ */
+
+#include <string.h>
+#include "spi_sim.h"
+#include "lib_spi_pic24_ll.h"
+
+/* Directives de compilation - Macros		*/
+
+/* Declarations des variables globales 	*/
+static uint16_t     nbChecks, nbErrors;
+static spi_desc_t   spi1;
+static sim_loopback_t   loopback;
+static uint16_t     nbStatWrites, nbCon1Writes;
+
+/*	Implementation du code */
+static void test_hook(const char *pName, uint16_t value, uint8_t write){
+    (void)value;
+    if (!write) return;
+    if (strcmp(pName, "SPI1STAT") == 0) nbStatWrites++;
+    else if (strcmp(pName, "SPI1CON1") == 0) nbCon1Writes++;
+}
+//------------------------------------------------------------------------------
+static uint32_t test_timer(void){
+    return (uint32_t)sim_cycles();
+}
+//------------------------------------------------------------------------------
+static void test_setup(spiBufferMode_t buffer){
+    spi_config_t    cfg;
+    spi_trace_rec_t rec;
+
+    cfg = sim_default_config(BITS8, buffer);
+    sim_reset();
+    sim_loopback_init(&loopback, NULL, 0);
+    sim_attach(_SPI1, &loopback.dev);
+    CHECK(spi_init(_SPI1, &cfg, &spi1) == SPI_OK);
+    spi_stats_set_timer(&spi1, test_timer);
+    spi_trace_set_timer(test_timer);
+    spi_trace_enable(1);
+    while (spi_trace_drain(&rec, 1));
+}
+//------------------------------------------------------------------------------
+static void test_counts_reset(void){
+    nbStatWrites = 0;
+    nbCon1Writes = 0;
+    sim_set_access_hook(test_hook);
+}
+//------------------------------------------------------------------------------
+/**
+ * spi_transfer_packed_bytes : MODE16 switched with the module enabled, short
+ * transfers counted as packed calls
+ */
+static void test_packed(spiBufferMode_t buffer){
+    uint8_t     tx[33], rx[33];
+    uint8_t     i;
+    uint32_t    warnings = sim_warnings();
+    spi_stats_t stats;
+    spi_trace_rec_t rec;
+
+    for (i = 0; i < sizeof(tx); i++) tx[i] = (uint8_t)(i * 29 + 3);
+    test_setup(buffer);
+    spi_stats_snapshot(&spi1, &stats, 1);
+
+    // Short : 8 bits frames, no register written
+    memset(rx, 0, sizeof(rx));
+    test_counts_reset();
+    CHECK(spi_transfer_packed_bytes(&spi1, tx, rx, SPI_PACKED_MIN_LEN - 1) == SPI_OK);
+    sim_set_access_hook(NULL);
+    CHECK(memcmp(tx, rx, SPI_PACKED_MIN_LEN - 1) == 0);
+    CHECK(nbStatWrites == 0);
+    CHECK(nbCon1Writes == 0);
+    CHECK(spi_trace_drain(&rec, 1) == 1);
+    CHECK(rec.op == SPI_TRACE_PACKED_BYTES);
+    CHECK(rec.len == SPI_PACKED_MIN_LEN - 1);
+    CHECK(spi_trace_drain(&rec, 1) == 0);
+    spi_stats_snapshot(&spi1, &stats, 1);
+    CHECK(stats.nbTransactions == 1);
+    CHECK(stats.nbBytes == SPI_PACKED_MIN_LEN - 1);
+
+    // Odd length : MODE16 set then cleared, SPIEN cleared around each write
+    memset(rx, 0, sizeof(rx));
+    test_counts_reset();
+    CHECK(spi_transfer_packed_bytes(&spi1, tx, rx, sizeof(tx)) == SPI_OK);
+    sim_set_access_hook(NULL);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+    CHECK(nbStatWrites == 4);
+    CHECK(nbCon1Writes == 2);
+    CHECK(!(SPI1CON1 & MODE16_MASK));
+    CHECK(spi1.spiDataFormat == BITS8);
+    CHECK(sim_warnings() == warnings);
+    CHECK(spi_trace_drain(&rec, 1) == 1);
+    CHECK(rec.op == SPI_TRACE_PACKED_BYTES);
+}
+//------------------------------------------------------------------------------
+/**
+ * spi_transfer_segments : one SPIxCON1 write per width change
+ */
+static void test_segments(spiBufferMode_t buffer){
+    uint8_t     cmd[3] = {0x0B, 0x12, 0x34}, cmdRx[3], tail[5], tailRx[5];
+    uint16_t    words[4] = {0x1234, 0xABCD, 0x0F0F, 0x8001}, wordsRx[4];
+    spi_segment_t   seg[] = {{cmd, cmdRx, 3, 0xFF, 8}, {words, wordsRx, 4, 0xFFFF, 16},
+                             {NULL, NULL, 0, 0xFF, 8}, {words, wordsRx, 0, 0xFFFF, 16}, {tail, tailRx, 5, 0xFF, 0}};
+    uint32_t    warnings = sim_warnings();
+
+    memset(tail, 0x5C, sizeof(tail));
+    test_setup(buffer);
+    test_counts_reset();
+    CHECK(spi_transfer_segments(&spi1, seg, sizeof(seg) / sizeof(seg[0])) == SPI_OK);
+    sim_set_access_hook(NULL);
+    CHECK(memcmp(cmd, cmdRx, sizeof(cmd)) == 0);
+    CHECK(memcmp(words, wordsRx, sizeof(words)) == 0);
+    CHECK(memcmp(tail, tailRx, sizeof(tail)) == 0);
+    CHECK(nbStatWrites == 4);       // SPIEN cleared / set around each SPIxCON1 write
+    CHECK(nbCon1Writes == 2);       // 8 -> 16 -> 8 (empty segments do not count)
+    CHECK(spi1.spiDataFormat == BITS8);
+    CHECK(sim_warnings() == warnings);
+}
+//------------------------------------------------------------------------------
+/**
+ * Trace ring of SPI_TRACE_DEPTH = 256 records : full ring kept, next record lost
+ */
+static void test_trace_full(void){
+    spi_trace_rec_t rec;
+    uint16_t    i, nb;
+
+    test_setup(STANDARD_BUFFER);
+    (void)spi_trace_lost();
+    for (i = 0; i < SPI_TRACE_DEPTH; i++) CHECK(spi_transfer_raw_byte(&spi1, (uint8_t)i, NULL) == SPI_OK);
+    CHECK(spi_trace_lost() == 0);
+    CHECK(spi_transfer_raw_byte(&spi1, 0xEE, NULL) == SPI_OK);
+    CHECK(spi_trace_lost() == 1);
+    for (nb = 0; spi_trace_drain(&rec, 1) == 1; nb++){
+        if (rec.data[0] != (uint8_t)nb) break;
+    }
+    CHECK(nb == SPI_TRACE_DEPTH);
+    // Indices past 256
+    CHECK(spi_transfer_raw_byte(&spi1, 0x42, NULL) == SPI_OK);
+    CHECK(spi_trace_drain(&rec, 1) == 1);
+    CHECK(rec.data[0] == 0x42);
+    CHECK(spi_trace_drain(&rec, 1) == 0);
+}
+//------------------------------------------------------------------------------
+int main(void){
+    test_packed(STANDARD_BUFFER);
+    test_packed(ENHANCED_BUFFER);
+    test_segments(STANDARD_BUFFER);
+    test_segments(ENHANCED_BUFFER);
+    test_trace_full();
+    printf("#test_ll,checks=%u,errors=%u\n", nbChecks, nbErrors);
+    return nbErrors ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file    test_regmap.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Tests of lib_spi_pic24_regmap on the SPI model (register device)
+ *
+ */
+
+#include <string.h>
+#include "spi_sim.h"
+#include "lib_spi_pic24_regmap.h"
+
+/* Directives de compilation - Macros		*/
+#define CS_MASK         (1 << 2)    // RB2
+#define NB_REGS         16
+#define REG_CTRL        0x02
+#define REG_CTRL2       0x03
+#define REG_STATUS      0x08        // Volatile
+#define REG_CMD         0x09        // Volatile
+
+/* Declarations des variables globales 	*/
+static uint16_t     nbChecks, nbErrors;
+static uint16_t     nbForeignFrames;    /**< Frames sent while the bus is not owned by dev */
+static spi_desc_t   spi1;
+static spi_device_t dev;
+static sim_regdev_t regdev;
+static spi_regmap_t map;
+static uint8_t      shadow[NB_REGS], state[NB_REGS];
+
+/*	Implementation du code */
+static void test_setup(void){
+    spi_config_t    cfg;
+    spi_cs_t    cs = {NULL, NULL, &LATB, CS_MASK};
+    spi_regmap_config_t mapCfg = {0x80, 0x00, 0x00, 1};
+
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    sim_reset();
+    LATB = CS_MASK;
+    sim_regdev_init(&regdev, &LATB, CS_MASK);
+    sim_attach(_SPI1, &regdev.dev);
+    CHECK(spi_init(_SPI1, &cfg, &spi1) == SPI_OK);
+    CHECK(spi_device_init(&dev, &spi1, &cfg, &cs) == SPI_OK);
+    memset(state, 0, sizeof(state));
+    state[REG_STATUS] = SPI_REG_VOLATILE;
+    state[REG_CMD] = SPI_REG_VOLATILE;
+    CHECK(spi_regmap_init(&map, &dev, &mapCfg, NB_REGS, shadow, state) == SPI_OK);
+}
+//------------------------------------------------------------------------------
+/**
+ * Staged writes reach the device before any later access to the device, 
+ * whatever the function used (read, read_block, volatile write)
+ */
+static void test_ordering(void){
+    uint8_t value, block[2];
+
+    test_setup();
+    regdev.regs[REG_STATUS] = 0x5A;
+
+    // Staged write, then volatile read
+    CHECK(spi_regmap_write(&map, REG_CTRL, 0x11) == SPI_OK);
+    CHECK(regdev.nbLog == 0);
+    CHECK(spi_regmap_read(&map, REG_STATUS, &value) == SPI_OK);
+    CHECK(value == 0x5A);
+    CHECK(regdev.nbLog == 2);
+    CHECK(regdev.log[0].write && (regdev.log[0].reg == REG_CTRL) && (regdev.log[0].value == 0x11));
+    CHECK(!regdev.log[1].write && (regdev.log[1].reg == REG_STATUS));
+    CHECK(!(state[REG_CTRL] & SPI_REG_DIRTY));
+
+    // Staged write, then uncached read
+    regdev.nbLog = 0;
+    regdev.regs[REG_CTRL2] = 0x33;
+    CHECK(spi_regmap_write(&map, REG_CTRL, 0x22) == SPI_OK);
+    CHECK(spi_regmap_read(&map, REG_CTRL2, &value) == SPI_OK);
+    CHECK(value == 0x33);
+    CHECK(regdev.nbLog == 2);
+    CHECK(regdev.log[0].write && (regdev.log[0].reg == REG_CTRL) && (regdev.log[0].value == 0x22));
+
+    // Cached read : no bus access
+    regdev.nbLog = 0;
+    CHECK(spi_regmap_read(&map, REG_CTRL2, &value) == SPI_OK);
+    CHECK(regdev.nbLog == 0);
+
+    // Staged write, then volatile write
+    CHECK(spi_regmap_write(&map, REG_CTRL, 0x44) == SPI_OK);
+    CHECK(spi_regmap_write(&map, REG_CMD, 0x01) == SPI_OK);
+    CHECK(regdev.nbLog == 2);
+    CHECK(regdev.log[0].write && (regdev.log[0].reg == REG_CTRL) && (regdev.log[0].value == 0x44));
+    CHECK(regdev.log[1].write && (regdev.log[1].reg == REG_CMD));
+
+    // Staged writes, then block read (adjacent dirty registers in one burst)
+    regdev.nbLog = 0;
+    CHECK(spi_regmap_write(&map, REG_CTRL, 0x55) == SPI_OK);
+    CHECK(spi_regmap_write(&map, REG_CTRL2, 0x66) == SPI_OK);
+    CHECK(spi_regmap_read_block(&map, REG_CTRL, block, 2) == SPI_OK);
+    CHECK((block[0] == 0x55) && (block[1] == 0x66));
+    CHECK(regdev.nbLog == 4);
+    CHECK(regdev.log[0].write && regdev.log[1].write && !regdev.log[2].write && !regdev.log[3].write);
+}
+//------------------------------------------------------------------------------
+static void test_owner_hook(const char *pName, uint16_t value, uint8_t write){
+    (void)value;
+    if (write && !strcmp(pName, "SPI1BUF") && (spi_bus_owner(&spi1) != &dev)) nbForeignFrames++;
+}
+//------------------------------------------------------------------------------
+/**
+ * spi_regmap_update_bits : volatile register read then written (2 CS 
+ * windows) with the bus held, cacheable register updated in the shadow copy
+ */
+static void test_update_bits(void){
+    spi_device_t    other;
+    spi_config_t    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    uint8_t     value;
+
+    test_setup();
+    regdev.regs[REG_CMD] = 0xA5;
+    nbForeignFrames = 0;
+    sim_set_access_hook(test_owner_hook);
+    CHECK(spi_regmap_update_bits(&map, REG_CMD, 0x0F, 0x03) == SPI_OK);
+    sim_set_access_hook(NULL);
+    CHECK(regdev.regs[REG_CMD] == 0xA3);
+    CHECK(regdev.nbLog == 2);
+    CHECK(!regdev.log[0].write && (regdev.log[0].reg == REG_CMD));
+    CHECK(regdev.log[1].write && (regdev.log[1].reg == REG_CMD) && (regdev.log[1].value == 0xA3));
+    CHECK(nbForeignFrames == 0);
+    CHECK(spi_bus_owner(&spi1) == NULL);
+
+    // Bus owned by another user : nothing sent
+    regdev.nbLog = 0;
+    CHECK(spi_device_init(&other, &spi1, &cfg, NULL) == SPI_OK);
+    CHECK(spi_bus_acquire(&spi1, &other, 0, NULL, NULL) == SPI_OK);
+    CHECK(spi_regmap_update_bits(&map, REG_CMD, 0x0F, 0x00) == SPI_BUSY);
+    CHECK(regdev.nbLog == 0);
+    CHECK(spi_bus_release(&spi1, &other) == SPI_OK);
+
+    // Bus already owned by the device : kept
+    CHECK(spi_bus_acquire(&spi1, &dev, 0, NULL, NULL) == SPI_OK);
+    CHECK(spi_regmap_update_bits(&map, REG_CMD, 0x0F, 0x00) == SPI_OK);
+    CHECK(regdev.regs[REG_CMD] == 0xA0);
+    CHECK(spi_bus_owner(&spi1) == &dev);
+    CHECK(spi_bus_release(&spi1, &dev) == SPI_OK);
+
+    // Cacheable register : read once, the update is staged
+    regdev.nbLog = 0;
+    regdev.regs[REG_CTRL] = 0xF0;
+    CHECK(spi_regmap_update_bits(&map, REG_CTRL, 0x81, 0x01) == SPI_OK);
+    CHECK(regdev.nbLog == 1);
+    CHECK(spi_regmap_read(&map, REG_CTRL, &value) == SPI_OK);
+    CHECK(value == 0x71);
+    CHECK(state[REG_CTRL] & SPI_REG_DIRTY);
+    CHECK(spi_regmap_flush(&map) == SPI_OK);
+    CHECK(regdev.regs[REG_CTRL] == 0x71);
+}
+//------------------------------------------------------------------------------
+int main(void){
+    test_ordering();
+    test_update_bits();
+    printf("#test_regmap,checks=%u,errors=%u\n", nbChecks, nbErrors);
+    return nbErrors ? 1 : 0;
+}
@@ -0,0 +1,247 @@
+/**
+ * @file    test_sim.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Tests of the SPI model (timing, flags, FIFOs, interrupts, slave link)
+ *
+ */
+
+#include <string.h>
+#include "spi_sim.h"
+#include "lib_spi_pic24_ll.h"
+
+/* Directives de compilation - Macros		*/
+
+/* Declarations des variables globales 	*/
+static uint16_t     nbChecks, nbErrors;
+static spi_desc_t   spi1, spi2;
+static sim_loopback_t   loopback;
+static uint16_t     nbBufWrites, isrFrames;
+
+/*	Implementation du code */
+static void test_setup(spiDataFormat_t format, spiBufferMode_t buffer, tPriPrescaler pri, tSecPrescaler sec){
+    spi_config_t    cfg;
+
+    sim_reset();
+    sim_loopback_init(&loopback, NULL, 0);
+    sim_attach(_SPI1, &loopback.dev);
+    cfg = sim_default_config(format, buffer);
+    cfg.spiPrimaryPrescaler = pri;
+    cfg.spiSecondaryPrescaler = sec;
+    CHECK(spi_init(_SPI1, &cfg, &spi1) == SPI_OK);
+}
+//------------------------------------------------------------------------------
+/**
+ * One frame : bits x Tpri x Tsec cycles, SPIRBF and SPIxIF set at the end
+ */
+static void test_frame(void){
+    uint64_t    start;
+    uint8_t     rx;
+
+    test_setup(BITS8, STANDARD_BUFFER, PRI_PRE_4, SEC_PRE_8);
+    start = sim_cycles();
+    SPI1BUF = 0x5A;
+    CHECK(!(SPI1STAT & SPITBF_MASK));   // Moved at once to the shift register
+    CHECK(!(SPI1STAT & SPIRBF_MASK));
+    while (!(SPI1STAT & SPIRBF_MASK));
+    CHECK(sim_cycles() - start >= 8 * 4 * 8);
+    CHECK(sim_cycles() - start < (8 * 4 * 8) + 16);
+    CHECK(_SPI1IF);
+    CHECK(SPI1BUF == 0x5A);
+    CHECK(!(SPI1STAT & SPIRBF_MASK));
+
+    CHECK(spi_transfer_raw_byte(&spi1, 0xC3, &rx) == SPI_OK);
+    CHECK(rx == 0xC3);
+}
+//------------------------------------------------------------------------------
+/**
+ * Standard buffer : a frame received while SPIRBF is set sets SPIROV
+ */
+static void test_overrun(void){
+    test_setup(BITS8, STANDARD_BUFFER, PRI_PRE_1, SEC_PRE_8);
+    SPI1BUF = 0x01;
+    while (!(SPI1STAT & SPIRBF_MASK));
+    SPI1BUF = 0x02;
+    sim_delay(100);
+    CHECK(SPI1STAT & SPIROV_MASK);
+    CHECK(SPI1BUF == 0x01);         // Second frame lost
+    SPI1STAT &= ~SPIROV_MASK;
+    CHECK(!(SPI1STAT & SPIROV_MASK));
+}
+//------------------------------------------------------------------------------
+/**
+ * Enhanced buffer : 8 deep FIFOs, SRXMPT / SRMPT / SPITBF, back to back frames
+ */
+static void test_fifo(void){
+    uint8_t     i;
+    uint64_t    start;
+    uint8_t     tx[64], rx[64];
+    uint16_t    txw[33], rxw[33];
+
+    test_setup(BITS8, ENHANCED_BUFFER, PRI_PRE_1, SEC_PRE_4);
+    CHECK(SPI1CON2 & SPIBEN_MASK);
+    CHECK(SPI1STAT & SRXMPT_MASK);
+    CHECK(SPI1STAT & SRMPT_MASK);
+    start = sim_cycles();
+    for (i = 0; i < 8; i++) SPI1BUF = i;
+    CHECK(!(SPI1STAT & SPITBF_MASK));   // 7 in the FIFO + 1 in the shift register
+    CHECK((SPI1STAT & (0x0007 << 8)) == (7 << 8));  // SPIBEC
+    while (SPI1STAT & SRXMPT_MASK);
+    while (!(SPI1STAT & SRMPT_MASK));
+    CHECK(sim_cycles() - start >= 8 * 8 * 4);
+    CHECK(sim_cycles() - start < (8 * 8 * 4) + 32);
+    for (i = 0; i < 8; i++) CHECK(SPI1BUF == i);
+    CHECK(SPI1STAT & SRXMPT_MASK);
+
+    for (i = 0; i < sizeof(tx); i++) tx[i] = (uint8_t)(i * 37 + 1);
+    CHECK(spi_transfer_raw_bytes(&spi1, tx, rx, sizeof(tx)) == SPI_OK);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+
+    test_setup(BITS16, ENHANCED_BUFFER, PRI_PRE_1, SEC_PRE_2);
+    for (i = 0; i < 33; i++) txw[i] = (uint16_t)(i * 4099 + 7);
+    CHECK(spi_transfer_raw_words(&spi1, txw, rxw, 33) == SPI_OK);
+    CHECK(memcmp(txw, rxw, sizeof(txw)) == 0);
+
+    sim_set_fifo(0);    // Device without SPIBEN : standard buffer
+    test_setup(BITS8, ENHANCED_BUFFER, PRI_PRE_1, SEC_PRE_2);
+    CHECK(!(SPI1CON2 & SPIBEN_MASK));
+    CHECK(spi_transfer_raw_bytes(&spi1, tx, rx, sizeof(tx)) == SPI_OK);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+    sim_set_fifo(1);
+}
+//------------------------------------------------------------------------------
+/**
+ * Interrupt driven transfer : completion polled on RAM only (tick)
+ */
+static void test_async(void){
+    uint8_t     tx[40], rx[40];
+    uint8_t     i;
+    uint16_t    ipl;
+
+    for (i = 0; i < sizeof(tx); i++) tx[i] = (uint8_t)(0xA0 + i);
+    test_setup(BITS8, STANDARD_BUFFER, PRI_PRE_16, SEC_PRE_8);
+    memset(rx, 0, sizeof(rx));
+    CHECK(spi_transfer_async(&spi1, tx, rx, sizeof(tx), NULL, NULL) == SPI_OK);
+    while (spi_async_status(&spi1) == SPI_ASYNC_BUSY);
+    CHECK(spi_async_status(&spi1) == SPI_ASYNC_DONE);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+
+    // Masked by SR.IPL : not vectored until IPL is lowered
+    test_setup(BITS8, ENHANCED_BUFFER, PRI_PRE_16, SEC_PRE_8);
+    memset(rx, 0, sizeof(rx));
+    ipl = SRbits.IPL;
+    SRbits.IPL = 7;
+    CHECK(spi_transfer_async(&spi1, tx, rx, sizeof(tx), NULL, NULL) == SPI_OK);
+    sim_delay(100000);
+    CHECK(spi_async_status(&spi1) == SPI_ASYNC_BUSY);
+    SRbits.IPL = ipl;
+    while (spi_async_status(&spi1) == SPI_ASYNC_BUSY);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+}
+//------------------------------------------------------------------------------
+/**
+ * SPI1 master -> SPI2 slave : each side receives the frame loaded by the other
+ */
+static void test_link(void){
+    spi_config_t    cfg;
+    uint8_t     rx;
+
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    cfg.spiPrimaryPrescaler = PRI_PRE_4;
+    cfg.spiSecondaryPrescaler = SEC_PRE_4;
+    sim_reset();
+    sim_link(_SPI1, _SPI2, &LATB, 1 << 2);
+    LATBbits.LATB2 = 1;
+    CHECK(spi_init(_SPI1, &cfg, &spi1) == SPI_OK);
+    cfg.spiRole = SPI_SLAVE_SS;
+    CHECK(spi_init(_SPI2, &cfg, &spi2) == SPI_OK);
+
+    SPI2BUF = 0xA5;
+    CHECK(spi_transfer_raw_byte(&spi1, 0x3C, &rx) == SPI_OK);
+    CHECK(rx == 0xFF);              // SS2 high : slave not selected
+    CHECK(!(SPI2STAT & SPIRBF_MASK));
+    LATBbits.LATB2 = 0;
+    CHECK(spi_transfer_raw_byte(&spi1, 0x3C, &rx) == SPI_OK);
+    CHECK(rx == 0xA5);
+    CHECK(SPI2STAT & SPIRBF_MASK);
+    CHECK(_SPI2IF);
+    CHECK(SPI2BUF == 0x3C);
+    CHECK(spi_transfer_raw_byte(&spi1, 0x00, &rx) == SPI_OK);
+    CHECK(rx == 0x3C);              // Nothing loaded : last frame received shifted out
+    LATBbits.LATB2 = 1;
+}
+//------------------------------------------------------------------------------
+static void test_idle_hook(const char *pName, uint16_t value, uint8_t write){
+    (void)value;
+    if (!write) return;
+    if (strcmp(pName, "SPI1BUF") == 0) nbBufWrites++;
+    else if ((strcmp(pName, "IEC2") == 0) && !isrFrames) isrFrames = nbBufWrites;    // _SPI2IE cleared by _SPI2Interrupt
+}
+//------------------------------------------------------------------------------
+/**
+ * SPI_XFER_IDLE : the core sleeps while the slow frames are shifted. Energy
+ * compared with SPI_XFER_CPU : cycles run (not idled) per call.
+ */
+static void test_idle(void){
+    uint8_t     tx[16], rx[16];
+    uint64_t    idle, start, cpuCycles, idleCycles, idleRun;
+    spi_config_t    cfg;
+
+    memset(tx, 0x81, sizeof(tx));
+    test_setup(BITS8, STANDARD_BUFFER, PRI_PRE_64, SEC_PRE_8);
+    start = sim_cycles();
+    idle = sim_idle_cycles();
+    CHECK(spi_transfer_raw_bytes(&spi1, tx, rx, sizeof(tx)) == SPI_OK);
+    cpuCycles = sim_cycles() - start;
+    CHECK(sim_idle_cycles() == idle);
+
+    CHECK(spi_set_transfer_mode(&spi1, SPI_XFER_IDLE) == SPI_OK);
+    memset(rx, 0, sizeof(rx));
+    start = sim_cycles();
+    idle = sim_idle_cycles();
+    CHECK(spi_transfer_raw_bytes(&spi1, tx, rx, sizeof(tx)) == SPI_OK);
+    idleCycles = sim_cycles() - start;
+    idleRun = idleCycles - (sim_idle_cycles() - idle);
+    CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+    CHECK(sim_idle_cycles() - idle > sizeof(tx) * 8 * 64 * 8 / 2);
+    CHECK(idleCycles < cpuCycles + cpuCycles / 8);  // Same duration (wake-up latency)
+    CHECK(idleRun * 10 < cpuCycles);                // Core running less than 10 % of the time
+    printf("#idle_energy,frames=%u,cpu_run_cycles=%llu,idle_cycles=%llu,idle_run_cycles=%llu\n", (unsigned int)sizeof(tx),
+            (unsigned long long)cpuCycles, (unsigned long long)idleCycles, (unsigned long long)idleRun);
+
+    // Interrupt of priority < SPI_IT_PRIORITY raised during the call : served 
+    // after the first frame, not held until the call returns
+    sim_reset();
+    sim_link(_SPI1, _SPI2, &LATB, 1 << 2);
+    LATBbits.LATB2 = 0;
+    cfg = sim_default_config(BITS8, STANDARD_BUFFER);
+    cfg.spiPrimaryPrescaler = PRI_PRE_64;
+    cfg.spiSecondaryPrescaler = SEC_PRE_8;
+    CHECK(spi_init(_SPI1, &cfg, &spi1) == SPI_OK);
+    cfg.spiRole = SPI_SLAVE_SS;
+    CHECK(spi_init(_SPI2, &cfg, &spi2) == SPI_OK);
+    CHECK(spi_set_transfer_mode(&spi1, SPI_XFER_IDLE) == SPI_OK);
+    _SPI2IP = SPI_IT_PRIORITY - 1;
+    _SPI2IF = 0;
+    _SPI2IE = 1;                // SPI2 slave : flag set by each frame of SPI1
+    nbBufWrites = 0;
+    isrFrames = 0;
+    sim_set_access_hook(test_idle_hook);
+    CHECK(spi_transfer_raw_bytes(&spi1, tx, NULL, 4) == SPI_OK);
+    sim_set_access_hook(NULL);
+    CHECK(nbBufWrites == 4);
+    CHECK(isrFrames == 1);
+    CHECK(SRbits.IPL == 0);
+    LATBbits.LATB2 = 1;
+}
+//------------------------------------------------------------------------------
+int main(void){
+    test_frame();
+    test_overrun();
+    test_fifo();
+    test_async();
+    test_link();
+    test_idle();
+    printf("#test_sim,checks=%u,errors=%u\n", nbChecks, nbErrors);
+    return nbErrors ? 1 : 0;
+}
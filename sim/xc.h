@@ -0,0 +1,262 @@
+/**
+ * @file    xc.h
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Host replacement of <xc.h> for the register model (see spi_sim.h)
+ *
+ * Only the symbols used by the library and by the test application are
+ * declared, with the PIC24FJ128GA010 layout, plus a third SPI module laid
+ * out as on the PIC24FJ256GA110 (SPI3 interrupt bits are an approximation).
+ *
+ * The SFRs seen by the SPI model (SPIx, interrupt controller, SR, Timer2/3,
+ * LATx) are members of simSfr, a page of memory the model keeps
+ * inaccessible so that every access is trapped. The other ones (TRISx,
+ * UART2) are plain variables.
+ *
+ */
+
+#ifndef	__SIM_XC_H__
+#define	__SIM_XC_H__
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Bit fields
+typedef struct {
+    uint16_t    :10;
+    uint16_t    SPI1IF:1;
+    uint16_t    :5;
+    } IFS0BITS;
+typedef struct {
+    uint16_t    :1;
+    uint16_t    SPI2IF:1;
+    uint16_t    :14;
+    } IFS2BITS;
+typedef struct {
+    uint16_t    :8;
+    uint16_t    SPI3IF:1;
+    uint16_t    :7;
+    } IFS5BITS;
+typedef struct {
+    uint16_t    :10;
+    uint16_t    SPI1IE:1;
+    uint16_t    :5;
+    } IEC0BITS;
+typedef struct {
+    uint16_t    :1;
+    uint16_t    SPI2IE:1;
+    uint16_t    :14;
+    } IEC2BITS;
+typedef struct {
+    uint16_t    :8;
+    uint16_t    SPI3IE:1;
+    uint16_t    :7;
+    } IEC5BITS;
+typedef struct {
+    uint16_t    :8;
+    uint16_t    SPI1IP:3;
+    uint16_t    :5;
+    } IPC2BITS;
+typedef struct {
+    uint16_t    :4;
+    uint16_t    SPI2IP:3;
+    uint16_t    :9;
+    } IPC8BITS;
+typedef struct {
+    uint16_t    SPI3IP:3;
+    uint16_t    :13;
+    } IPC22BITS;
+typedef struct {
+    uint16_t    C:1;
+    uint16_t    Z:1;
+    uint16_t    OV:1;
+    uint16_t    N:1;
+    uint16_t    RA:1;
+    uint16_t    IPL:3;
+    uint16_t    DC:1;
+    uint16_t    :7;
+    } SRBITS;
+typedef struct {
+    uint16_t    :1;
+    uint16_t    TCS:1;
+    uint16_t    :1;
+    uint16_t    T32:1;
+    uint16_t    TCKPS:2;
+    uint16_t    TGATE:1;
+    uint16_t    :6;
+    uint16_t    TSIDL:1;
+    uint16_t    :1;
+    uint16_t    TON:1;
+    } T2CONBITS;
+typedef struct {
+    uint16_t    :1;
+    uint16_t    TCS:1;
+    uint16_t    :2;
+    uint16_t    TCKPS:2;
+    uint16_t    TGATE:1;
+    uint16_t    :6;
+    uint16_t    TSIDL:1;
+    uint16_t    :1;
+    uint16_t    TON:1;
+    } T3CONBITS;
+typedef struct {
+    uint16_t    :13;
+    uint16_t    USIDL:1;
+    uint16_t    :1;
+    uint16_t    UARTEN:1;
+    } U2MODEBITS;
+typedef struct {
+    uint16_t    :10;
+    uint16_t    UTXEN:1;
+    uint16_t    :5;
+    } U2STABITS;
+
+#define SIM_PORT_BITS(p)    typedef struct {                                            \
+    uint16_t p##0:1; uint16_t p##1:1; uint16_t p##2:1; uint16_t p##3:1;                 \
+    uint16_t p##4:1; uint16_t p##5:1; uint16_t p##6:1; uint16_t p##7:1;                 \
+    uint16_t p##8:1; uint16_t p##9:1; uint16_t p##10:1; uint16_t p##11:1;               \
+    uint16_t p##12:1; uint16_t p##13:1; uint16_t p##14:1; uint16_t p##15:1;             \
+    } p##BITS;
+SIM_PORT_BITS(LATA)  SIM_PORT_BITS(LATB)  SIM_PORT_BITS(LATC)  SIM_PORT_BITS(LATD)
+SIM_PORT_BITS(LATE)  SIM_PORT_BITS(LATF)  SIM_PORT_BITS(LATG)
+SIM_PORT_BITS(TRISA) SIM_PORT_BITS(TRISB) SIM_PORT_BITS(TRISC) SIM_PORT_BITS(TRISD)
+SIM_PORT_BITS(TRISE) SIM_PORT_BITS(TRISF) SIM_PORT_BITS(TRISG)
+
+#define SIM_SFR(r)          union { volatile uint16_t r; volatile r##BITS r##bits; }
+
+/** Type sim_sfr_t
+ *
+ * Registers trapped by the model (one page of memory)
+ */
+typedef struct {
+    union {
+        struct {
+            volatile uint16_t   SPI1STAT, SPI1CON1, SPI1CON2, SPI1BUF;
+            volatile uint16_t   SPI2STAT, SPI2CON1, SPI2CON2, SPI2BUF;
+            volatile uint16_t   SPI3STAT, SPI3CON1, SPI3CON2, SPI3BUF;
+            SIM_SFR(IFS0);  SIM_SFR(IFS2);  SIM_SFR(IFS5);
+            SIM_SFR(IEC0);  SIM_SFR(IEC2);  SIM_SFR(IEC5);
+            SIM_SFR(IPC2);  SIM_SFR(IPC8);  SIM_SFR(IPC22);
+            SIM_SFR(SR);
+            SIM_SFR(T2CON); SIM_SFR(T3CON);
+            volatile uint16_t   TMR2, TMR3, TMR3HLD, PR2, PR3;
+            SIM_SFR(LATA);  SIM_SFR(LATB);  SIM_SFR(LATC);  SIM_SFR(LATD);
+            SIM_SFR(LATE);  SIM_SFR(LATF);  SIM_SFR(LATG);
+            };
+        uint8_t simPage[4096];
+        };
+    } sim_sfr_t;
+
+extern sim_sfr_t    simSfr;
+
+//-----------------------------------------------------------------------------
+// Trapped registers
+#define SPI1STAT    simSfr.SPI1STAT
+#define SPI1CON1    simSfr.SPI1CON1
+#define SPI1CON2    simSfr.SPI1CON2
+#define SPI1BUF     simSfr.SPI1BUF
+#define SPI2STAT    simSfr.SPI2STAT
+#define SPI2CON1    simSfr.SPI2CON1
+#define SPI2CON2    simSfr.SPI2CON2
+#define SPI2BUF     simSfr.SPI2BUF
+#define SPI3STAT    simSfr.SPI3STAT
+#define SPI3CON1    simSfr.SPI3CON1
+#define SPI3CON2    simSfr.SPI3CON2
+#define SPI3BUF     simSfr.SPI3BUF
+
+#define IFS0        simSfr.IFS0
+#define IFS2        simSfr.IFS2
+#define IFS5        simSfr.IFS5
+#define IEC0        simSfr.IEC0
+#define IEC2        simSfr.IEC2
+#define IEC5        simSfr.IEC5
+#define IPC2        simSfr.IPC2
+#define IPC8        simSfr.IPC8
+#define IPC22       simSfr.IPC22
+#define IFS0bits    simSfr.IFS0bits
+#define IFS2bits    simSfr.IFS2bits
+#define IFS5bits    simSfr.IFS5bits
+#define IEC0bits    simSfr.IEC0bits
+#define IEC2bits    simSfr.IEC2bits
+#define IEC5bits    simSfr.IEC5bits
+#define IPC2bits    simSfr.IPC2bits
+#define IPC8bits    simSfr.IPC8bits
+#define IPC22bits   simSfr.IPC22bits
+#define _SPI1IF     IFS0bits.SPI1IF
+#define _SPI2IF     IFS2bits.SPI2IF
+#define _SPI3IF     IFS5bits.SPI3IF
+#define _SPI1IE     IEC0bits.SPI1IE
+#define _SPI2IE     IEC2bits.SPI2IE
+#define _SPI3IE     IEC5bits.SPI3IE
+#define _SPI1IP     IPC2bits.SPI1IP
+#define _SPI2IP     IPC8bits.SPI2IP
+#define _SPI3IP     IPC22bits.SPI3IP
+
+#define SR          simSfr.SR
+#define SRbits      simSfr.SRbits
+
+#define T2CON       simSfr.T2CON
+#define T3CON       simSfr.T3CON
+#define T2CONbits   simSfr.T2CONbits
+#define T3CONbits   simSfr.T3CONbits
+#define TMR2        simSfr.TMR2
+#define TMR3        simSfr.TMR3
+#define TMR3HLD     simSfr.TMR3HLD
+#define PR2         simSfr.PR2
+#define PR3         simSfr.PR3
+
+#define LATA        simSfr.LATA
+#define LATB        simSfr.LATB
+#define LATC        simSfr.LATC
+#define LATD        simSfr.LATD
+#define LATE        simSfr.LATE
+#define LATF        simSfr.LATF
+#define LATG        simSfr.LATG
+#define LATAbits    simSfr.LATAbits
+#define LATBbits    simSfr.LATBbits
+#define LATCbits    simSfr.LATCbits
+#define LATDbits    simSfr.LATDbits
+#define LATEbits    simSfr.LATEbits
+#define LATFbits    simSfr.LATFbits
+#define LATGbits    simSfr.LATGbits
+
+//-----------------------------------------------------------------------------
+// Plain registers (not seen by the model)
+typedef struct {
+    SIM_SFR(TRISA); SIM_SFR(TRISB); SIM_SFR(TRISC); SIM_SFR(TRISD);
+    SIM_SFR(TRISE); SIM_SFR(TRISF); SIM_SFR(TRISG);
+    SIM_SFR(U2MODE); SIM_SFR(U2STA);
+    volatile uint16_t   U2BRG;
+    } sim_io_t;
+
+extern sim_io_t     simIo;
+extern int          __C30_UART;
+
+#define TRISA       simIo.TRISA
+#define TRISB       simIo.TRISB
+#define TRISC       simIo.TRISC
+#define TRISD       simIo.TRISD
+#define TRISE       simIo.TRISE
+#define TRISF       simIo.TRISF
+#define TRISG       simIo.TRISG
+#define TRISAbits   simIo.TRISAbits
+#define TRISBbits   simIo.TRISBbits
+#define TRISCbits   simIo.TRISCbits
+#define TRISDbits   simIo.TRISDbits
+#define TRISEbits   simIo.TRISEbits
+#define TRISFbits   simIo.TRISFbits
+#define TRISGbits   simIo.TRISGbits
+#define U2MODE      simIo.U2MODE
+#define U2STA       simIo.U2STA
+#define U2MODEbits  simIo.U2MODEbits
+#define U2STAbits   simIo.U2STAbits
+#define U2BRG       simIo.U2BRG
+
+//-----------------------------------------------------------------------------
+// Builtins
+void    sim_idle(void);
+void    sim_disi(uint16_t nbCycles);
+#define Idle()                  sim_idle()
+#define __builtin_disi(n)       sim_disi(n)
+#define Nop()                   do {} while (0)
+
+#endif
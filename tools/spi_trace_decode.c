@@ -0,0 +1,145 @@
+/**
+ * @file spi_trace_decode.c
+ * @author 	Alexis ROLLAND
+ * @date	2026/10
+ * @brief 	Host decoder of the SPI trace records (SPI_USE_TRACE)
+ *
+ * Reads the UART log of the target (lines "trace,module,tag,op,start,end,
+ * len,result,data", see TraceDump) on stdin, other lines are ignored, and
+ * prints :
+ *  - one latency line per device (module, tag) : count, errors, min / avg /
+ *    max duration and a log2 histogram (bucket k : 2^k <= duration < 2^(k+1))
+ *  - the bus utilisation of each module per time window (busy %)
+ *
+ * Build : cc -std=c99 -o spi_trace_decode spi_trace_decode.c
+ * Usage : spi_trace_decode [window] < uart.log     (window in timer units,
+ *         default 100000, i.e. 25 ms at FCY = 4 MHz)
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Directives de compilation - Macros		*/
+#define MAX_DEVICES     64
+#define MAX_MODULES     4
+#define MAX_WINDOWS     4096
+#define NB_BUCKETS      32
+
+typedef struct{
+    unsigned    module;
+    unsigned    tag;
+    uint32_t    count;
+    uint32_t    errors;
+    uint32_t    min;
+    uint32_t    max;
+    uint64_t    sum;
+    uint32_t    hist[NB_BUCKETS];
+    } device_t;
+
+/* Déclarations des variables globales 	*/
+static device_t devices[MAX_DEVICES];
+static unsigned nbDevices;
+static uint64_t busy[MAX_MODULES][MAX_WINDOWS];    /**< Busy time of each module per window */
+static unsigned nbWindows;
+
+/*	Implémentation du code */
+static device_t *find_device(unsigned module, unsigned tag){
+    unsigned    i;
+
+    for (i = 0; i < nbDevices; i++){
+        if ((devices[i].module == module) && (devices[i].tag == tag)) return &devices[i];
+    }
+    if (nbDevices == MAX_DEVICES) return NULL;
+    devices[nbDevices].module = module;
+    devices[nbDevices].tag = tag;
+    devices[nbDevices].min = 0xFFFFFFFF;
+    return &devices[nbDevices++];
+}
+//------------------------------------------------------------------------------
+static unsigned log2_bucket(uint32_t value){
+    unsigned    k = 0;
+
+    while ((value >>= 1) != 0) k++;
+    return k;
+}
+//------------------------------------------------------------------------------
+/**
+ * Spreads the busy time [start, start + dur) over the windows
+ */
+static void add_busy(unsigned module, uint64_t start, uint64_t dur, uint64_t window){
+    uint64_t    w, part;
+
+    while (dur != 0){
+        w = start / window;
+        if (w >= MAX_WINDOWS) return;
+        part = (w + 1) * window - start;
+        if (part > dur) part = dur;
+        busy[module][w] += part;
+        if (w + 1 > nbWindows) nbWindows = (unsigned)(w + 1);
+        start += part;
+        dur -= part;
+    }
+}
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[]){
+    char        line[256];
+    unsigned    module, tag, op, len, result;
+    unsigned long   start, end;
+    uint32_t    dur;
+    uint64_t    window = 100000;
+    uint64_t    base = 0, last = 0, time;
+    int32_t     delta;
+    int         first = 1;
+    device_t    *pDev;
+    unsigned    i, k, m;
+
+    if (argc > 1) window = strtoull(argv[1], NULL, 0);
+    if (window == 0) window = 1;
+
+    while (fgets(line, sizeof(line), stdin) != NULL){
+        if (sscanf(line, "trace,%u,%u,%u,%lu,%lu,%u,%u", &module, &tag, &op, &start, &end, &len, &result) != 7) continue;
+        dur = (uint32_t)end - (uint32_t)start;      // 32 bits timer : wraps
+
+        pDev = find_device(module, tag);
+        if (pDev != NULL){
+            pDev->count++;
+            if (result != 0) pDev->errors++;
+            if (dur < pDev->min) pDev->min = dur;
+            if (dur > pDev->max) pDev->max = dur;
+            pDev->sum += dur;
+            pDev->hist[log2_bucket(dur)]++;
+        }
+
+        // Timeline : 64 bits time unwrapped from the 32 bits start values
+        if (first){
+            base = (uint32_t)start;
+            last = 0;
+            first = 0;
+        }
+        delta = (int32_t)((uint32_t)start - (uint32_t)(base + last));   // < 0 : async record ended after a later call
+        time = ((delta < 0) && ((uint64_t)-(int64_t)delta > last))?0:(uint64_t)((int64_t)last + delta);
+        if (delta > 0) last = time;
+        if (module < MAX_MODULES) add_busy(module, time, dur, window);
+    }
+
+    printf("latency,module,tag,count,errors,min,avg,max,hist_log2\n");
+    for (i = 0; i < nbDevices; i++){
+        pDev = &devices[i];
+        printf("latency,%u,%u,%lu,%lu,%lu,%lu,%lu,", pDev->module, pDev->tag,
+                (unsigned long)pDev->count, (unsigned long)pDev->errors, (unsigned long)pDev->min,
+                (unsigned long)(pDev->sum / pDev->count), (unsigned long)pDev->max);
+        for (k = 0; k < NB_BUCKETS; k++){
+            if (pDev->hist[k] != 0) printf(" %u:%lu", k, (unsigned long)pDev->hist[k]);
+        }
+        printf("\n");
+    }
+
+    printf("busy,window_start,module,busy_percent\n");
+    for (i = 0; i < nbWindows; i++){
+        for (m = 0; m < MAX_MODULES; m++){
+            if (busy[m][i] != 0) printf("busy,%llu,%u,%.1f\n", (unsigned long long)(i * window), m, 100.0 * (double)busy[m][i] / (double)window);
+        }
+    }
+    return 0;
+}